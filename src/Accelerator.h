@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+
+#include <Bounds.h>
+#include <Ray.h>
+#include <RayBatch.h>
+
+namespace Photon {
+
+    enum AcceleratorType {
+        NO_ACCELERATOR = 0,
+        GRID_ACCELERATOR = 1,
+        BVH_ACCELERATOR = 2,
+        WIDE_BVH_ACCELERATOR = 3,
+        MOTION_BVH_ACCELERATOR = 4
+    };
+
+    // Refit structures costing this much more than when built are built again
+    static const Float ACCEL_REBUILD_DEGRADATION = 1.5;
+
+    // Interface of the spatial structures used to speed up ray queries
+    class Accelerator {
+    public:
+        virtual ~Accelerator() { }
+
+        virtual void initialize() = 0;
+
+        virtual bool intersectRay(const Ray& ray, SurfaceEvent* evt) const = 0;
+        virtual bool isOccluded(const Ray& ray) const = 0;
+
+        // Batch queries, structures without packet traversal answer them ray by ray
+        virtual void intersectRays(const RayBatch& batch, HitBatch* hits) const {
+            for (uint32 r = 0; r < batch.size; ++r)
+                intersectRay(batch.rays[r], &hits->events[r]);
+        }
+
+        // Returns the occluded rays as a bit mask
+        virtual uint32 occludedRays(const RayBatch& batch) const {
+            uint32 occluded = 0;
+            for (uint32 r = 0; r < batch.size; ++r)
+                if (isOccluded(batch.rays[r]))
+                    occluded |= 1u << r;
+
+            return occluded;
+        }
+
+        virtual Bounds3 bounds() const = 0;
+
+        // Moves the structure along with its primitives, keeping its topology.
+        // Structures that can't be updated in place return false and must be
+        // built again.
+        virtual bool refit() {
+            return false;
+        }
+
+        // Expected traversal cost relative to the last build, refits of
+        // primitives moving apart slowly degrade the tree
+        virtual Float degradation() const {
+            return 1;
+        }
+    };
+
+    inline const char* acceleratorName(AcceleratorType type) {
+        switch (type) {
+            case GRID_ACCELERATOR:
+                return "Grid";
+            case BVH_ACCELERATOR:
+                return "BVH";
+            case WIDE_BVH_ACCELERATOR:
+                return "WideBVH";
+            case MOTION_BVH_ACCELERATOR:
+                return "MotionBVH";
+            default:
+                return "None";
+        }
+    }
+
+    inline bool parseAccelerator(const std::string& name, AcceleratorType* type) {
+        if (name.compare(0, 4, "wbvh") == 0 || name.compare(0, 7, "widebvh") == 0)
+            *type = WIDE_BVH_ACCELERATOR;
+        else if (name.compare(0, 4, "mbvh") == 0 || name.compare(0, 9, "motionbvh") == 0)
+            *type = MOTION_BVH_ACCELERATOR;
+        else if (name.compare(0, 3, "bvh") == 0)
+            *type = BVH_ACCELERATOR;
+        else if (name.compare(0, 4, "grid") == 0)
+            *type = GRID_ACCELERATOR;
+        else if (name.compare(0, 4, "none") == 0 || name.compare(0, 3, "off") == 0)
+            *type = NO_ACCELERATOR;
+        else
+            return false;
+
+        return true;
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include <Animation.h>
+
+#include <cmath>
+
+using namespace Photon;
+
+// Times at which moving boxes are evaluated to bound them
+static const uint32 MOTION_BOUNDS_STEPS = 64;
+
+AnimatedTransform::AnimatedTransform(const Transform& transform)
+    : _start(transform), _end(transform), _animated(false) {
+
+    decompose(_start.matrix(), &_T[0], &_R[0], &_S[0]);
+    _T[1] = _T[0];
+    _R[1] = _R[0];
+    _S[1] = _S[0];
+}
+
+AnimatedTransform::AnimatedTransform(const Transform& start, const Transform& end)
+    : _start(start), _end(end), _animated(false) {
+
+    decompose(_start.matrix(), &_T[0], &_R[0], &_S[0]);
+    decompose(_end.matrix(),   &_T[1], &_R[1], &_S[1]);
+
+    // Take the shortest path between both rotations
+    if (dot(_R[0], _R[1]) < 0)
+        _R[1] = _R[1] * -1.0;
+
+    for (uint32 i = 0; i < 4 && !_animated; ++i)
+        for (uint32 j = 0; j < 4; ++j)
+            if (_start.matrix().m[i][j] != _end.matrix().m[i][j])
+                _animated = true;
+}
+
+void AnimatedTransform::decompose(const Mat4& mat, Vec3* T, Quat* R, Mat4* S) {
+    *T = Vec3(mat.m[0][3], mat.m[1][3], mat.m[2][3]);
+
+    // Remaining linear part, M = RS
+    Mat4 M = mat;
+    for (uint32 i = 0; i < 3; ++i)
+        M.m[i][3] = M.m[3][i] = 0;
+    M.m[3][3] = 1;
+
+    // Polar decomposition, averages the matrix with its inverse transpose
+    // until it converges to the rotation
+    Mat4 rot = M;
+    for (uint32 iter = 0; iter < 100; ++iter) {
+        const Mat4 invT = inverse(transpose(rot));
+
+        Float norm = 0;
+        for (uint32 i = 0; i < 3; ++i) {
+            Float rowNorm = 0;
+            for (uint32 j = 0; j < 3; ++j) {
+                const Float next = 0.5 * (rot.m[i][j] + invT.m[i][j]);
+                rowNorm += std::abs(next - rot.m[i][j]);
+                rot.m[i][j] = next;
+            }
+
+            norm = std::max(norm, rowNorm);
+        }
+
+        if (norm < 1e-4)
+            break;
+    }
+
+    *R = Quat(Transform(rot));
+    *S = mul(inverse(rot), M);
+}
+
+Transform AnimatedTransform::interpolate(Float time) const {
+    if (!_animated || time <= 0)
+        return _start;
+    if (time >= 1)
+        return _end;
+
+    const Vec3 T = (1 - time) * _T[0] + time * _T[1];
+    const Quat R = slerp(time, _R[0], _R[1]);
+
+    Mat4 S;
+    for (uint32 i = 0; i < 3; ++i)
+        for (uint32 j = 0; j < 3; ++j)
+            S.m[i][j] = Math::lerp(time, _S[0].m[i][j], _S[1].m[i][j]);
+
+    return translate(T) * R.transform() * Transform(S);
+}
+
+Bounds3 AnimatedTransform::motionBounds(const Bounds3& box) const {
+    if (!_animated)
+        return _start(box);
+
+    Bounds3 bounds = Bounds3::EMPTY;
+    for (uint32 s = 0; s <= MOTION_BOUNDS_STEPS; ++s)
+        bounds.expand(interpolate((Float)s / MOTION_BOUNDS_STEPS)(box));
+
+    return bounds;
+}
+
+void AnimatedTransform::linearBounds(const Bounds3& box, Bounds3* start, Bounds3* end) const {
+    *start = _start(box);
+    *end   = _end(box);
+
+    if (!_animated)
+        return;
+
+    // Largest amount the moving box pokes out of the interpolated one
+    Vec3 growMin(0), growMax(0);
+    for (uint32 s = 1; s < MOTION_BOUNDS_STEPS; ++s) {
+        const Float time = (Float)s / MOTION_BOUNDS_STEPS;
+        const Bounds3 moving = interpolate(time)(box);
+
+        for (uint32 i = 0; i < 3; ++i) {
+            const Float lerpMin = Math::lerp(time, start->min()[i], end->min()[i]);
+            const Float lerpMax = Math::lerp(time, start->max()[i], end->max()[i]);
+
+            growMin[i] = std::max(growMin[i], lerpMin - moving.min()[i]);
+            growMax[i] = std::max(growMax[i], moving.max()[i] - lerpMax);
+        }
+    }
+
+    // Rotations bulge between the sampled times, pad by a fraction of the extent
+    const Vec3 pad = 0.01 * ((start->max() - start->min()) + (end->max() - end->min()));
+    growMin += pad;
+    growMax += pad;
+
+    *start = Bounds3(start->min() - growMin, start->max() + growMax);
+    *end   = Bounds3(end->min() - growMin, end->max() + growMax);
+}
\ No newline at end of file
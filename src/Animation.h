@@ -1,15 +1,50 @@
 #pragma once
 
 #include <Transform.h>
+#include <Quat.h>
+#include <Bounds.h>
 
 namespace Photon {
 
-    class Animation {
+    // Transform keyframed at both ends of the shutter, times are given as
+    // fractions of it in [0, 1]. Keyframes are decomposed into translation,
+    // rotation and scale so that rotations are interpolated rigidly.
+    class AnimatedTransform {
     public:
+        AnimatedTransform(const Transform& transform);
+        AnimatedTransform(const Transform& start, const Transform& end);
 
+        bool isAnimated() const {
+            return _animated;
+        }
+
+        const Transform& start() const {
+            return _start;
+        }
+
+        const Transform& end() const {
+            return _end;
+        }
+
+        Transform interpolate(Float time) const;
+
+        // Box swept over the whole shutter
+        Bounds3 motionBounds(const Bounds3& box) const;
+
+        // Boxes at both ends of the shutter, grown so that their
+        // interpolation contains the moving box at any time in between
+        void linearBounds(const Bounds3& box, Bounds3* start, Bounds3* end) const;
 
     private:
+        static void decompose(const Mat4& mat, Vec3* T, Quat* R, Mat4* S);
+
+        Transform _start;
+        Transform _end;
+        bool _animated;
 
+        Vec3 _T[2];
+        Quat _R[2];
+        Mat4 _S[2];
     };
 
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <Ray.h>
 #include <Shape.h>
 #include <Sampling.h>
+#include <LightTree.h>
 
 using namespace Photon;
 
@@ -10,6 +11,10 @@ std::shared_ptr<Shape> AreaLight::shape() const {
     return _shape;
 }
 
+void AreaLight::initialize(const Scene&) {
+    _shape->prepareSampling();
+}
+
 bool AreaLight::isDelta() const {
     return false;
 }
@@ -33,6 +38,16 @@ Color AreaLight::power() const {
     return _shape->area() * PI * _Le;
 }
 
+// Emits from the front of the surface over its whole hemisphere
+bool AreaLight::lightBounds(LightBounds* bounds) const {
+    Vec3  axis;
+    Float cosTheta_o;
+    _shape->normalCone(&axis, &cosTheta_o);
+
+    *bounds = LightBounds(_shape->bbox(), axis, cosTheta_o, 0, power().lum());
+    return true;
+}
+
 Color AreaLight::evalL(const SurfaceEvent& it, const Vec3& wo) const {
     // Only emit towards orientation
     if (dot(it.normal, wo) <= 0)
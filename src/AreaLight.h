@@ -14,12 +14,15 @@ namespace Photon {
 
         std::shared_ptr<Shape> shape() const;
 
+        void initialize(const Scene& scene);
+
         Color L(const RayEvent& evt, const Vec3& w) const;
         Float area() const;
             
         bool isDelta() const;
         uint32 numSamples() const;
         Color power() const;
+        bool  lightBounds(LightBounds* bounds) const;
 
         Color evalL(const SurfaceEvent& it, const Vec3& wo) const;
         Color evalL(const PositionSample& sample, const Vec3& wo) const;
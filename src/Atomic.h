@@ -27,6 +27,10 @@ namespace Photon {
             while (!_float.compare_exchange_weak(curr, curr * val));
         }
 
+        void set(Float val) {
+            _float.store(val);
+        }
+
         Float val() const {
             return _float.load();
         }
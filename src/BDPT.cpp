@@ -458,19 +458,11 @@ Float PathVertex::evalLightDistrPdf(const Scene& scene, const PathVertex& next)
     DirectSample ds(next.event(), event());
     Float pdfPos = light->pdfDirect(ds);
 
-    DiscretePdf1D* distr = scene.lightDistribution();
-    if (!distr)
+    if (!scene.lightDistribution())
         return pdfPos;
 
-    const Light* light = getLight();
-
-    // Get index for this light in light array
-    auto lights = scene.getLights();
-    auto iter   = std::find(lights.begin(), lights.end(), light);
-    uint32 idx  = std::distance(lights.begin(), iter);
-
     // Evaluate distribution PDF
-    Float pdfDistr = distr->pdf(idx);
+    Float pdfDistr = scene.lightPdf(getLight());
 
     return pdfDistr * pdfPos;
 }
@@ -484,6 +476,8 @@ void BidirPathTracer::renderTile(uint32 tId, uint32 tileId) const {
 	Sampler& sampler = *tile.samp.get();
 
 	const Camera& camera = _scene->getCamera();
+	FilmTile filmTile = camera.film().tile(Point2ui(tile.x, tile.y), Vec2ui(tile.w, tile.h));
+
 	for (uint32 y = 0; y < tile.h; ++y) {
 		for (uint32 x = 0; x < tile.w; ++x) {
 			Point2ui pixel(x + tile.x, y + tile.y);
@@ -496,16 +490,17 @@ void BidirPathTracer::renderTile(uint32 tId, uint32 tileId) const {
                 sampler.startSample(s);
 
 				// Generate camera path
-				Path cameraPath = createPath(PATH_CAMERA, _maxDepth + 2, sampler);
+				Point2 pFilm;
+				Path cameraPath = createPath(PATH_CAMERA, _maxDepth + 2, sampler, &pFilm);
 
 				// Generate light path
 				Path lightPath = createPath(PATH_LIGHT, _maxDepth + 1, sampler);
 
 				// Perform all connections between the two paths
-				Color Li = connectPaths(cameraPath, lightPath, sampler);
+				Color Li = connectPaths(cameraPath, lightPath, sampler, tId);
 
-                // Record sample on camera's film
-                camera.film().addColorSample(pixel.x, pixel.y, Li);
+                // Record sample on the tile
+                filmTile.addSample(pFilm, Li);
 
                 color += Li;
 			}
@@ -515,9 +510,11 @@ void BidirPathTracer::renderTile(uint32 tId, uint32 tileId) const {
 			camera.film().addPreviewSample(pixel.x, pixel.y, color);
 		}
 	}
+
+	camera.film().mergeTile(filmTile);
 }
 
-Path BidirPathTracer::createPath(PathType type, uint32 maxDepth, Sampler& sampler) const {
+Path BidirPathTracer::createPath(PathType type, uint32 maxDepth, Sampler& sampler, Point2* pFilm) const {
 	const Camera& camera = _scene->getCamera();
 
 	Float pdf = 0;
@@ -556,7 +553,7 @@ Path BidirPathTracer::createPath(PathType type, uint32 maxDepth, Sampler& sample
     }
 	else if (type == PATH_CAMERA) {
 		// Set starting ray
-		ray = camera.primaryRay(sampler.pixel(), sampler);
+		ray = camera.primaryRay(sampler.pixel(), sampler, pFilm);
 
 		path[0] = PathVertex::createCameraVertex(camera, ray, Color(1));
 
@@ -261,9 +261,10 @@ namespace Photon {
 
 		void renderTile(uint32 tId, uint32 tileId) const;
 
-		Path createPath(PathType type, uint32 maxDepth, Sampler& sampler) const;
+		// Camera paths return the film position of their first ray in pFilm, if given
+		Path createPath(PathType type, uint32 maxDepth, Sampler& sampler, Point2* pFilm = nullptr) const;
 
-        Color connectPaths(const Path& cameraPath, const Path& lightPath, Sampler& sampler) const {
+        Color connectPaths(const Path& cameraPath, const Path& lightPath, Sampler& sampler, uint32 threadId) const {
             const Camera& cam = _scene->getCamera();
             
             // Record features on features buffer
@@ -302,7 +303,7 @@ namespace Photon {
                     } else {
                         // Add splat
                         if (!strat.L.isBlack())                 
-                            cam.film().addSplatSample(strat.raster, strat.L * strat.mis);                    
+                            cam.film().addSplatSample(strat.raster, strat.L * strat.mis, threadId);                    
                     }
 
                     /*std::cout << "Strat (s, t) = (" << s << ", " << t << ")" << std::endl;
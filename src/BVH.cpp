@@ -0,0 +1,1057 @@
+#include <BVH.h>
+
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+#include <cstring>
+
+#include <Threading.h>
+#include <Timer.h>
+
+using namespace Photon;
+
+// Relative costs used by the surface area heuristic
+static const Float SAH_TRAVERSAL_COST = 1.0;
+static const Float SAH_INTERSECT_COST = 1.0;
+
+// Past this depth splits fall back to the median so the
+// tree never outgrows the traversal stack
+static const uint32 BVH_MEDIAN_DEPTH = BVH_STACK_SIZE / 2;
+
+// Ranges with fewer primitives than these are processed serially
+static const uint32 BVH_PARALLEL_BINNING = 64 * 1024;
+static const uint32 BVH_PARALLEL_SUBTREE = 4 * 1024;
+
+// Lanes and unbounded primitives without a shape
+static const uint32 CACHE_NO_SHAPE = 0xFFFFFFFF;
+
+// Sizes and state of a cached tree
+struct BVHCacheInfo {
+    uint64 numNodes;
+    uint64 numPackets;
+    uint64 numUnbounded;
+    uint32 numShapes;
+    uint32 maxPrimsInNode;
+    uint32 compact;         // Packets are stored as face references
+    uint32 pad;
+    Float  bboxMin[3];
+    Float  bboxMax[3];
+    Float  cost;
+};
+
+// Info of a cached tree if its chunks are consistent and it was built over as many shapes
+static const BVHCacheInfo* validCacheInfo(const Utils::CacheFile& file, size_t numShapes, uint32 maxPrimsInNode) {
+    size_t infoSize, nodesSize, packetsSize, lanesSize, unboundedSize;
+    const BVHCacheInfo* info = (const BVHCacheInfo*)file.chunk(Utils::CACHE_BVH, &infoSize);
+    const uint8* nodes       = file.chunk(Utils::CACHE_BVH_NODES, &nodesSize);
+    const uint8* packets     = file.chunk(Utils::CACHE_BVH_PACKETS, &packetsSize);
+    const uint32* lanes      = (const uint32*)file.chunk(Utils::CACHE_BVH_LANES, &lanesSize);
+    const uint32* unbounded  = (const uint32*)file.chunk(Utils::CACHE_BVH_UNBOUNDED, &unboundedSize);
+
+    if (!info || !nodes || !packets || !lanes || !unbounded || infoSize != sizeof(BVHCacheInfo) ||
+        info->numShapes != numShapes || info->maxPrimsInNode != maxPrimsInNode ||
+        nodesSize != info->numNodes * sizeof(BVHNode) ||
+        packetsSize != info->numPackets * (info->compact ? sizeof(FaceRefPacket) : sizeof(TrianglePacket)) ||
+        lanesSize != info->numPackets * PACKET_WIDTH * sizeof(uint32) ||
+        unboundedSize != info->numUnbounded * sizeof(uint32))
+        return nullptr;
+
+    for (uint64 l = 0; l < info->numPackets * PACKET_WIDTH; ++l)
+        if (lanes[l] != CACHE_NO_SHAPE && lanes[l] >= numShapes)
+            return nullptr;
+
+    for (uint64 u = 0; u < info->numUnbounded; ++u)
+        if (unbounded[u] >= numShapes)
+            return nullptr;
+
+    return info;
+}
+
+// Primitive held by a lane of a packet
+static Primitive lanePrimitive(const TrianglePacket& packet, uint32 lane) {
+    return { Point3(packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane]),
+             Vec3(packet.e1[0][lane], packet.e1[1][lane], packet.e1[2][lane]),
+             Vec3(packet.e2[0][lane], packet.e2[1][lane], packet.e2[2][lane]),
+             packet.shapes[lane], packet.faces[lane] };
+}
+
+static uint32 numBuildPartitions(uint32 numPrims) {
+    return numPrims < BVH_PARALLEL_BINNING ? 1 : Threading::Workers->numThreads() * 4;
+}
+
+// Slab test of a node against the ray's current range, near planes are
+// selected through the direction signs to avoid sorting each slab
+static inline bool intersectBox(const BVHNode& node, const Ray& ray,
+                                const Vec3& invDir, const uint32 dirIsNeg[3]) {
+    const Point3& origin = ray.origin();
+
+    Float tMin = ray.minT();
+    Float tMax = ray.maxT();
+    for (uint32 i = 0; i < 3; ++i) {
+        Float tNear = ((dirIsNeg[i] ? node.bboxMax[i] : node.bboxMin[i]) - origin[i]) * invDir[i];
+        Float tFar  = ((dirIsNeg[i] ? node.bboxMin[i] : node.bboxMax[i]) - origin[i]) * invDir[i];
+
+        if (tNear > tMin)
+            tMin = tNear;
+        if (tFar < tMax)
+            tMax = tFar;
+
+        if (tMin > tMax)
+            return false;
+    }
+
+    return true;
+}
+
+static inline Float nodeArea(const BVHNode& node) {
+    const Float dx = node.bboxMax[0] - node.bboxMin[0];
+    const Float dy = node.bboxMax[1] - node.bboxMin[1];
+    const Float dz = node.bboxMax[2] - node.bboxMin[2];
+
+    return 2 * (dx * dy + dx * dz + dy * dz);
+}
+
+namespace {
+
+    // Traversal data of a ray batch. When all rays share their direction
+    // signs, the ranges of their origins and inverse directions bound the
+    // distances to any box, culling nodes missed by every ray at once.
+    struct BatchTraversal {
+        Vec3   invDir[RAY_BATCH_SIZE];
+        uint32 dirIsNeg[RAY_BATCH_SIZE][3];
+
+        bool   coherent;
+        Float  originMin[3], originMax[3];
+        Float  invDirMin[3], invDirMax[3];
+        Float  minT;
+
+        BatchTraversal(const RayBatch& batch) : coherent(true), minT(F_INFINITY) {
+            for (uint32 i = 0; i < 3; ++i) {
+                originMin[i] = invDirMin[i] =  F_INFINITY;
+                originMax[i] = invDirMax[i] = -F_INFINITY;
+            }
+
+            for (uint32 r = 0; r < batch.size; ++r) {
+                const Ray& ray = batch.rays[r];
+                invDir[r] = ray.dir().recip();
+
+                for (uint32 i = 0; i < 3; ++i) {
+                    dirIsNeg[r][i] = invDir[r][i] < 0;
+
+                    // Axis aligned rays would turn the bounds into NaNs
+                    if (dirIsNeg[r][i] != dirIsNeg[0][i] || !std::isfinite(invDir[r][i]))
+                        coherent = false;
+
+                    originMin[i] = std::min(originMin[i], ray.origin()[i]);
+                    originMax[i] = std::max(originMax[i], ray.origin()[i]);
+                    invDirMin[i] = std::min(invDirMin[i], invDir[r][i]);
+                    invDirMax[i] = std::max(invDirMax[i], invDir[r][i]);
+                }
+
+                minT = std::min(minT, ray.minT());
+            }
+        }
+
+        // Conservative test, true only if no ray of the batch can hit the node
+        bool cull(const BVHNode& node, Float maxT) const {
+            if (!coherent)
+                return false;
+
+            Float tMin = minT;
+            Float tMax = maxT;
+            for (uint32 i = 0; i < 3; ++i) {
+                const Float nearPlane = dirIsNeg[0][i] ? node.bboxMax[i] : node.bboxMin[i];
+                const Float farPlane  = dirIsNeg[0][i] ? node.bboxMin[i] : node.bboxMax[i];
+
+                // The extremes of (plane - origin) * invDir lie on the range corners
+                const Float n0 = nearPlane - originMin[i], n1 = nearPlane - originMax[i];
+                const Float f0 = farPlane  - originMin[i], f1 = farPlane  - originMax[i];
+
+                Float tNear = std::min(std::min(n0 * invDirMin[i], n0 * invDirMax[i]),
+                                       std::min(n1 * invDirMin[i], n1 * invDirMax[i]));
+                Float tFar  = std::max(std::max(f0 * invDirMin[i], f0 * invDirMax[i]),
+                                       std::max(f1 * invDirMin[i], f1 * invDirMax[i]));
+
+                if (tNear > tMin)
+                    tMin = tNear;
+                if (tFar < tMax)
+                    tMax = tFar;
+
+                if (tMin > tMax)
+                    return true;
+            }
+
+            return false;
+        }
+    };
+
+    struct BatchStackEntry {
+        uint32 nodeIdx;
+        uint32 active;      // Rays of the batch still to test against the node
+    };
+
+}
+
+BVH::BVH(const std::vector<std::shared_ptr<Shape>>& shapes, uint32 maxPrimsInNode)
+    : _shapes(shapes), _maxPrimsInNode(std::min(std::max(maxPrimsInNode, 1u), BVH_MAX_LEAF_PRIMS)),
+      _compact(false), _buildTime(0), _refitTime(0), _buildCost(0), _refitCost(0),
+      _mappedPackets(nullptr), _mappedRefs(nullptr), _mappedMesh(nullptr), _numMappedPackets(0) { }
+
+void BVH::initialize() {
+    Utils::Timer timer;
+
+    _nodes.clear();
+    _packets.clear();
+    _refs.clear();
+    _mappedPackets = nullptr;
+    _mappedRefs    = nullptr;
+    _mappedMesh    = nullptr;
+    _pages.reset();
+    _mappedFile.reset();
+    _unbounded.clear();
+    _bounds = Bounds3::EMPTY;
+
+    _compact = false;
+    for (const auto& shape : _shapes)
+        if (shape->triMesh() && shape->triMesh()->isCompressed())
+            _compact = true;
+
+    // Meshes are split into their faces
+    std::vector<Primitive> prims;
+    gatherPrimitives(_shapes, &prims);
+
+    const uint32 numShapePrims = (uint32)prims.size();
+
+    // Bounds of non-mesh shapes may be expensive, query them concurrently
+    std::vector<Bounds3> primBounds(numShapePrims);
+    Threading::parallelFor(0, numShapePrims, numBuildPartitions(numShapePrims), [&](uint32 idx) {
+        primBounds[idx] = prims[idx].bbox();
+    });
+
+    // Gather build information for bounded primitives,
+    // unbounded ones are always tested outside the tree
+    BuildContext ctx;
+    ctx.prims.reserve(numShapePrims);
+
+    for (uint32 idx = 0; idx < numShapePrims; ++idx) {
+        const Bounds3& bbox = primBounds[idx];
+        if (!bbox.isBounded()) {
+            _unbounded.push_back(prims[idx]);
+            continue;
+        }
+
+        ctx.prims.push_back({ bbox, bbox.center(), idx });
+    }
+
+    const uint32 numPrims = (uint32)ctx.prims.size();
+    if (numPrims > 0) {
+        // A binary tree with one primitive per leaf is the largest possible
+        ctx.nodes.resize(2 * numPrims - 1);
+        ctx.numNodes = 0;
+
+        build(ctx, 0, numPrims, 0);
+        _bounds = ctx.nodes[0].bbox;
+
+        ctx.numPackets = 0;
+        layout(ctx);
+
+        // Pack the primitives of each leaf in groups for the SIMD kernels
+        auto packLeaves = [&](auto& packets) {
+            packets.resize(ctx.numPackets);
+            Threading::parallelFor(0, (uint32)ctx.leaves.size(), numBuildPartitions(numPrims), [&](uint32 l) {
+                const BuildNode& leaf = ctx.nodes[ctx.leaves[l].first];
+                const uint32 firstPacket = ctx.leaves[l].second;
+
+                for (uint32 p = 0; p < leaf.numPrims; p += PACKET_WIDTH) {
+                    auto& packet = packets[firstPacket + p / PACKET_WIDTH];
+                    packet.shapeMask = 0;
+
+                    for (uint32 lane = 0; lane < PACKET_WIDTH; ++lane) {
+                        if (p + lane < leaf.numPrims)
+                            packet.setLane(lane, prims[ctx.prims[leaf.primOffset + p + lane].idx]);
+                        else
+                            packet.clearLane(lane);
+                    }
+                }
+            });
+        };
+
+        if (_compact)
+            packLeaves(_refs);
+        else
+            packLeaves(_packets);
+    }
+
+    _buildCost = _refitCost = cost();
+
+    timer.stop();
+    _buildTime = timer.elapsed();
+}
+
+bool BVH::refit() {
+    Utils::Timer timer;
+
+    // The faces are rewritten in place, compact trees read theirs again
+    ownPackets();
+
+    const uint32 numNodes = (uint32)_nodes.size();
+    std::vector<Bounds3> bounds(numNodes, Bounds3::EMPTY);
+
+    // Leaves update their faces from the current vertices and gather
+    // the new bounds of their primitives. They are about half the
+    // nodes, with up to four primitives each.
+    const uint32 numPartitions = numBuildPartitions(numNodes * 2);
+    Threading::parallelFor(0, numNodes, numPartitions, [&](uint32 n) {
+        const BVHNode& node = _nodes[n];
+        if (node.numPrims == 0)
+            return;
+
+        const uint32 numPackets = (node.numPrims + PACKET_WIDTH - 1) / PACKET_WIDTH;
+        for (uint32 p = 0; p < numPackets; ++p) {
+            if (_compact) {
+                TrianglePacket scratch;
+                const TrianglePacket& packet = leafPacket(node.offset + p, &scratch);
+
+                for (uint32 lane = 0; lane < PACKET_WIDTH; ++lane)
+                    if (packet.shapes[lane])
+                        bounds[n].expand(lanePrimitive(packet, lane).bbox());
+
+                continue;
+            }
+
+            TrianglePacket& packet = _packets[node.offset + p];
+
+            for (uint32 lane = 0; lane < PACKET_WIDTH; ++lane) {
+                const Shape* shape = packet.shapes[lane];
+                if (!shape)
+                    continue;
+
+                if (packet.shapeMask & (1 << lane)) {
+                    bounds[n].expand(shape->bbox());
+                    continue;
+                }
+
+                const TriMesh* mesh = shape->triMesh();
+                const MeshFace idx = mesh->face(packet.faces[lane]);
+                const Point3 V0 = mesh->vertex(idx[0]);
+
+                const Primitive prim = { V0, mesh->vertex(idx[1]) - V0, mesh->vertex(idx[2]) - V0,
+                                         mesh, packet.faces[lane] };
+                packet.setLane(lane, prim);
+                bounds[n].expand(prim.bbox());
+            }
+        }
+    });
+
+    // Children are laid out after their parent, so a reverse sweep
+    // sees them complete before the parent is reached
+    for (uint32 n = numNodes; n-- > 0;) {
+        BVHNode& node = _nodes[n];
+        if (node.numPrims == 0)
+            bounds[n] = expand(bounds[n + 1], bounds[node.offset]);
+
+        for (uint32 i = 0; i < 3; ++i) {
+            node.bboxMin[i] = floatRoundDown(bounds[n].min()[i]);
+            node.bboxMax[i] = floatRoundUp(bounds[n].max()[i]);
+        }
+    }
+
+    _bounds = numNodes > 0 ? bounds[0] : Bounds3::EMPTY;
+    _refitCost = cost();
+
+    timer.stop();
+    _refitTime = timer.elapsed();
+
+    return true;
+}
+
+Float BVH::cost() const {
+    if (_nodes.empty())
+        return 0;
+
+    // Each node is reached with a probability proportional to its area
+    Float total = 0;
+    for (const BVHNode& node : _nodes)
+        total += nodeArea(node) * (node.numPrims > 0 ? node.numPrims * SAH_INTERSECT_COST : SAH_TRAVERSAL_COST);
+
+    const Float rootArea = nodeArea(_nodes[0]);
+    return rootArea > 0 ? total / rootArea : 0;
+}
+
+Float BVH::degradation() const {
+    return _buildCost > 0 ? _refitCost / _buildCost : 1;
+}
+
+uint32 BVH::build(BuildContext& ctx, uint32 start, uint32 end, uint32 depth) {
+    std::vector<BuildPrim>& prims = ctx.prims;
+    uint32 nodeIdx = ctx.numNodes++;
+    uint32 numPrims = end - start;
+    uint32 numPartitions = numBuildPartitions(numPrims);
+
+    // Compute bounds of the primitives and of their centroids
+    auto gatherBounds = [&prims](uint32 pStart, uint32 pEnd, Bounds3& bbox, Bounds3& cbbox) {
+        for (uint32 i = pStart; i < pEnd; ++i) {
+            bbox.expand(prims[i].bbox);
+            cbbox.expand(prims[i].centroid);
+        }
+    };
+
+    Bounds3 bbox  = Bounds3::EMPTY;
+    Bounds3 cbbox = Bounds3::EMPTY;
+    if (numPartitions == 1) {
+        gatherBounds(start, end, bbox, cbbox);
+    } else {
+        std::vector<Bounds3> partBounds(numPartitions, Bounds3::EMPTY);
+        std::vector<Bounds3> partCentroids(numPartitions, Bounds3::EMPTY);
+        Threading::parallelRange(start, end, numPartitions, [&](uint32 part, uint32 pStart, uint32 pEnd) {
+            gatherBounds(pStart, pEnd, partBounds[part], partCentroids[part]);
+        });
+
+        for (uint32 part = 0; part < numPartitions; ++part) {
+            bbox.expand(partBounds[part]);
+            cbbox.expand(partCentroids[part]);
+        }
+    }
+
+    ctx.nodes[nodeIdx].bbox = bbox;
+
+    if (numPrims == 1)
+        return makeLeaf(ctx, start, end, nodeIdx);
+
+    // Split along the axis of largest centroid extent
+    uint32 axis  = cbbox.sizes().maxDim();
+    Float  cMin  = cbbox.min()[axis];
+    Float  cSize = cbbox.max()[axis] - cMin;
+
+    // All centroids coincide, there is no way to separate them
+    uint32 midIdx = start;
+    if (cSize <= 0) {
+        if (numPrims <= BVH_MAX_LEAF_PRIMS)
+            return makeLeaf(ctx, start, end, nodeIdx);
+
+        // Too many for a single leaf, any split will do
+        midIdx = (start + end) / 2;
+    } else if (depth < BVH_MEDIAN_DEPTH) {
+        const Float binScale = BVH_NUM_BINS / cSize;
+        auto binIndex = [&](const BuildPrim& prim) {
+            uint32 b = (uint32)((prim.centroid[axis] - cMin) * binScale);
+            return std::min(b, BVH_NUM_BINS - 1);
+        };
+
+        // Project centroids into bins, in parallel each partition fills its own set
+        auto binRange = [&](uint32 pStart, uint32 pEnd, Bin* bins) {
+            for (uint32 i = pStart; i < pEnd; ++i) {
+                Bin& bin = bins[binIndex(prims[i])];
+                bin.count++;
+                bin.bbox.expand(prims[i].bbox);
+            }
+        };
+
+        Bin bins[BVH_NUM_BINS];
+        if (numPartitions == 1) {
+            binRange(start, end, bins);
+        } else {
+            std::vector<std::array<Bin, BVH_NUM_BINS>> partBins(numPartitions);
+            Threading::parallelRange(start, end, numPartitions, [&](uint32 part, uint32 pStart, uint32 pEnd) {
+                binRange(pStart, pEnd, partBins[part].data());
+            });
+
+            for (uint32 part = 0; part < numPartitions; ++part) {
+                for (uint32 b = 0; b < BVH_NUM_BINS; ++b) {
+                    bins[b].count += partBins[part][b].count;
+                    bins[b].bbox.expand(partBins[part][b].bbox);
+                }
+            }
+        }
+
+        // Sweep from the right to gather the cost terms of each right side
+        Float  rightArea[BVH_NUM_BINS - 1];
+        uint32 rightCount[BVH_NUM_BINS - 1];
+
+        Bounds3 acc = Bounds3::EMPTY;
+        uint32 count = 0;
+        for (uint32 b = BVH_NUM_BINS - 1; b > 0; --b) {
+            acc.expand(bins[b].bbox);
+            count += bins[b].count;
+
+            rightArea[b - 1]  = count > 0 ? acc.surfaceArea() : 0;
+            rightCount[b - 1] = count;
+        }
+
+        // Sweep from the left and evaluate the SAH for each split plane
+        Float  bestCost  = F_INFINITY;
+        uint32 bestSplit = 0;
+
+        acc   = Bounds3::EMPTY;
+        count = 0;
+        for (uint32 b = 0; b < BVH_NUM_BINS - 1; ++b) {
+            acc.expand(bins[b].bbox);
+            count += bins[b].count;
+
+            if (count == 0 || rightCount[b] == 0)
+                continue;
+
+            Float cost = count * acc.surfaceArea() + rightCount[b] * rightArea[b];
+            if (cost < bestCost) {
+                bestCost  = cost;
+                bestSplit = b;
+            }
+        }
+
+        Float leafCost = numPrims * SAH_INTERSECT_COST;
+        bestCost = SAH_TRAVERSAL_COST + SAH_INTERSECT_COST * bestCost / bbox.surfaceArea();
+
+        if (numPrims <= _maxPrimsInNode && leafCost <= bestCost)
+            return makeLeaf(ctx, start, end, nodeIdx);
+
+        // Partition primitives according to the chosen bin
+        auto mid = std::partition(prims.begin() + start, prims.begin() + end,
+            [&](const BuildPrim& prim) {
+                return binIndex(prim) <= bestSplit;
+            });
+
+        midIdx = (uint32)(mid - prims.begin());
+    } else if (numPrims <= _maxPrimsInNode) {
+        return makeLeaf(ctx, start, end, nodeIdx);
+    }
+
+    // Binning failed to separate the primitives (or was skipped), split them in half
+    if (midIdx == start || midIdx == end) {
+        midIdx = (start + end) / 2;
+        std::nth_element(prims.begin() + start, prims.begin() + midIdx, prims.begin() + end,
+            [axis](const BuildPrim& p1, const BuildPrim& p2) {
+                return p1.centroid[axis] < p2.centroid[axis];
+            });
+    }
+
+    // Both halves are disjoint ranges of the primitive array,
+    // so large subtrees can be built concurrently
+    uint32 children[2];
+    if (numPrims < BVH_PARALLEL_SUBTREE) {
+        children[0] = build(ctx, start, midIdx, depth + 1);
+        children[1] = build(ctx, midIdx, end, depth + 1);
+    } else {
+        uint32 ranges[3] = { start, midIdx, end };
+        Threading::parallelFor(0, 2, 2, [&](uint32 c) {
+            children[c] = build(ctx, ranges[c], ranges[c + 1], depth + 1);
+        });
+    }
+
+    BuildNode& node  = ctx.nodes[nodeIdx];
+    node.children[0] = children[0];
+    node.children[1] = children[1];
+    node.numPrims    = 0;
+    node.axis        = axis;
+
+    return nodeIdx;
+}
+
+uint32 BVH::makeLeaf(BuildContext& ctx, uint32 start, uint32 end, uint32 nodeIdx) {
+    BuildNode& node = ctx.nodes[nodeIdx];
+    node.primOffset = start;
+    node.numPrims   = end - start;
+
+    return nodeIdx;
+}
+
+void BVH::layout(BuildContext& ctx) {
+    // Lay out the final nodes depth-first
+    _nodes.reserve(ctx.numNodes);
+    flatten(ctx, 0);
+}
+
+uint32 BVH::addLeaf(BuildContext& ctx, uint32 buildIdx) {
+    uint32 firstPacket = ctx.numPackets;
+
+    ctx.numPackets += (ctx.nodes[buildIdx].numPrims + PACKET_WIDTH - 1) / PACKET_WIDTH;
+    ctx.leaves.push_back(std::make_pair(buildIdx, firstPacket));
+
+    return firstPacket;
+}
+
+uint32 BVH::flatten(BuildContext& ctx, uint32 buildIdx) {
+    const BuildNode& buildNode = ctx.nodes[buildIdx];
+
+    uint32 nodeIdx = (uint32)_nodes.size();
+    _nodes.emplace_back();
+
+    BVHNode& newNode = _nodes[nodeIdx];
+    for (uint32 i = 0; i < 3; ++i) {
+        newNode.bboxMin[i] = floatRoundDown(buildNode.bbox.min()[i]);
+        newNode.bboxMax[i] = floatRoundUp(buildNode.bbox.max()[i]);
+    }
+
+    if (buildNode.numPrims > 0) {
+        newNode.offset   = addLeaf(ctx, buildIdx);
+        newNode.numPrims = (uint16)buildNode.numPrims;
+        newNode.axis     = 0;
+
+        return nodeIdx;
+    }
+
+    // The first child is placed right after this node
+    flatten(ctx, buildNode.children[0]);
+    uint32 right = flatten(ctx, buildNode.children[1]);
+
+    BVHNode& node = _nodes[nodeIdx];
+    node.offset   = right;
+    node.numPrims = 0;
+    node.axis     = (uint8)buildNode.axis;
+
+    return nodeIdx;
+}
+
+bool BVH::intersectRay(const Ray& ray, SurfaceEvent* evt) const {
+    bool hit = false;
+    for (const Primitive& prim : _unbounded)
+        if (prim.intersectRay(ray, evt))
+            hit = true;
+
+    if (_nodes.empty())
+        return hit;
+
+    const Vec3 invDir = ray.dir().recip();
+    const uint32 dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+    const PacketRay pray(ray);
+
+    uint32 stack[BVH_STACK_SIZE];
+    uint32 stackSize = 0;
+    uint32 nodeIdx   = 0;
+
+    while (true) {
+        const BVHNode& node = _nodes[nodeIdx];
+
+        // The ray's range shrinks with each hit, culling farther nodes
+        if (intersectBox(node, ray, invDir, dirIsNeg)) {
+            if (node.numPrims > 0) {
+                touchLeaf(node.offset, node.numPrims);
+
+                TrianglePacket scratch;
+                uint32 numPackets = (node.numPrims + PACKET_WIDTH - 1) / PACKET_WIDTH;
+                for (uint32 p = 0; p < numPackets; ++p)
+                    if (intersectPacket(leafPacket(node.offset + p, &scratch), pray, ray, evt))
+                        hit = true;
+            } else {
+                // Visit the child nearest to the ray first
+                if (dirIsNeg[node.axis]) {
+                    stack[stackSize++] = nodeIdx + 1;
+                    nodeIdx = node.offset;
+                } else {
+                    stack[stackSize++] = node.offset;
+                    nodeIdx = nodeIdx + 1;
+                }
+
+                continue;
+            }
+        }
+
+        if (stackSize == 0)
+            break;
+
+        nodeIdx = stack[--stackSize];
+    }
+
+    // Mapped trees hold the faces of their single mesh
+    if (hit && _mappedPackets)
+        evt->obj = _shapes[0].get();
+
+    return hit;
+}
+
+bool BVH::isOccluded(const Ray& ray) const {
+    for (const Primitive& prim : _unbounded)
+        if (prim.isOccluded(ray))
+            return true;
+
+    if (_nodes.empty())
+        return false;
+
+    const Vec3 invDir = ray.dir().recip();
+    const uint32 dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+    const PacketRay pray(ray);
+
+    uint32 stack[BVH_STACK_SIZE];
+    uint32 stackSize = 0;
+    uint32 nodeIdx   = 0;
+
+    // Any hit ends the traversal, so child order is irrelevant
+    while (true) {
+        const BVHNode& node = _nodes[nodeIdx];
+
+        if (intersectBox(node, ray, invDir, dirIsNeg)) {
+            if (node.numPrims > 0) {
+                touchLeaf(node.offset, node.numPrims);
+
+                TrianglePacket scratch;
+                uint32 numPackets = (node.numPrims + PACKET_WIDTH - 1) / PACKET_WIDTH;
+                for (uint32 p = 0; p < numPackets; ++p)
+                    if (isOccludedPacket(leafPacket(node.offset + p, &scratch), pray, ray))
+                        return true;
+            } else {
+                stack[stackSize++] = node.offset;
+                nodeIdx = nodeIdx + 1;
+                continue;
+            }
+        }
+
+        if (stackSize == 0)
+            break;
+
+        nodeIdx = stack[--stackSize];
+    }
+
+    return false;
+}
+
+void BVH::intersectRays(const RayBatch& batch, HitBatch* hits) const {
+    for (uint32 r = 0; r < batch.size; ++r)
+        for (const Primitive& prim : _unbounded)
+            prim.intersectRay(batch.rays[r], &hits->events[r]);
+
+    if (_nodes.empty() || batch.size == 0)
+        return;
+
+    const BatchTraversal traversal(batch);
+    uint32 packetHits = 0;
+
+    // Both children are pushed, one more entry than the tree depth
+    BatchStackEntry stack[BVH_STACK_SIZE + 1];
+    uint32 stackSize = 0;
+    stack[stackSize++] = { 0, (1u << batch.size) - 1 };
+
+    while (stackSize > 0) {
+        const BatchStackEntry entry = stack[--stackSize];
+        const BVHNode& node = _nodes[entry.nodeIdx];
+
+        // Farthest reach of the active rays, shrinking with each hit
+        Float maxT = 0;
+        for (uint32 r = 0; r < batch.size; ++r)
+            if (entry.active & (1u << r))
+                maxT = std::max(maxT, batch.rays[r].maxT());
+
+        if (traversal.cull(node, maxT))
+            continue;
+
+        uint32 active = 0;
+        uint32 first  = RAY_BATCH_SIZE;
+        for (uint32 r = 0; r < batch.size; ++r) {
+            if ((entry.active & (1u << r)) &&
+                intersectBox(node, batch.rays[r], traversal.invDir[r], traversal.dirIsNeg[r])) {
+                active |= 1u << r;
+                first = std::min(first, r);
+            }
+        }
+
+        if (!active)
+            continue;
+
+        if (node.numPrims > 0) {
+            touchLeaf(node.offset, node.numPrims);
+
+            // Each packet is read once for all the rays
+            TrianglePacket scratch;
+            uint32 numPackets = (node.numPrims + PACKET_WIDTH - 1) / PACKET_WIDTH;
+            for (uint32 p = 0; p < numPackets; ++p) {
+                const TrianglePacket& packet = leafPacket(node.offset + p, &scratch);
+
+                for (uint32 r = first; r < batch.size; ++r) {
+                    if (!(active & (1u << r)))
+                        continue;
+
+                    const PacketRay pray(batch.rays[r]);
+                    if (intersectPacket(packet, pray, batch.rays[r], &hits->events[r]))
+                        packetHits |= 1u << r;
+                }
+            }
+        } else {
+            // Coherent rays agree on the near child, follow the first one
+            if (traversal.dirIsNeg[first][node.axis]) {
+                stack[stackSize++] = { entry.nodeIdx + 1, active };
+                stack[stackSize++] = { node.offset, active };
+            } else {
+                stack[stackSize++] = { node.offset, active };
+                stack[stackSize++] = { entry.nodeIdx + 1, active };
+            }
+        }
+    }
+
+    // Mapped trees hold the faces of their single mesh
+    if (_mappedPackets)
+        for (uint32 r = 0; r < batch.size; ++r)
+            if (packetHits & (1u << r))
+                hits->events[r].obj = _shapes[0].get();
+}
+
+uint32 BVH::occludedRays(const RayBatch& batch) const {
+    uint32 occluded = 0;
+    for (uint32 r = 0; r < batch.size; ++r) {
+        for (const Primitive& prim : _unbounded) {
+            if (prim.isOccluded(batch.rays[r])) {
+                occluded |= 1u << r;
+                break;
+            }
+        }
+    }
+
+    const uint32 all = batch.size > 0 ? (1u << batch.size) - 1 : 0;
+    if (_nodes.empty() || occluded == all)
+        return occluded;
+
+    const BatchTraversal traversal(batch);
+
+    BatchStackEntry stack[BVH_STACK_SIZE + 1];
+    uint32 stackSize = 0;
+    stack[stackSize++] = { 0, all & ~occluded };
+
+    while (stackSize > 0) {
+        const BatchStackEntry entry = stack[--stackSize];
+        const BVHNode& node = _nodes[entry.nodeIdx];
+
+        // Rays found occluded elsewhere are done
+        const uint32 pending = entry.active & ~occluded;
+        if (!pending)
+            continue;
+
+        Float maxT = 0;
+        for (uint32 r = 0; r < batch.size; ++r)
+            if (pending & (1u << r))
+                maxT = std::max(maxT, batch.rays[r].maxT());
+
+        if (traversal.cull(node, maxT))
+            continue;
+
+        uint32 active = 0;
+        for (uint32 r = 0; r < batch.size; ++r)
+            if ((pending & (1u << r)) &&
+                intersectBox(node, batch.rays[r], traversal.invDir[r], traversal.dirIsNeg[r]))
+                active |= 1u << r;
+
+        if (!active)
+            continue;
+
+        if (node.numPrims > 0) {
+            touchLeaf(node.offset, node.numPrims);
+
+            TrianglePacket scratch;
+            uint32 numPackets = (node.numPrims + PACKET_WIDTH - 1) / PACKET_WIDTH;
+            for (uint32 p = 0; p < numPackets && (active & ~occluded); ++p) {
+                const TrianglePacket& packet = leafPacket(node.offset + p, &scratch);
+
+                for (uint32 r = 0; r < batch.size; ++r) {
+                    if (!(active & ~occluded & (1u << r)))
+                        continue;
+
+                    const PacketRay pray(batch.rays[r]);
+                    if (isOccludedPacket(packet, pray, batch.rays[r]))
+                        occluded |= 1u << r;
+                }
+            }
+
+            if (occluded == all)
+                break;
+        } else {
+            stack[stackSize++] = { node.offset, active };
+            stack[stackSize++] = { entry.nodeIdx + 1, active };
+        }
+    }
+
+    return occluded;
+}
+
+void BVH::writeCache(Utils::CacheWriter& writer) const {
+    // Faces reference their mesh, which is the shape itself
+    std::unordered_map<const Shape*, uint32> shapeIdx;
+    for (uint32 s = 0; s < _shapes.size(); ++s) {
+        shapeIdx[_shapes[s].get()] = s;
+        if (_shapes[s]->triMesh())
+            shapeIdx[_shapes[s]->triMesh()] = s;
+    }
+
+    auto indexOf = [&shapeIdx](const Shape* shape) {
+        return shape ? shapeIdx.at(shape) : CACHE_NO_SHAPE;
+    };
+
+    const uint64 numPackets = _compact ? _refs.size() : _packets.size();
+
+    BVHCacheInfo info;
+    info.numNodes       = _nodes.size();
+    info.numPackets     = numPackets;
+    info.numUnbounded   = _unbounded.size();
+    info.numShapes      = (uint32)_shapes.size();
+    info.maxPrimsInNode = _maxPrimsInNode;
+    info.compact        = _compact;
+    info.pad            = 0;
+    info.cost           = _buildCost;
+    for (uint32 i = 0; i < 3; ++i) {
+        info.bboxMin[i] = _bounds.min()[i];
+        info.bboxMax[i] = _bounds.max()[i];
+    }
+
+    std::vector<uint32> lanes(numPackets * PACKET_WIDTH);
+    for (uint32 p = 0; p < numPackets; ++p)
+        for (uint32 lane = 0; lane < PACKET_WIDTH; ++lane)
+            lanes[p * PACKET_WIDTH + lane] = indexOf(_compact ? _refs[p].shapes[lane] : _packets[p].shapes[lane]);
+
+    std::vector<uint32> unbounded(_unbounded.size());
+    for (uint32 u = 0; u < _unbounded.size(); ++u)
+        unbounded[u] = indexOf(_unbounded[u].shape);
+
+    writer.addChunk(Utils::CACHE_BVH, &info, sizeof(BVHCacheInfo));
+    writer.addChunk(Utils::CACHE_BVH_NODES, _nodes.data(), _nodes.size() * sizeof(BVHNode));
+    if (_compact)
+        writer.addChunk(Utils::CACHE_BVH_PACKETS, _refs.data(), _refs.size() * sizeof(FaceRefPacket));
+    else
+        writer.addChunk(Utils::CACHE_BVH_PACKETS, _packets.data(), _packets.size() * sizeof(TrianglePacket));
+    writer.addChunk(Utils::CACHE_BVH_LANES, lanes.data(), lanes.size() * sizeof(uint32));
+    writer.addChunk(Utils::CACHE_BVH_UNBOUNDED, unbounded.data(), unbounded.size() * sizeof(uint32));
+}
+
+bool BVH::readCache(const Utils::CacheFile& file) {
+    Utils::Timer timer;
+
+    // The tree must have been built over the same shapes
+    const BVHCacheInfo* info = validCacheInfo(file, _shapes.size(), _maxPrimsInNode);
+    if (!info)
+        return false;
+
+    size_t nodesSize, packetsSize;
+    const uint8* nodes      = file.chunk(Utils::CACHE_BVH_NODES, &nodesSize);
+    const uint8* packets    = file.chunk(Utils::CACHE_BVH_PACKETS, &packetsSize);
+    const uint32* lanes     = (const uint32*)file.chunk(Utils::CACHE_BVH_LANES, nullptr);
+    const uint32* unbounded = (const uint32*)file.chunk(Utils::CACHE_BVH_UNBOUNDED, nullptr);
+
+    _mappedPackets = nullptr;
+    _mappedRefs    = nullptr;
+    _mappedMesh    = nullptr;
+    _pages.reset();
+    _mappedFile.reset();
+
+    _nodes.resize((size_t)info->numNodes);
+    memcpy(_nodes.data(), nodes, nodesSize);
+
+    // Packets are copied as they were, only their shapes are restored
+    auto restoreShapes = [&](auto& leaves) {
+        leaves.resize((size_t)info->numPackets);
+        memcpy(leaves.data(), packets, packetsSize);
+
+        for (uint32 p = 0; p < leaves.size(); ++p) {
+            auto& packet = leaves[p];
+
+            for (uint32 lane = 0; lane < PACKET_WIDTH; ++lane) {
+                const uint32 idx = lanes[p * PACKET_WIDTH + lane];
+                if (idx == CACHE_NO_SHAPE)
+                    packet.shapes[lane] = nullptr;
+                else if (packet.shapeMask & (1 << lane))
+                    packet.shapes[lane] = _shapes[idx].get();
+                else
+                    packet.shapes[lane] = _shapes[idx]->triMesh();
+            }
+        }
+    };
+
+    _compact = info->compact != 0;
+    _packets.clear();
+    _refs.clear();
+    if (_compact)
+        restoreShapes(_refs);
+    else
+        restoreShapes(_packets);
+
+    _unbounded.clear();
+    for (uint64 u = 0; u < info->numUnbounded; ++u)
+        _unbounded.push_back({ Point3(0), Vec3(0), Vec3(0), _shapes[unbounded[u]].get(), PRIM_NOT_FACE });
+
+    _bounds = Bounds3::EMPTY;
+    if (info->numNodes > 0)
+        _bounds = Bounds3(Point3(info->bboxMin[0], info->bboxMin[1], info->bboxMin[2]),
+                          Point3(info->bboxMax[0], info->bboxMax[1], info->bboxMax[2]));
+
+    _buildCost = _refitCost = info->cost;
+
+    timer.stop();
+    _buildTime = timer.elapsed();
+
+    return true;
+}
+
+bool BVH::mapCache(const std::shared_ptr<Utils::CacheFile>& file) {
+    // Faces reference their mesh through the shape pointers of the
+    // lanes, which are only known if the mesh is the single shape
+    if (_shapes.size() != 1 || _shapes[0]->triMesh() != _shapes[0].get())
+        return false;
+
+    Utils::Timer timer;
+
+    const BVHCacheInfo* info = validCacheInfo(*file, _shapes.size(), _maxPrimsInNode);
+    if (!info || info->numUnbounded > 0)
+        return false;
+
+    size_t nodesSize;
+    const uint8* nodes = file->chunk(Utils::CACHE_BVH_NODES, &nodesSize);
+
+    _nodes.resize((size_t)info->numNodes);
+    memcpy(_nodes.data(), nodes, nodesSize);
+
+    // Release the packets of an earlier build
+    std::vector<TrianglePacket, Utils::AlignedAllocator<TrianglePacket>>().swap(_packets);
+    std::vector<FaceRefPacket>().swap(_refs);
+    _unbounded.clear();
+
+    const uint8* packets = file->chunk(Utils::CACHE_BVH_PACKETS, nullptr);
+    _compact = info->compact != 0;
+
+    _mappedFile       = file;
+    _mappedPackets    = _compact ? nullptr : (const TrianglePacket*)packets;
+    _mappedRefs       = _compact ? (const FaceRefPacket*)packets : nullptr;
+    _mappedMesh       = _compact ? _shapes[0]->triMesh() : nullptr;
+    _numMappedPackets = info->numPackets;
+    _pages.reset();
+    if (_numMappedPackets > 0)
+        _pages = std::make_unique<Utils::PagedRegion>(packets, _numMappedPackets *
+                                                      (_compact ? sizeof(FaceRefPacket) : sizeof(TrianglePacket)));
+
+    _bounds = Bounds3::EMPTY;
+    if (info->numNodes > 0)
+        _bounds = Bounds3(Point3(info->bboxMin[0], info->bboxMin[1], info->bboxMin[2]),
+                          Point3(info->bboxMax[0], info->bboxMax[1], info->bboxMax[2]));
+
+    _buildCost = _refitCost = info->cost;
+
+    timer.stop();
+    _buildTime = timer.elapsed();
+
+    return true;
+}
+
+void BVH::ownPackets() {
+    if (!_mappedPackets)
+        return;
+
+    const uint32* lanes = (const uint32*)_mappedFile->chunk(Utils::CACHE_BVH_LANES, nullptr);
+    const TriMesh* mesh = _shapes[0]->triMesh();
+
+    _packets.assign(_mappedPackets, _mappedPackets + _numMappedPackets);
+    for (uint32 p = 0; p < _packets.size(); ++p)
+        for (uint32 lane = 0; lane < PACKET_WIDTH; ++lane)
+            _packets[p].shapes[lane] = lanes[p * PACKET_WIDTH + lane] == CACHE_NO_SHAPE ? nullptr : mesh;
+
+    _mappedPackets = nullptr;
+    _pages.reset();
+    _mappedFile.reset();
+}
+
+Bounds3 BVH::bounds() const {
+    return _bounds;
+}
+
+uint32 BVH::numNodes() const {
+    return (uint32)_nodes.size();
+}
+
+double BVH::buildTime() const {
+    return _buildTime;
+}
+
+double BVH::refitTime() const {
+    return _refitTime;
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <limits>
+#include <cmath>
+
+#include <Accelerator.h>
+#include <Memory.h>
+#include <Bounds.h>
+#include <Shape.h>
+#include <Primitive.h>
+#include <TrianglePacket.h>
+#include <SceneCache.h>
+#include <PageCache.h>
+
+namespace Photon {
+
+    static const uint32 BVH_NUM_BINS       = 16;
+    static const uint32 BVH_STACK_SIZE     = 64;
+    static const uint32 BVH_MAX_LEAF_PRIMS = 0xFFFF;
+
+    // Nodes are laid out depth-first in a single array, so the first child
+    // of an interior node always follows it and only the second is indexed.
+    // Bounds are stored in single precision, rounded outwards, to fit two
+    // nodes per cache line.
+    struct alignas(32) BVHNode {
+        float  bboxMin[3];
+        uint32 offset;        // First primitive (leaves) or second child (interior)
+        float  bboxMax[3];
+        uint16 numPrims;      // Number of primitives, zero if interior
+        uint8  axis;          // Split axis (interior)
+        uint8  pad;
+    };
+
+    static_assert(sizeof(BVHNode) == 32, "BVHNode must fit in 32 bytes");
+
+    // Single precision bounds must never shrink the box
+    inline float floatRoundDown(Float val) {
+        float f = (float)val;
+        return f > val ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+    }
+
+    inline float floatRoundUp(Float val) {
+        float f = (float)val;
+        return f < val ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+    }
+
+    // Bounding volume hierarchy built with the binned surface area heuristic
+    class BVH : public Accelerator {
+    public:
+        BVH(const std::vector<std::shared_ptr<Shape>>& shapes, uint32 maxPrimsInNode = 4);
+
+        void initialize();
+
+        bool intersectRay(const Ray& ray, SurfaceEvent* evt) const;
+        bool isOccluded(const Ray& ray) const;
+
+        void intersectRays(const RayBatch& batch, HitBatch* hits) const;
+        uint32 occludedRays(const RayBatch& batch) const;
+
+        Bounds3 bounds() const;
+
+        // Primitives are read again from their meshes and shapes,
+        // they must be the same ones the tree was built with
+        bool refit();
+        Float degradation() const;
+
+        // Compiled scene cache, shapes are stored by their index so the
+        // tree can be read back over the same shapes in a later run
+        void writeCache(Utils::CacheWriter& writer) const;
+        bool readCache(const Utils::CacheFile& file);
+
+        // Reads the leaf packets of a mesh tree in place, their residency
+        // is then bounded by the page cache. Only the nodes are copied.
+        bool mapCache(const std::shared_ptr<Utils::CacheFile>& file);
+
+        virtual uint32 numNodes() const;
+        double buildTime() const;
+        double refitTime() const;
+
+    protected:
+        struct BuildPrim {
+            Bounds3 bbox;
+            Point3  centroid;
+            uint32  idx;
+        };
+
+        struct Bin {
+            Bounds3 bbox;
+            uint32  count;
+
+            Bin() : bbox(Bounds3::EMPTY), count(0) { }
+        };
+
+        // Temporary node, subtrees are built concurrently so the
+        // depth-first layout can only be produced once all are done
+        struct BuildNode {
+            Bounds3 bbox;
+            uint32  children[2];
+            uint32  primOffset;
+            uint32  numPrims;
+            uint32  axis;
+        };
+
+        struct BuildContext {
+            std::vector<BuildPrim> prims;
+            std::vector<BuildNode> nodes;
+            std::atomic<uint32> numNodes;
+
+            // Leaves as (build node, first packet) pairs, filled during layout
+            std::vector<std::pair<uint32, uint32>> leaves;
+            uint32 numPackets;
+        };
+
+        // Turns the binary build tree into the final nodes
+        virtual void layout(BuildContext& ctx);
+
+        // Reserves the packets of a leaf, returning the first one
+        uint32 addLeaf(BuildContext& ctx, uint32 buildIdx);
+
+        // Leaves are read through these. Mapped leaves are tracked once per
+        // visit, and compact trees decode each packet into the scratch one.
+        void touchLeaf(uint32 offset, uint32 numPrims) const {
+            if (!_pages)
+                return;
+
+            const uint32 numPackets = (numPrims + PACKET_WIDTH - 1) / PACKET_WIDTH;
+            if (_compact)
+                _pages->touch(&_mappedRefs[offset], numPackets * sizeof(FaceRefPacket));
+            else
+                _pages->touch(&_mappedPackets[offset], numPackets * sizeof(TrianglePacket));
+        }
+
+        const TrianglePacket& leafPacket(uint32 idx, TrianglePacket* scratch) const {
+            if (!_compact)
+                return _mappedPackets ? _mappedPackets[idx] : _packets[idx];
+
+            (_mappedRefs ? _mappedRefs[idx] : _refs[idx]).decode(scratch, _mappedMesh);
+            return *scratch;
+        }
+
+        std::vector<BVHNode, Utils::AlignedAllocator<BVHNode>> _nodes;
+        std::vector<TrianglePacket, Utils::AlignedAllocator<TrianglePacket>> _packets;  // Leaf primitives
+        std::vector<FaceRefPacket> _refs;   // Or only their references, in compact trees
+        std::vector<Primitive> _unbounded;  // Primitives tested outside the tree
+        Bounds3 _bounds;
+
+        // Trees over compressed meshes keep references to the faces, a
+        // full packet would take several times the memory of the mesh
+        bool _compact;
+
+    private:
+        uint32 build(BuildContext& ctx, uint32 start, uint32 end, uint32 depth);
+        uint32 makeLeaf(BuildContext& ctx, uint32 start, uint32 end, uint32 nodeIdx);
+        uint32 flatten(BuildContext& ctx, uint32 buildIdx);
+
+        // Copies the mapped packets so they can be modified
+        void ownPackets();
+
+        // Surface area heuristic cost of the final nodes
+        Float cost() const;
+
+        std::vector<std::shared_ptr<Shape>> _shapes;
+        uint32 _maxPrimsInNode;
+        double _buildTime;          // Milliseconds spent in the last build
+        double _refitTime;          // Milliseconds spent in the last refit
+        Float  _buildCost;          // Cost of the tree when built and after the last refit
+        Float  _refitCost;
+
+        // Packets read in place from a cache, their lanes hold the shape
+        // pointers of the run that wrote them and are never followed.
+        // Mapped references decode their faces from the tree's mesh.
+        std::shared_ptr<Utils::CacheFile> _mappedFile;
+        const TrianglePacket* _mappedPackets;
+        const FaceRefPacket*  _mappedRefs;
+        const TriMesh* _mappedMesh;
+        uint64 _numMappedPackets;
+        std::unique_ptr<Utils::PagedRegion> _pages;
+    };
+
+}
\ No newline at end of file
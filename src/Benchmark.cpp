@@ -0,0 +1,271 @@
+#include <Benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <atomic>
+#include <vector>
+
+#include <Scene.h>
+#include <Camera.h>
+#include <Accelerator.h>
+#include <Random.h>
+#include <Sampling.h>
+#include <Threading.h>
+#include <Timer.h>
+#include <MappedFile.h>
+#include <NFFParser.h>
+#include <Distribution.h>
+#include <Sphere.h>
+
+using namespace Photon;
+using namespace Photon::Threading;
+
+static const uint32 BENCH_CHUNKS = 256;
+
+// Traces all rays over the worker pool and returns the elapsed time in ms
+static double traceRays(const std::vector<Ray>& rays, std::function<bool(const Ray&)> trace, uint32* numHits) {
+    std::atomic<uint32> hits(0);
+    const uint32 chunkSize = ((uint32)rays.size() + BENCH_CHUNKS - 1) / BENCH_CHUNKS;
+
+    Utils::Timer timer;
+    parallelFor(0, BENCH_CHUNKS, BENCH_CHUNKS, [&](uint32 chunk) {
+        uint32 start = chunk * chunkSize;
+        uint32 end   = std::min(start + chunkSize, (uint32)rays.size());
+
+        uint32 chunkHits = 0;
+        for (uint32 r = start; r < end; ++r)
+            if (trace(rays[r]))
+                chunkHits++;
+
+        hits += chunkHits;
+    });
+    timer.stop();
+
+    *numHits = hits;
+
+    return timer.elapsed();
+}
+
+void Utils::benchmarkAccelerators(const Scene& scene, uint32 numRays) {
+    const Camera& camera = scene.getCamera();
+    RandGen rng;
+
+    // Primary rays through random film positions, at random shutter times
+    std::vector<Ray> primary(numRays);
+    for (uint32 r = 0; r < numRays; ++r) {
+        Point2 raster = Point2(rng.uniform1D() * camera.width(),
+                               rng.uniform1D() * camera.height());
+
+        primary[r] = camera.primaryRay(raster, rng.uniform2D());
+        primary[r].setTime(rng.uniform1D());
+    }
+
+    // Incoherent secondary rays leaving the primary hits
+    std::vector<Ray> secondary;
+    secondary.reserve(numRays);
+
+    std::unique_ptr<Accelerator> ref = scene.buildAccelerator(BVH_ACCELERATOR);
+    for (uint32 r = 0; r < numRays; ++r) {
+        Ray ray = primary[r];
+        SurfaceEvent evt;
+        if (!ref->intersectRay(ray, &evt))
+            continue;
+
+        Vec3 dir = sampleUniformSphere(rng.uniform2D()).posVec();
+        if (dot(evt.normal, dir) < 0)
+            dir = -dir;
+
+        secondary.push_back(evt.spawnRay(dir));
+    }
+    ref.reset();
+
+    std::cout << "Accelerator benchmark: " << scene.getShapes().size() << " shapes, "
+              << primary.size() << " primary and " << secondary.size() << " secondary rays, "
+              << Workers->numThreads() << " threads" << std::endl;
+
+    const AcceleratorType types[4] = { GRID_ACCELERATOR, BVH_ACCELERATOR, WIDE_BVH_ACCELERATOR, MOTION_BVH_ACCELERATOR };
+    for (AcceleratorType type : types) {
+        Utils::Timer buildTimer;
+        std::unique_ptr<Accelerator> accel = scene.buildAccelerator(type);
+        buildTimer.stop();
+
+        uint32 primaryHits, secondaryHits, occludedHits;
+
+        // Closest hit queries, rays are copied since their range shrinks
+        double primaryTime = traceRays(primary, [&](const Ray& r) {
+            Ray ray = r;
+            SurfaceEvent evt;
+            return accel->intersectRay(ray, &evt);
+        }, &primaryHits);
+
+        double secondaryTime = traceRays(secondary, [&](const Ray& r) {
+            Ray ray = r;
+            SurfaceEvent evt;
+            return accel->intersectRay(ray, &evt);
+        }, &secondaryHits);
+
+        // Any hit queries
+        double occludedTime = traceRays(secondary, [&](const Ray& r) {
+            return accel->isOccluded(r);
+        }, &occludedHits);
+
+        std::cout << "  " << acceleratorName(type) << ": build " << buildTimer.elapsed() << " ms, "
+                  << "primary " << primary.size() / (primaryTime * 1000.0) << " Mrays/s (" << primaryHits << " hits), "
+                  << "secondary " << secondary.size() / (secondaryTime * 1000.0) << " Mrays/s (" << secondaryHits << " hits), "
+                  << "occlusion " << secondary.size() / (occludedTime * 1000.0) << " Mrays/s (" << occludedHits << " hits)"
+                  << std::endl;
+    }
+}
+
+void Utils::benchmarkWorkerPool(uint32 maxThreads) {
+    const uint32 numSubtasks = 1 << 18;
+    const uint32 numNested   = 1 << 12;
+
+    std::cout << "Worker pool benchmark: " << numSubtasks << " subtasks, "
+              << numNested << " nested tasks of 16 subtasks" << std::endl;
+
+    for (uint32 numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+        WorkerPool pool(numThreads);
+        std::atomic<uint32> counter(0);
+
+        // A single task of many empty subtasks, dominated by dispatch
+        Utils::Timer flatTimer;
+        pool.pushTask([&](uint32, uint32, uint32) { counter++; }, numSubtasks)->wait();
+        flatTimer.stop();
+
+        // Small tasks pushed from within subtasks, as nested parallel loops do
+        Utils::Timer nestedTimer;
+        pool.pushTask([&](uint32, uint32, uint32) {
+            std::shared_ptr<Task> inner = pool.pushTask([&](uint32, uint32, uint32) { counter++; }, 16);
+            pool.yield(*inner);
+        }, numNested)->wait();
+        nestedTimer.stop();
+
+        std::cout << "  " << numThreads << " threads: "
+                  << flatTimer.elapsed() * 1e6 / numSubtasks << " ns per subtask, "
+                  << nestedTimer.elapsed() * 1e6 / (numNested * 17) << " ns per nested subtask" << std::endl;
+    }
+}
+
+void Utils::benchmarkSceneParser(const std::string& filePath, uint32 numRuns) {
+    size_t fileSize = MappedFile(filePath).size();
+
+    // The first parse loads the meshes, the others find them in the resources
+    Utils::Timer firstTimer;
+    NFFParser::fromFile(filePath);
+    firstTimer.stop();
+
+    Utils::Timer timer;
+    for (uint32 r = 0; r < numRuns; ++r)
+        NFFParser::fromFile(filePath);
+    timer.stop();
+
+    double runTime = timer.elapsed() / numRuns;
+
+    std::cout << "Scene parser benchmark: " << fileSize << " bytes, " << numRuns << " runs" << std::endl;
+    std::cout << "  first parse " << firstTimer.elapsed() << " ms, "
+              << "then " << runTime << " ms per parse, "
+              << fileSize / (runTime * 1000.0) << " MB/s" << std::endl;
+}
+
+void Utils::benchmarkLightSampling(uint32 numLights, uint32 numSamples) {
+    RandGen rng;
+
+    // Powers spanning a few orders of magnitude, as lights of a mesh do
+    std::vector<Float> powers(numLights);
+    for (uint32 l = 0; l < numLights; ++l)
+        powers[l] = std::pow((Float)10, 3 * rng.uniform1D());
+
+    Utils::Timer buildTimer;
+    DiscretePdf1D distr(powers);
+    buildTimer.stop();
+
+    std::vector<Float> rands(numSamples);
+    for (uint32 s = 0; s < numSamples; ++s)
+        rands[s] = rng.uniform1D();
+
+    // Both are summed so the loops aren't optimized away
+    std::vector<uint32> aliasCount(numLights, 0);
+    Float aliasSum = 0;
+
+    Utils::Timer aliasTimer;
+    for (uint32 s = 0; s < numSamples; ++s) {
+        const uint32 idx = distr.sample(rands[s]);
+        aliasSum += distr.pdf(idx);
+        aliasCount[idx]++;
+    }
+    aliasTimer.stop();
+
+    std::vector<uint32> cdfCount(numLights, 0);
+    Float cdfSum = 0;
+
+    Utils::Timer cdfTimer;
+    for (uint32 s = 0; s < numSamples; ++s) {
+        const uint32 idx = distr.sampleCdf(rands[s]);
+        cdfSum += distr.pdf(idx);
+        cdfCount[idx]++;
+    }
+    cdfTimer.stop();
+
+    // Both should follow the distribution, only the order of the entries differs
+    Float aliasError = 0;
+    Float cdfError   = 0;
+    for (uint32 l = 0; l < numLights; ++l) {
+        const Float expected = distr.pdf(l) * numSamples;
+        aliasError += std::abs(aliasCount[l] - expected);
+        cdfError   += std::abs(cdfCount[l] - expected);
+    }
+
+    std::cout << "Light sampling benchmark: " << numLights << " lights, " << numSamples << " samples, "
+              << "alias table built in " << buildTimer.elapsed() << " ms" << std::endl;
+    std::cout << "  alias table " << aliasTimer.elapsed() * 1e6 / numSamples << " ns per sample, "
+              << "mean pdf " << aliasSum / numSamples << ", error " << aliasError / numSamples << std::endl;
+    std::cout << "  CDF search "  << cdfTimer.elapsed() * 1e6 / numSamples << " ns per sample, "
+              << "mean pdf " << cdfSum / numSamples << ", error " << cdfError / numSamples << std::endl;
+}
+
+bool Utils::testSignedZeroRays() {
+    // A grid of spheres, so the rays cross several levels of the trees
+    Scene scene;
+    for (int32 x = -2; x <= 2; ++x)
+        for (int32 y = -2; y <= 2; ++y)
+            scene.addShape(std::make_shared<Sphere>(Point3(4.0 * x, 4.0 * y, 0), 1));
+
+    const AcceleratorType types[3] = { BVH_ACCELERATOR, WIDE_BVH_ACCELERATOR, MOTION_BVH_ACCELERATOR };
+
+    bool passed = true;
+    for (AcceleratorType type : types) {
+        std::unique_ptr<Accelerator> accel = scene.buildAccelerator(type);
+
+        uint32 numRays = 0, numMissed = 0, numUnoccluded = 0;
+        for (const std::shared_ptr<Shape>& shape : scene.getShapes()) {
+            const Point3 center = shape->bbox().center();
+
+            for (uint32 axis = 0; axis < 3; ++axis) {
+                for (Float sign : { 1.0, -1.0 }) {
+                    Vec3 dir(-0.0, -0.0, -0.0);
+                    dir[axis] = sign;
+
+                    Ray ray(center, dir);
+                    SurfaceEvent evt;
+                    if (!accel->intersectRay(ray, &evt))
+                        numMissed++;
+                    if (!accel->isOccluded(Ray(center, dir)))
+                        numUnoccluded++;
+
+                    numRays++;
+                }
+            }
+        }
+
+        std::cout << "  " << acceleratorName(type) << ": " << numRays << " rays, "
+                  << numMissed << " missed, " << numUnoccluded << " unoccluded" << std::endl;
+
+        if (numMissed > 0 || numUnoccluded > 0)
+            passed = false;
+    }
+
+    return passed;
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+#include <PhotonMath.h>
+
+namespace Photon {
+
+    // Forward declaration
+    class Scene;
+
+    namespace Utils {
+
+        // Compares build time and ray throughput of the available accelerators
+        void benchmarkAccelerators(const Scene& scene, uint32 numRays);
+
+        // Measures the task dispatch overhead of worker pools of 1 up to maxThreads threads
+        void benchmarkWorkerPool(uint32 maxThreads);
+
+        // Measures the throughput of the scene parser over a number of parses of the same file
+        void benchmarkSceneParser(const std::string& filePath, uint32 numRuns);
+
+        // Compares the alias table of the light distribution to a binary search of its CDF
+        void benchmarkLightSampling(uint32 numLights, uint32 numSamples);
+
+        // Checks that the BVHs hit spheres from within along the axes, with the other
+        // direction components set to -0. Returns false on any miss.
+        bool testSignedZeroRays();
+
+    }
+
+}
\ No newline at end of file
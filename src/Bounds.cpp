@@ -6,6 +6,7 @@
 using namespace Photon;
 
 const Bounds3 Bounds3::UNBOUNDED = Bounds3();
+const Bounds3 Bounds3::EMPTY = Bounds3(Point3(F_INFINITY), Point3(-F_INFINITY));
 
 const Point3& Bounds3::min() const {
     return _min;
@@ -74,6 +75,11 @@ Float Bounds3::volume() const {
     return len.cube();
 }
 
+Float Bounds3::surfaceArea() const {
+    Vec3 len = _max - _min;
+    return 2 * (len.x * len.y + len.x * len.z + len.y * len.z);
+}
+
 Sphere Bounds3::sphere() const {
     Point3 pos = center();
     Float radius = dist(_max, pos);
@@ -11,6 +11,7 @@ namespace Photon {
     class Bounds3 {
     public:
         static const Bounds3 UNBOUNDED;
+        static const Bounds3 EMPTY;
 
         Bounds3() : _min(-F_INFINITY), _max(F_INFINITY) { }
         Bounds3(const Point3& pt) : _min(pt), _max(pt) { }
@@ -24,6 +25,7 @@ namespace Photon {
         Vec3   sizes() const;
         Point3 center() const;
         Float  volume() const;
+        Float  surfaceArea() const;
         Sphere sphere() const;
 
         bool intersectPts(const Ray& ray, Float* t0, Float* t1) const;    
@@ -6,10 +6,10 @@ namespace Photon {
 
     class BoxFilter : public Filter {
     public:
-        BoxFilter() { }
-
-        
-    private:
+        BoxFilter(const Vec2& radius = Vec2(0.5)) : Filter(radius) { }
 
+        Float evaluate(const Point2& p) const {
+            return 1;
+        }
     };
 }
\ No newline at end of file
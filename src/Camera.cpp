@@ -4,8 +4,28 @@
 using namespace Photon;
 
 Camera::Camera(const Transform& camToWorld, Vec2ui res, Float near, Float far)
-    : _film(res), _camToWorld(camToWorld),
-      _near(near), _far(far), _lens({ 0, 1, 1 }) {} // 2.3 and 3.7
+    : _film(res), _camToWorld(camToWorld), _animation(camToWorld),
+      _near(near), _far(far), _shutterOpen(0), _shutterClose(1), _lens({ 0, 1, 1 }) {} // 2.3 and 3.7
+
+void Camera::setShutter(Float open, Float close) {
+    _shutterOpen  = Math::clamp(open, 0, 1);
+    _shutterClose = Math::clamp(close, _shutterOpen, 1);
+}
+
+void Camera::setAnimation(const AnimatedTransform& animation) {
+    _animation = animation;
+    setFrame(0);
+}
+
+void Camera::setFrame(Float time) {
+    if (!_animation.isAnimated())
+        return;
+
+    // The projection is kept, only the view plane moves along
+    _camToWorld = _animation.interpolate(time);
+    _n = normalize(_camToWorld(Normal(0, 0, 1)));
+    _worldToPlane = inverse(_planeToCam) * inverse(_camToWorld);
+}
 
 void Camera::setLensParams(Float radius, Float focalDist) {
     _lens.radius = radius;
@@ -44,11 +64,14 @@ Ray Camera::primaryRay(const Point2& pixel, const Point2& lens) const {
     return ray;
 }
 
-Ray Camera::primaryRay(const Point2ui& pixel, Sampler& sampler) const {
+Ray Camera::primaryRay(const Point2ui& pixel, Sampler& sampler, Point2* pFilm) const {
     // Sample point in pixel square
     Point2 rand   = sampler.next2D();
     Point2 uPixel = Point2(pixel.x + rand.x, pixel.y + rand.y);
 
+    if (pFilm)
+        *pFilm = uPixel;
+
     Point3 origin = Point3(0, 0, 0);
     Point3 pPlane = Point3(uPixel.x, uPixel.y, 0);
 
@@ -71,7 +94,7 @@ Ray Camera::primaryRay(const Point2ui& pixel, Sampler& sampler) const {
         ray = Ray(origin, rDir, _near);
     }
 
-    ray.setTime(sampler.next1D());
+    ray.setTime(Math::lerp(sampler.next1D(), _shutterOpen, _shutterClose));
 
     ray = _camToWorld(ray);
     ray.setPrimary(true);
@@ -8,6 +8,7 @@
 #include <Film.h>
 
 #include <Transform.h>
+#include <Animation.h>
 #include <Sampler.h>
 
 #include <Records.h>
@@ -16,7 +17,7 @@ namespace Photon {
 
     class Camera {
     public:
-        Camera() : _film(Vec2ui(1280, 720)) { }
+        Camera() : _film(Vec2ui(1280, 720)), _animation(Transform()), _shutterOpen(0), _shutterClose(1) { }
         Camera(const Transform& camToWorld, Vec2ui res, Float near, Float far);
         
         uint32 width() const {
@@ -35,9 +36,29 @@ namespace Photon {
             _near = hither;
         }
 
-        Ray primaryRay(const Point2ui& pixel, Sampler& sampler) const;
+        // The sampled film position is returned in pFilm, if given
+        Ray primaryRay(const Point2ui& pixel, Sampler& sampler, Point2* pFilm = nullptr) const;
         Ray primaryRay(const Point2& pixel, const Point2& lens) const;
 
+        // Number of 2D sampler dimensions drawn by primaryRay
+        uint32 primaryRayDims() const {
+            return _lens.radius > 0 ? 2 : 1;
+        }
+
+        // Number of 1D dimensions drawn by primaryRay, the shutter time
+        uint32 primaryRayDims1D() const {
+            return 1;
+        }
+
+        // Interval of the frame during which the shutter is open, as fractions of it
+        void setShutter(Float open, Float close);
+
+        // Keyframes of the placement of the camera over a sequence
+        void setAnimation(const AnimatedTransform& animation);
+
+        // Moves the camera to the given time of its animation, in [0, 1]
+        void setFrame(Float time);
+
         Film& film() const {
             return _film;
         }
@@ -87,6 +108,8 @@ namespace Photon {
         //Transform _camToPlane;
 
         Transform _worldToPlane;
+
+        AnimatedTransform _animation;
         
         Float _fov;
         Float _near;
@@ -94,6 +117,9 @@ namespace Photon {
 
         Normal _n;
 
+        Float _shutterOpen;
+        Float _shutterClose;
+
         struct Lens {
             Float radius;
             Float focalDist;
@@ -1,5 +1,9 @@
 #include <Distribution.h>
 
+#include <algorithm>
+
+#include <Random.h>
+
 using namespace Photon;
 
 DiscretePdf1D::DiscretePdf1D(const std::vector<Float>& vals) {
@@ -10,24 +14,83 @@ DiscretePdf1D::DiscretePdf1D(const std::vector<Float>& vals) {
     for (uint32 idx = 0; idx < size; ++idx)
         _f[idx] = vals[idx];
 
+    _sum = 0;
+    for (uint32 idx = 0; idx < size; ++idx)
+        _sum += _f[idx];
+
+    // Normalized probabilities, uniform if nothing can be sampled
+    _pdf.resize(size);
+    for (uint32 idx = 0; idx < size; ++idx)
+        _pdf[idx] = (_sum > 0) ? _f[idx] / _sum : (Float)1 / size;
+
     // Build CDF
     _cdf.resize(size + 1);
 
     _cdf[0] = 0;
     for (uint32 idx = 1; idx < (size + 1); ++idx)
-        _cdf[idx] += _cdf[idx - 1] + _f[idx - 1] / size;
+        _cdf[idx] = _cdf[idx - 1] + _pdf[idx - 1];
 
-    // Normalize CDF
-    _sum = _cdf[size];
-    for (uint32 idx = 1; idx < (size + 1); ++idx)
-        _cdf[idx] /= _sum;
+    if (size > 0)
+        _cdf[size] = 1;
+
+    buildAliasTable();
+}
+
+// Vose's construction, buckets under the average probability are
+// topped up by those over it
+void DiscretePdf1D::buildAliasTable() {
+    const uint32 size = (uint32)_pdf.size();
+
+    _prob.resize(size);
+    _alias.resize(size);
+
+    std::vector<uint32> small, large;
+    small.reserve(size);
+    large.reserve(size);
+
+    std::vector<Float> scaled(size);
+    for (uint32 idx = 0; idx < size; ++idx) {
+        scaled[idx] = _pdf[idx] * size;
+
+        if (scaled[idx] < 1)
+            small.push_back(idx);
+        else
+            large.push_back(idx);
+    }
+
+    while (!small.empty() && !large.empty()) {
+        const uint32 s = small.back();
+        const uint32 l = large.back();
+        small.pop_back();
+
+        _prob[s]  = scaled[s];
+        _alias[s] = l;
+
+        // The large entry gives away what the small one lacks
+        scaled[l] = (scaled[l] + scaled[s]) - 1;
+        if (scaled[l] < 1) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+
+    // Left overs are only off by rounding errors
+    for (uint32 idx : large) {
+        _prob[idx]  = 1;
+        _alias[idx] = idx;
+    }
+
+    for (uint32 idx : small) {
+        _prob[idx]  = 1;
+        _alias[idx] = idx;
+    }
 }
 
 Float DiscretePdf1D::pdf(uint32 idx) const {
-    return _f[idx] / (_f.size() * _sum);
+    return _pdf[idx];
 }
 
-uint32 DiscretePdf1D::cdf(uint32 idx) const {
+Float DiscretePdf1D::cdf(uint32 idx) const {
     return _cdf[idx];
 }
 
@@ -35,7 +98,40 @@ Float DiscretePdf1D::operator()(uint32 idx) const {
     return _f[idx];
 }
 
+uint32 DiscretePdf1D::size() const {
+    return (uint32)_f.size();
+}
+
+Float DiscretePdf1D::sum() const {
+    return _sum;
+}
+
 uint32 DiscretePdf1D::sample(Float rand) const {
+    return sample(rand, nullptr);
+}
+
+uint32 DiscretePdf1D::sample(Float rand, Float* remapped) const {
+    const uint32 size = (uint32)_prob.size();
+
+    // Pick a bucket, the rest of the number chooses within it
+    const Float  u   = rand * size;
+    const uint32 idx = std::min((uint32)u, size - 1);
+    const Float  v   = std::min(u - idx, ONE_MINUS_EPSILON);
+
+    if (v < _prob[idx]) {
+        if (remapped)
+            *remapped = std::min(v / _prob[idx], ONE_MINUS_EPSILON);
+
+        return idx;
+    }
+
+    if (remapped)
+        *remapped = std::min((v - _prob[idx]) / (1 - _prob[idx]), ONE_MINUS_EPSILON);
+
+    return _alias[idx];
+}
+
+uint32 DiscretePdf1D::sampleCdf(Float rand) const {
     auto it = std::upper_bound(_cdf.begin(), _cdf.end(), rand);
-    return std::distance(_cdf.begin(), it) - 1;
+    return std::min((uint32)std::distance(_cdf.begin(), it), (uint32)_f.size()) - 1;
 }
\ No newline at end of file
@@ -6,19 +6,40 @@
 
 namespace Photon {
 
+    // Discrete distribution sampled with Walker's alias method, both
+    // sampling and the pdf take constant time whatever the number of
+    // entries. Each bucket holds one entry up to its probability and the
+    // alias of another past it. A distribution whose values are all zero
+    // is sampled uniformly.
     class DiscretePdf1D {
     public:
         DiscretePdf1D(const std::vector<Float>& vals);
 
         Float  pdf(uint32 idx) const;
-        uint32 cdf(uint32 idx) const;
+        Float  cdf(uint32 idx) const;
         uint32 sample(Float rand) const;
 
+        // Also returns the random number remapped to [0, 1) within the
+        // part of the bucket that was picked, so it can be reused
+        uint32 sample(Float rand, Float* remapped) const;
+
+        // Binary search of the cumulative distribution, as sampled before
+        // the alias table. Kept as a reference to compare against.
+        uint32 sampleCdf(Float rand) const;
+
         Float operator()(uint32 idx) const;
 
+        uint32 size() const;
+        Float  sum() const;
+
     private:
-        std::vector<Float> _f;
-        std::vector<Float> _cdf;
+        void buildAliasTable();
+
+        std::vector<Float>  _f;
+        std::vector<Float>  _pdf;
+        std::vector<Float>  _cdf;
+        std::vector<Float>  _prob;      // Probability of keeping the bucket entry
+        std::vector<uint32> _alias;
         Float _sum;
     };
 
@@ -2,16 +2,30 @@
 
 #include <Threading.h>
 #include <Image.h>
+#include <BoxFilter.h>
+#include <GaussianFilter.h>
 
 using namespace Photon;
 using namespace Photon::Threading;
 
+bool Photon::parseFilter(const std::string& name, std::shared_ptr<Filter>* filter) {
+    if (name.compare(0, 3, "box") == 0)
+        *filter = std::make_shared<BoxFilter>();
+    else if (name.compare(0, 8, "gaussian") == 0)
+        *filter = std::make_shared<GaussianFilter>();
+    else
+        return false;
+
+    return true;
+}
+
 Film::Film(const Vec2ui& res)
     : _res(res), _toneOp(FILMIC), _exposure(0.6), _bounds(0),
     _pixels(nullptr), _preview(nullptr), _feats(nullptr),
-    _splatScale(1) {
+    _splatScale(1), _filter(std::make_shared<BoxFilter>()), _tilesOverlap(false) {
 
     _bounds.expand(Point2(res.x, res.y));
+    _splatBuffers.resize(FILM_SPLAT_THREADS);
 
     uint32 nPixels = pixelArea();
     _pixels  = std::make_unique<Pixel[]>(nPixels);
@@ -20,6 +34,7 @@ Film::Film(const Vec2ui& res)
     memset(_preview.get(), 0, nPixels);
 
     _feats = std::make_unique<FeaturesRecord[]>(nPixels);
+    _stats = std::make_unique<PixelStats[]>(nPixels);
 }
 
 void Film::setToneOperator(ToneOperator op) {
@@ -30,6 +45,32 @@ void Film::setExposure(Float exp) {
     _exposure = exp;
 }
 
+void Film::setFilter(const std::shared_ptr<Filter>& filter) {
+    _filter = filter;
+
+    const Vec2& radius = filter->radius();
+    _tilesOverlap = radius.x > 0.5 || radius.y > 0.5;
+}
+
+void Film::clear() {
+    const uint32 nPixels = pixelArea();
+    for (uint32 p = 0; p < nPixels; ++p) {
+        _pixels[p]  = Pixel();
+        _preview[p] = Color::BLACK;
+        _feats[p]   = FeaturesRecord();
+        _stats[p]   = PixelStats();
+    }
+
+    std::lock_guard<std::mutex> lock(_splatMutex);
+    for (std::unique_ptr<SplatBuffer>& buffer : _splatBuffers)
+        if (buffer)
+            buffer->clear();
+}
+
+const Filter& Film::filter() const {
+    return *_filter;
+}
+
 const Bounds2& Film::bounds() const {
     return _bounds;
 }
@@ -66,18 +107,90 @@ void Film::addPreviewSample(uint32 x, uint32 y, const Color& color) {
 void Film::addColorSample(uint32 x, uint32 y, const Color& color) {
     Pixel& p  = pixel(Point2ui(x, y));
     p.color  += color;
+    p.weight += 1;
     p.nSamples++;
 }
 
 void Film::addColorSample(uint32 x, uint32 y, const Color& color, uint32 nSamples) {
     Pixel& p = pixel(Point2ui(x, y));
     p.color += color;
+    p.weight += nSamples;
     p.nSamples += nSamples;
 }
 
-void Film::addSplatSample(const Point2& pt, const Color& splat) {
-    Pixel& p  = pixel(pt);
-    p.splat.add(splat);
+void Film::addSplatSample(const Point2& pt, const Color& splat, uint32 threadId) {
+    const uint32 idx = (uint32)pt.x + _res.x * (uint32)pt.y;
+
+    // Threads past the buffered ones add their splats straight away
+    if (threadId >= FILM_SPLAT_THREADS) {
+        std::lock_guard<std::mutex> lock(_splatMutex);
+        _pixels[idx].splat += splat;
+        return;
+    }
+
+    std::unique_ptr<SplatBuffer>& buffer = _splatBuffers[threadId];
+    if (!buffer) {
+        buffer = std::make_unique<SplatBuffer>();
+        buffer->reserve(FILM_SPLAT_BUFFER_SIZE);
+    }
+
+    buffer->push_back({ idx, splat });
+    if (buffer->size() >= FILM_SPLAT_BUFFER_SIZE)
+        flushSplats(*buffer);
+}
+
+void Film::flushSplats(SplatBuffer& buffer) const {
+    std::lock_guard<std::mutex> lock(_splatMutex);
+    for (const SplatRecord& rec : buffer)
+        _pixels[rec.idx].splat += rec.splat;
+
+    buffer.clear();
+}
+
+// Must not run while threads are still splatting
+void Film::mergeSplats() const {
+    for (std::unique_ptr<SplatBuffer>& buffer : _splatBuffers)
+        if (buffer)
+            flushSplats(*buffer);
+}
+
+FilmTile Film::tile(const Point2ui& origin, const Vec2ui& size) const {
+    // Grow the tile by the pixels the filter reaches outside of it
+    const Vec2& radius = _filter->radius();
+    const uint32 borderX = (uint32)std::max((Float)0, std::ceil(radius.x - 0.5));
+    const uint32 borderY = (uint32)std::max((Float)0, std::ceil(radius.y - 0.5));
+
+    const Point2ui min(origin.x > borderX ? origin.x - borderX : 0,
+                       origin.y > borderY ? origin.y - borderY : 0);
+    const Point2ui max(std::min(origin.x + size.x + borderX, _res.x),
+                       std::min(origin.y + size.y + borderY, _res.y));
+
+    return FilmTile(min, max, *_filter);
+}
+
+void Film::mergeTile(const FilmTile& tile) {
+    // Tiles only share pixels when the filter spans several of them,
+    // otherwise each owns its pixels and is merged without locking
+    std::unique_lock<std::mutex> lock(_mergeMutex, std::defer_lock);
+    if (_tilesOverlap)
+        lock.lock();
+
+    const Point2ui& min = tile.min();
+    const Point2ui& max = tile.max();
+    for (uint32 y = min.y; y < max.y; ++y) {
+        for (uint32 x = min.x; x < max.x; ++x) {
+            const TilePixel& src = tile.pixel(x, y);
+
+            Pixel& dst = pixel(Point2ui(x, y));
+            dst.color    += src.color;
+            dst.weight   += src.weight;
+            dst.nSamples += src.nSamples;
+
+            PixelStats& stats = _stats[x + _res.x * y];
+            stats.lumSum   += src.lumSum;
+            stats.lumSqSum += src.lumSqSum;
+        }
+    }
 }
 
 void Film::addFeatureSample(const FeaturesRecord& record) {
@@ -102,24 +215,22 @@ std::unique_ptr<Float[]> Film::color() const {
     if (!_pixels)
         return nullptr;
 
+    mergeSplats();
+
     std::unique_ptr<Float[]> out = std::make_unique<Float[]>(nPixels * nChannels);
     parallelFor(0, _res.x, 32, [&](uint32 i) {
         for (uint32 y = 0; y < _res.y; ++y) {
             const Pixel& px = pixel(Point2ui(i, y));
-
-            // TODO: filters, for now apply box
             uint32 idx = i + _res.x * y;
 
-            Color tone = ToneMap(_toneOp, px.color / px.nSamples, _exposure);
+            const Color filtered = px.weight > 0 ? px.color / px.weight : Color::BLACK;
+
+            Color tone = ToneMap(_toneOp, filtered, _exposure);
             out[nChannels * idx]     = tone.r;
             out[nChannels * idx + 1] = tone.g;
             out[nChannels * idx + 2] = tone.b;
 
-            Color splat = Color(px.splat.r.val(),
-                                px.splat.g.val(),
-                                px.splat.b.val());
-
-            splat = ToneMap(_toneOp, splat / px.nSamples, _exposure);
+            const Color splat = ToneMap(_toneOp, px.splat / std::max(px.nSamples, 1u), _exposure);
             out[nChannels * idx]     += splat.r;
             out[nChannels * idx + 1] += splat.g;
             out[nChannels * idx + 2] += splat.b;
@@ -136,24 +247,21 @@ std::unique_ptr<Float[]> Film::colorHdr() const {
     if (!_pixels)
         return nullptr;
 
+    mergeSplats();
+
     std::unique_ptr<Float[]> out = std::make_unique<Float[]>(nPixels * nChannels);
     parallelFor(0, _res.x, 32, [&](uint32 i) {
         for (uint32 y = 0; y < _res.y; ++y) {
             const Pixel& px = pixel(Point2ui(i, y));
-
-            // TODO: filters, for now apply box
             uint32 idx = i + _res.x * y;
 
-            Color filtered = px.color / px.nSamples;
+            const Color filtered = px.weight > 0 ? px.color / px.weight : Color::BLACK;
+
             out[nChannels * idx]     = filtered.r;
             out[nChannels * idx + 1] = filtered.g;
             out[nChannels * idx + 2] = filtered.b;
 
-            Color splat = Color(px.splat.r.val(),
-                                px.splat.g.val(),
-                                px.splat.b.val());
-
-            splat /= px.nSamples;
+            const Color splat = px.splat / std::max(px.nSamples, 1u);
             out[nChannels * idx]     += splat.r;
             out[nChannels * idx + 1] += splat.g;
             out[nChannels * idx + 2] += splat.b;
@@ -306,6 +414,28 @@ Pixel& Film::pixel(const Point2& p) {
     return _pixels[idx];
 }
 
+Float Film::relativeError(const Point2ui& p) const {
+    const uint32 idx = p.x + _res.x * p.y;
+    return Photon::relativeError(_stats[idx].lumSum, _stats[idx].lumSqSum, _pixels[idx].nSamples);
+}
+
+Float Film::noiseEstimate() const {
+    Float sum = 0;
+    uint32 num = 0;
+
+    // Pixels with a single sample have no estimate yet
+    const uint32 nPixels = pixelArea();
+    for (uint32 p = 0; p < nPixels; ++p) {
+        if (_pixels[p].nSamples < 2)
+            continue;
+
+        sum += Photon::relativeError(_stats[p].lumSum, _stats[p].lumSqSum, _pixels[p].nSamples);
+        num++;
+    }
+
+    return num > 0 ? sum / num : std::numeric_limits<Float>::infinity();
+}
+
 Pixel& Film::operator()(const Point2& p) {
     uint32 x = (uint32)p.x;
     uint32 y = (uint32)p.y;
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+
 #include <PhotonMath.h>
 #include <Spectral.h>
 #include <Tonemap.h>
 #include <Filter.h>
+#include <FilmTile.h>
 #include <Bounds.h>
-#include <Atomic.h>
 
 namespace Photon {
 
@@ -13,6 +18,9 @@ namespace Photon {
         COLOR, DEPTH, NORMAL, VISIBILITY, SAMPLES
     };
 
+    static const uint32 FILM_SPLAT_THREADS     = 256;    // Threads with a private splat buffer
+    static const uint32 FILM_SPLAT_BUFFER_SIZE = 4096;   // Splats held before a flush
+
     struct FeaturesRecord {
     public:
         Normal normal;   // Shading normal at intersection
@@ -25,25 +33,42 @@ namespace Photon {
     };
 
     struct Pixel {
-        Color       color;
-        Float       weight;
-        AtomicColor splat;
-        uint32      nSamples;
+        Color  color;
+        Float  weight;
+        Color  splat;
+        uint32 nSamples;
 
 #ifdef PHOTON_DOUBLE
         uint8 pad[4]; // Make pixel 64 bytes
 #endif
 
-        Pixel() : nSamples(0), weight(0) { }
+        Pixel() : color(Color::BLACK), weight(0), splat(Color::BLACK), nSamples(0) { }
 
     }; // 32 Bytes (4 byte FP)
 
+    // Luminance moments of the samples of a pixel, to estimate its error
+    struct PixelStats {
+        Float lumSum;
+        Float lumSqSum;
+
+        PixelStats() : lumSum(0), lumSqSum(0) { }
+    };
+
+    // Reconstruction filter of the given name, "box" or "gaussian"
+    bool parseFilter(const std::string& name, std::shared_ptr<Filter>* filter);
+
     class Film {
     public:
         Film(const Vec2ui& res);
 
         void setToneOperator(ToneOperator op);
         void setExposure(Float exp);
+        void setFilter(const std::shared_ptr<Filter>& filter);
+
+        // Discards every sample, frames of a sequence reuse the film
+        void clear();
+
+        const Filter& filter() const;
 
         const Bounds2& bounds() const;
 
@@ -57,9 +82,13 @@ namespace Photon {
         void addPreviewSample(uint32 x, uint32 y, const Color& color);
         void addColorSample(uint32 x, uint32 y, const Color& color);
         void addColorSample(uint32 x, uint32 y, const Color& color, uint32 nSamples);
-        void addSplatSample(const Point2& pt, const Color& splat);
+        void addSplatSample(const Point2& pt, const Color& splat, uint32 threadId);
         void addFeatureSample(const FeaturesRecord& record);
 
+        // Tiles are rendered privately and added to the film when done
+        FilmTile tile(const Point2ui& origin, const Vec2ui& size) const;
+        void mergeTile(const FilmTile& tile);
+
         const Float* preview() const;
 
         std::unique_ptr<Float[]> color() const;
@@ -81,9 +110,25 @@ namespace Photon {
 
         Pixel& operator()(const Point2& p);
 
+        // Relative standard error of the mean luminance of a pixel
+        Float relativeError(const Point2ui& p) const;
+
+        // Mean relative error over the sampled pixels
+        Float noiseEstimate() const;
+
         void exportImage(BufferType type, const std::string& filename, const std::string& ext) const;
 
     private:
+        struct SplatRecord {
+            uint32 idx;
+            Color  splat;
+        };
+
+        typedef std::vector<SplatRecord> SplatBuffer;
+
+        void flushSplats(SplatBuffer& buffer) const;
+        void mergeSplats() const;
+
         Vec2ui  _res;
         Bounds2 _bounds;
 
@@ -95,6 +140,16 @@ namespace Photon {
         std::unique_ptr<Color[]> _preview;
         std::unique_ptr<Pixel[]> _pixels;
         std::unique_ptr<FeaturesRecord[]> _feats;
+        std::unique_ptr<PixelStats[]> _stats;
+
+        std::shared_ptr<Filter> _filter;
+        bool _tilesOverlap;         // Filter reaches past the pixels of a tile
+        std::mutex _mergeMutex;
+
+        // Splats land anywhere on the film, each thread queues its own
+        // and adds them to the pixels in bulk
+        mutable std::vector<std::unique_ptr<SplatBuffer>> _splatBuffers;
+        mutable std::mutex _splatMutex;
     };
 
 
@@ -0,0 +1,68 @@
+#include <FilmTile.h>
+
+#include <cmath>
+
+using namespace Photon;
+
+FilmTile::FilmTile(const Point2ui& min, const Point2ui& max, const Filter& filter)
+    : _min(min), _max(max), _width(max.x - min.x), _filter(filter) {
+
+    _pixels.resize(_width * (max.y - min.y));
+}
+
+void FilmTile::addSample(const Point2& pFilm, const Color& L) {
+    // Discrete pixel centers lie at half integer coordinates. The
+    // filter covers offsets in (-radius, radius], so a box filter adds
+    // every sample to exactly the pixel it was taken in.
+    const Vec2& radius = _filter.radius();
+    const Float dx = pFilm.x - 0.5;
+    const Float dy = pFilm.y - 0.5;
+
+    const int64 x0 = std::max((int64)_min.x, (int64)std::floor(dx - radius.x) + 1);
+    const int64 y0 = std::max((int64)_min.y, (int64)std::floor(dy - radius.y) + 1);
+    const int64 x1 = std::min((int64)_max.x, (int64)std::floor(dx + radius.x) + 1);
+    const int64 y1 = std::min((int64)_max.y, (int64)std::floor(dy + radius.y) + 1);
+
+    for (int64 y = y0; y < y1; ++y) {
+        for (int64 x = x0; x < x1; ++x) {
+            const Float w = _filter.evaluate(Point2(x - dx, y - dy));
+
+            TilePixel& px = pixelAt((uint32)x, (uint32)y);
+            px.color  += L * w;
+            px.weight += w;
+        }
+    }
+
+    // Samples are counted on the pixel they were taken in
+    const uint32 x = (uint32)pFilm.x;
+    const uint32 y = (uint32)pFilm.y;
+    if (x >= _min.x && x < _max.x && y >= _min.y && y < _max.y) {
+        TilePixel& px = pixelAt(x, y);
+        const Float lum = L.lum();
+
+        px.nSamples++;
+        px.lumSum   += lum;
+        px.lumSqSum += lum * lum;
+    }
+}
+
+const Point2ui& FilmTile::min() const {
+    return _min;
+}
+
+const Point2ui& FilmTile::max() const {
+    return _max;
+}
+
+const TilePixel& FilmTile::pixel(uint32 x, uint32 y) const {
+    return _pixels[(x - _min.x) + _width * (y - _min.y)];
+}
+
+Float FilmTile::relativeError(uint32 x, uint32 y) const {
+    const TilePixel& px = pixel(x, y);
+    return Photon::relativeError(px.lumSum, px.lumSqSum, px.nSamples);
+}
+
+TilePixel& FilmTile::pixelAt(uint32 x, uint32 y) {
+    return _pixels[(x - _min.x) + _width * (y - _min.y)];
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+
+#include <PhotonMath.h>
+#include <Spectral.h>
+#include <Filter.h>
+#include <Memory.h>
+
+namespace Photon {
+
+    struct TilePixel {
+        Color  color;
+        Float  weight;
+        uint32 nSamples;
+        Float  lumSum;      // Luminance of the samples taken in the pixel
+        Float  lumSqSum;
+
+        TilePixel() : color(Color::BLACK), weight(0), nSamples(0), lumSum(0), lumSqSum(0) { }
+    };
+
+    // Darker means are clamped so black pixels do not need endless samples
+    static const Float MIN_ERROR_MEAN = 1e-3;
+
+    // Standard error of the mean luminance of n samples, relative to it
+    inline Float relativeError(Float lumSum, Float lumSqSum, uint32 n) {
+        if (n < 2)
+            return std::numeric_limits<Float>::infinity();
+
+        const Float mean = lumSum / n;
+        const Float variance = std::max((lumSqSum - lumSum * mean) / (n - 1), (Float)0);
+
+        return std::sqrt(variance / n) / std::max(mean, MIN_ERROR_MEAN);
+    }
+
+    // Private accumulation buffer of a single render tile, merged into the
+    // film once the tile is done so threads never write shared pixels.
+    // Bounds are in film pixels, the maximum is exclusive and includes the
+    // border covered by the filter.
+    class FilmTile {
+    public:
+        FilmTile(const Point2ui& min, const Point2ui& max, const Filter& filter);
+
+        // Filtered sample at a continuous film position
+        void addSample(const Point2& pFilm, const Color& L);
+
+        const Point2ui& min() const;
+        const Point2ui& max() const;
+
+        const TilePixel& pixel(uint32 x, uint32 y) const;
+
+        // Of the samples added to the pixel on this tile
+        Float relativeError(uint32 x, uint32 y) const;
+
+    private:
+        TilePixel& pixelAt(uint32 x, uint32 y);
+
+        Point2ui _min;
+        Point2ui _max;
+        uint32   _width;
+
+        const Filter& _filter;
+
+        std::vector<TilePixel, Utils::AlignedAllocator<TilePixel>> _pixels;
+    };
+
+}
\ No newline at end of file
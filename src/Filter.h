@@ -1,13 +1,23 @@
 #pragma once
 
+#include <PhotonMath.h>
+
 namespace Photon {
 
+    // Pixel reconstruction filter, evaluated at offsets from the pixel center
     class Filter {
     public:
+        Filter(const Vec2& radius) : _radius(radius) { }
+        virtual ~Filter() { }
 
+        virtual Float evaluate(const Point2& p) const = 0;
 
-    private:
+        const Vec2& radius() const {
+            return _radius;
+        }
 
+    protected:
+        Vec2 _radius;
     };
 
 }
\ No newline at end of file
@@ -1,14 +1,32 @@
 #pragma once
 
+#include <cmath>
+
 #include <Filter.h>
 
 namespace Photon {
 
     class GaussianFilter : public Filter {
     public:
+        GaussianFilter(const Vec2& radius = Vec2(1.5), Float alpha = 2)
+            : Filter(radius), _alpha(alpha) {
+            
+            // Shift the curve so that it reaches zero at the radius
+            _expX = std::exp(-alpha * radius.x * radius.x);
+            _expY = std::exp(-alpha * radius.y * radius.y);
+        }
+
+        Float evaluate(const Point2& p) const {
+            return gaussian(p.x, _expX) * gaussian(p.y, _expY);
+        }
 
     private:
+        Float gaussian(Float d, Float expR) const {
+            return std::max((Float)0, Float(std::exp(-_alpha * d * d) - expR));
+        }
 
+        Float _alpha;
+        Float _expX, _expY;
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include <Instance.h>
+
+using namespace Photon;
+
+Instance::Instance(const std::shared_ptr<TriMesh>& mesh, const std::shared_ptr<BVH>& bvh,
+                   const AnimatedTransform& objToWorld)
+    : Shape(objToWorld.start()), _mesh(mesh), _bvh(bvh), _animation(objToWorld), _motion(objToWorld) { }
+
+void Instance::setTransform(const AnimatedTransform& objToWorld) {
+    _animation = objToWorld;
+    _motion    = objToWorld;
+
+    Shape::setTransform(objToWorld.start());
+}
+
+void Instance::setFrame(Float start, Float end) {
+    if (!_animation.isAnimated())
+        return;
+
+    _motion = AnimatedTransform(_animation.interpolate(start), _animation.interpolate(end));
+    Shape::setTransform(_motion.start());
+}
+
+Transform Instance::objToWorld(Float time) const {
+    return _motion.isAnimated() ? _motion.interpolate(time) : _objToWorld;
+}
+
+bool Instance::intersectRay(const Ray& ray, SurfaceEvent* evt) const {
+    // Directions are not normalized, so distances match in both spaces
+    const Ray objRay = _motion.isAnimated() ? inverse(objToWorld(ray.time()))(ray) : _worldToObj(ray);
+    if (!_bvh->intersectRay(objRay, evt))
+        return false;
+
+    ray.setMaxT(objRay.maxT());
+
+    // Point and normal stay in object space until the event is computed
+    evt->obj = this;
+
+    return true;
+}
+
+bool Instance::isOccluded(const Ray& ray) const {
+    if (_motion.isAnimated())
+        return _bvh->isOccluded(inverse(objToWorld(ray.time()))(ray));
+
+    return _bvh->isOccluded(_worldToObj(ray));
+}
+
+void Instance::computeSurfaceEvent(const Ray& ray, SurfaceEvent& evt) const {
+    // Static instances already hold both directions of their transform,
+    // moving ones interpolate it at the time of the ray
+    const bool animated = _motion.isAnimated();
+    const Transform motion = animated ? _motion.interpolate(ray.time()) : Transform();
+    const Transform& toWorld = animated ? motion : _objToWorld;
+
+    _mesh->computeSurfaceEvent(animated ? inverse(toWorld)(ray) : _worldToObj(ray), evt);
+
+    evt.obj    = this;
+    evt.point  = toWorld(evt.point);
+    evt.normal = normalize(toWorld(evt.normal));
+
+    // Bring the shading frame along, keeping it orthonormal under scaling
+    const Vec3 n = Vec3(normalize(toWorld(evt.sFrame.normal())));
+    Vec3 bitan = cross(toWorld(evt.sFrame.x()), n);
+    if (bitan.lengthSqr() > 0) {
+        bitan.normalize();
+        evt.sFrame = Frame(cross(bitan, n), bitan, n);
+    } else {
+        evt.sFrame = Frame(Normal(n));
+    }
+
+    evt.gFrame = Frame(evt.normal);
+    evt.wo = evt.sFrame.toLocal(-ray.dir());
+}
+
+Bounds3 Instance::bbox() const {
+    return _motion.motionBounds(_bvh->bounds());
+}
+
+bool Instance::isAnimated() const {
+    return _motion.isAnimated();
+}
+
+void Instance::motionBounds(Bounds3* start, Bounds3* end) const {
+    _motion.linearBounds(_bvh->bounds(), start, end);
+}
+
+Float Instance::area() const {
+    Float area = 0;
+    for (uint32 f = 0; f < _mesh->numFaces(); ++f) {
+        const MeshFace idx = _mesh->face(f);
+
+        const Point3 V0 = _objToWorld(_mesh->vertex(idx[0]));
+        const Vec3 E1 = _objToWorld(_mesh->vertex(idx[1])) - V0;
+        const Vec3 E2 = _objToWorld(_mesh->vertex(idx[2])) - V0;
+
+        area += 0.5 * cross(E1, E2).length();
+    }
+
+    return area;
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+
+#include <Shape.h>
+#include <TriMesh.h>
+#include <BVH.h>
+#include <Animation.h>
+
+namespace Photon {
+
+    // Placement of a shared mesh. Rays are moved into object space at the
+    // instance boundary and traverse a bottom level BVH built once for
+    // every copy, so only the transform is stored per instance. Animated
+    // transforms move the instance over the shutter.
+    class Instance : public Shape {
+    public:
+        Instance(const std::shared_ptr<TriMesh>& mesh, const std::shared_ptr<BVH>& bvh,
+                 const AnimatedTransform& objToWorld);
+
+        bool intersectRay(const Ray& ray, SurfaceEvent* evt) const;
+        bool isOccluded(const Ray& ray) const;
+
+        void computeSurfaceEvent(const Ray& ray, SurfaceEvent& evt) const;
+
+        Bounds3 bbox() const;
+        Float area() const;
+
+        bool isAnimated() const;
+        void motionBounds(Bounds3* start, Bounds3* end) const;
+        void setFrame(Float start, Float end);
+
+        // Places the instance elsewhere, scenes follow on their next update
+        void setTransform(const AnimatedTransform& objToWorld);
+
+        const TriMesh& mesh() const {
+            return *_mesh;
+        }
+
+    private:
+        Transform objToWorld(Float time) const;
+
+        std::shared_ptr<TriMesh> _mesh;
+        std::shared_ptr<BVH>     _bvh;
+        AnimatedTransform        _animation;    // Whole motion of the instance
+        AnimatedTransform        _motion;       // Motion during the current frame
+    };
+
+}
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <Ray.h>
 #include <Light.h>
 #include <AreaLight.h>
+#include <RayBatch.h>
 
 using namespace Photon;
 
@@ -51,7 +52,7 @@ Color Integrator::estimateDirect(const SurfaceEvent& evt, Sampler& sampler, Dire
         return estimateDirectAll(evt, sampler);
 
     Float lightPdf = 1;
-    const Light* light = _scene->sampleLightPdf(sampler.next1D(), &lightPdf);
+    const Light* light = _scene->sampleLight(evt, sampler.next1D(), &lightPdf);
 
     if (!light || lightPdf == 0)
         return Color::BLACK;
@@ -59,7 +60,16 @@ Color Integrator::estimateDirect(const SurfaceEvent& evt, Sampler& sampler, Dire
     const Point2 ls = sampler.next2D();
     const Point2 bs = sampler.next2D();
 
-    Color Li = sampleLight(*light, evt, ls, bs);
+    Ray shadowRay;
+    Color Li = sampleLightSource(*light, evt, ls, &shadowRay, lightPdf);
+
+    // Trace shadow ray from point in direction wi
+    if (!Li.isBlack() && _scene->isOccluded(shadowRay))
+        Li = Color::BLACK;
+
+    // Only surfaces can be found by sampling the BSDF
+    if (_scene->hasAreaLights())
+        Li += sampleEmitterBsdf(evt, bs);
 
     // Record direct lighting stats
     if (stats) {
@@ -70,7 +80,7 @@ Color Integrator::estimateDirect(const SurfaceEvent& evt, Sampler& sampler, Dire
             stats->numUnoccluded++;
     }
 
-    return Li / lightPdf;
+    return Li;
 }
 
 Color Integrator::estimateDirectAll(const SurfaceEvent& evt, Sampler& sampler, DirectIllumStats* stats) const {
@@ -115,13 +125,38 @@ Color Integrator::estimateDirectAll(const SurfaceEvent& evt, Sampler& sampler, D
                     stats->numUnoccluded++;
 
             } else {
-                for (uint32 i = 0; i < nSamples; ++i) {
-                    Color Li = sampleLight(*light, evt, lightVec[i], bsdfVec[i]);
-                    contrib += Li;
-
-                    // Record unoccluded shadow ray
-                    if (stats && !Li.isBlack())
-                        stats->numUnoccluded++;
+                // Shadow rays leave the same point, trace them in batches
+                RayBatch shadowRays;
+                for (uint32 first = 0; first < nSamples; first += RAY_BATCH_SIZE) {
+                    const uint32 count = std::min(RAY_BATCH_SIZE, nSamples - first);
+
+                    Color  Ld[RAY_BATCH_SIZE];
+                    uint32 rayIdx[RAY_BATCH_SIZE];
+
+                    shadowRays.clear();
+                    for (uint32 i = 0; i < count; ++i) {
+                        Ray shadowRay;
+                        Ld[i] = sampleLightSource(*light, evt, lightVec[first + i], &shadowRay);
+
+                        rayIdx[i] = shadowRays.size;
+                        if (!Ld[i].isBlack())
+                            shadowRays.add(shadowRay);
+                    }
+
+                    const uint32 occluded = _scene->occludedRays(shadowRays);
+
+                    for (uint32 i = 0; i < count; ++i) {
+                        Color Li = Color::BLACK;
+                        if (!Ld[i].isBlack() && !(occluded & (1u << rayIdx[i])))
+                            Li = Ld[i];
+
+                        Li += sampleLightBsdf(*light, evt, bsdfVec[first + i]);
+                        contrib += Li;
+
+                        // Record unoccluded shadow ray
+                        if (stats && !Li.isBlack())
+                            stats->numUnoccluded++;
+                    }
                 }
             }
 
@@ -139,6 +174,17 @@ Color Integrator::estimateDirectAll(const SurfaceEvent& evt, Sampler& sampler, D
 }
 
 Color Integrator::sampleLight(const Light& light, const SurfaceEvent& evt, const Point2& randLight, const Point2& randBsdf) const {
+    Ray shadowRay;
+    Color Ldir = sampleLightSource(light, evt, randLight, &shadowRay);
+
+    // Trace shadow ray from point in direction wi
+    if (!Ldir.isBlack() && _scene->isOccluded(shadowRay))
+        Ldir = Color::BLACK;
+
+    return Ldir + sampleLightBsdf(light, evt, randBsdf);
+}
+
+Color Integrator::sampleLightSource(const Light& light, const SurfaceEvent& evt, const Point2& randLight, Ray* shadowRay, Float lightPdf) const {
     const BSDF* bsdf = evt.obj->bsdf();
     Color Ldir = Color::BLACK;
 
@@ -152,27 +198,30 @@ Color Integrator::sampleLight(const Light& light, const SurfaceEvent& evt, const
         Color bsdfF   = Color::BLACK;
         Float bsdfPdf = 0;
 
-        // Trace shadow ray from point in direction wi
-        Ray shadowRay = evt.spawnRay(dirSample.wi, dirSample.dist);
-        if (!_scene->isOccluded(shadowRay)) {
-
-            // Evaluate BSDF for direct sample
-            BSDFSample bsdfSample(dirSample);
-            bsdfF   = bsdf->eval(bsdfSample);
-            bsdfPdf = bsdf->evalPdf(bsdfSample);
+        // Evaluate BSDF for direct sample
+        BSDFSample bsdfSample(dirSample);
+        bsdfF   = bsdf->eval(bsdfSample);
+        bsdfPdf = bsdf->evalPdf(bsdfSample);
 
-            // If it has contribution, use MIS to combine sample strategies
-            // Also check geometry normal orientation to avoid light leaks
-            if (!bsdfF.isBlack() && dot(evt.normal, dirSample.wi) * Frame::cosTheta(bsdfSample.wi) > 0) {
-                Color contrib = bsdfF * Li * Frame::absCosTheta(bsdfSample.wi); // / dirSample.pdf;
-                if (!light.isDelta())
-                    contrib *= powerHeuristicBetaTwo(dirSample.pdf, bsdfPdf, 1, 1);
+        // If it has contribution, use MIS to combine sample strategies
+        // Also check geometry normal orientation to avoid light leaks
+        if (!bsdfF.isBlack() && dot(evt.normal, dirSample.wi) * Frame::cosTheta(bsdfSample.wi) > 0) {
+            Color contrib = bsdfF * Li * Frame::absCosTheta(bsdfSample.wi) / lightPdf; // / dirSample.pdf;
+            if (!light.isDelta())
+                contrib *= powerHeuristicBetaTwo(lightPdf * dirSample.pdf, bsdfPdf, 1, 1);
 
-                Ldir += contrib;
-            }
+            *shadowRay = evt.spawnRay(dirSample.wi, dirSample.dist);
+            Ldir += contrib;
         }
     }
 
+    return Ldir;
+}
+
+Color Integrator::sampleLightBsdf(const Light& light, const SurfaceEvent& evt, const Point2& randBsdf) const {
+    const BSDF* bsdf = evt.obj->bsdf();
+    Color Ldir = Color::BLACK;
+
     /* -----------------------------------------------------------------------------------
             Sample BSDF with MIS
     --------------------------------------------------------------------------------------*/
@@ -228,3 +277,46 @@ Color Integrator::sampleLight(const Light& light, const SurfaceEvent& evt, const
 
     return Ldir;
 }
+
+Color Integrator::sampleEmitterBsdf(const SurfaceEvent& evt, const Point2& randBsdf) const {
+    const BSDF* bsdf = evt.obj->bsdf();
+
+    // Sample and eval BSDF
+    BSDFSample bsdfSample(evt);
+    Color bsdfF = bsdf->sample(randBsdf, &bsdfSample);
+    bsdfF *= Frame::absCosTheta(bsdfSample.wi);
+
+    if (bsdfSample.pdf == 0 || bsdfF.isBlack() ||
+        dot(evt.normal, evt.toWorld(bsdfSample.wi)) * Frame::cosTheta(bsdfSample.wi) <= 0)
+        return Color::BLACK;
+
+    // World space bsdf sampled direction
+    Vec3 bsdfWi = evt.toWorld(bsdfSample.wi);
+    Ray ray = evt.spawnRay(bsdfWi);
+
+    // Only emitting surfaces contribute
+    SurfaceEvent lightIt;
+    if (!_scene->intersectRay(ray, &lightIt) || !lightIt.obj->isLight())
+        return Color::BLACK;
+
+    const Light* light = lightIt.obj->areaLight();
+
+    Color Li = lightIt.emission(-bsdfWi);
+    if (Li.isBlack())
+        return Color::BLACK;
+
+    // If BSDF is specular, it has a delta distribution, so avoid using MIS
+    Float misWeight = 1.0;
+    if (!hasType(bsdfSample.type, BSDFType::SPECULAR)) {
+        DirectSample sample(evt, lightIt);
+        sample.wi = bsdfWi;
+
+        const Float pdfLight = _scene->lightPdf(evt, light) * light->pdfDirect(sample);
+        if (pdfLight == 0)
+            return Color::BLACK;
+
+        misWeight = powerHeuristicBetaTwo(bsdfSample.pdf, pdfLight, 1, 1);
+    }
+
+    return bsdfF * Li * misWeight / bsdfSample.pdf;
+}
\ No newline at end of file
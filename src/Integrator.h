@@ -9,6 +9,7 @@
 #include <Sampler.h>
 #include <StratifiedSampler.h>
 #include <RandomSampler.h>
+#include <SobolSampler.h>
 
 using namespace Photon::Threading;
 
@@ -18,6 +19,7 @@ namespace Photon {
     class Scene;
     class Light;
     class SurfaceEvent;
+    class Ray;
 
     typedef std::function<void()> EndCallback;
 
@@ -58,6 +60,11 @@ namespace Photon {
             _sampler = std::make_unique<StratifiedSampler>(8, 8, 8);
         }
 
+        // Replaces the default sampler, must be called before initialize
+        void setSampler(std::unique_ptr<Sampler> sampler) {
+            _sampler = std::move(sampler);
+        }
+
         virtual void initialize();
 
         virtual void startRender(EndCallback endCallback = EndCallback()) = 0;
@@ -69,6 +76,16 @@ namespace Photon {
     protected:
         Color sampleLight(const Light& light, const SurfaceEvent& evt, const Point2& randLight, const Point2& randBsdf) const;
 
+        // The two MIS strategies of sampleLight, the light strategy returns its
+        // contribution assuming the shadow ray it leaves in shadowRay is unoccluded.
+        // Lights picked with lightPdf weigh it against BSDF samples of sampleEmitterBsdf.
+        Color sampleLightSource(const Light& light, const SurfaceEvent& evt, const Point2& randLight, Ray* shadowRay, Float lightPdf = 1) const;
+        Color sampleLightBsdf(const Light& light, const SurfaceEvent& evt, const Point2& randBsdf) const;
+
+        // BSDF strategy when a single light is picked for the point, whichever
+        // light it hits is weighted by the chance of picking and sampling it
+        Color sampleEmitterBsdf(const SurfaceEvent& evt, const Point2& randBsdf) const;
+
         Color estimateDirect(const SurfaceEvent& evt, Sampler& sampler, DirectIllumStats* stats = nullptr) const;
         Color estimateDirectAll(const SurfaceEvent& evt, Sampler& sampler, DirectIllumStats* stats = nullptr) const;
 
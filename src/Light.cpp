@@ -9,6 +9,10 @@ void Light::initialize(const Scene& scene) {
 
 }
 
+bool Light::lightBounds(LightBounds* bounds) const {
+    return false;
+}
+
 void Light::setIntensity(const Color& Le) {
     _Le = Le;
 }
@@ -9,6 +9,7 @@ namespace Photon {
 
     class RayEvent;
     class Scene;
+    struct LightBounds;
 
     class Light {
     public:
@@ -29,6 +30,10 @@ namespace Photon {
 
         virtual Color power() const = 0;
 
+        // Spatial and directional extent of the emission, used by the light
+        // tree. Lights without a position return false.
+        virtual bool lightBounds(LightBounds* bounds) const;
+
         // Evaluate L for outgoing wo at intersection
         virtual Color evalL(const SurfaceEvent& it, const Vec3& wo) const = 0;
         virtual Color evalL(const PositionSample& sample, const Vec3& wo) const = 0;
@@ -0,0 +1,351 @@
+#include <LightTree.h>
+
+#include <algorithm>
+
+#include <Light.h>
+#include <Ray.h>
+#include <Random.h>
+
+using namespace Photon;
+
+static const uint32 LIGHT_TREE_NUM_BINS = 12;
+
+// cos(max(0, a - b)) and sin(max(0, a - b)) from the sines and cosines of a and b
+static Float cosSubClamped(Float sinA, Float cosA, Float sinB, Float cosB) {
+    if (cosA > cosB)
+        return 1;
+
+    return cosA * cosB + sinA * sinB;
+}
+
+static Float sinSubClamped(Float sinA, Float cosA, Float sinB, Float cosB) {
+    if (cosA > cosB)
+        return 0;
+
+    return sinA * cosB - cosA * sinB;
+}
+
+// Rotation of v by theta around the unit axis k (Rodrigues' formula)
+static Vec3 rotateAround(const Vec3& v, const Vec3& k, Float theta) {
+    const Float cos = std::cos(theta);
+    const Float sin = std::sin(theta);
+
+    return v * cos + cross(k, v) * sin + k * (dot(k, v) * (1 - cos));
+}
+
+Float LightBounds::importance(const Point3& p, const Normal& n) const {
+    if (phi == 0)
+        return 0;
+
+    // Distance to the center, clamped for points within the bounds
+    const Point3 center = bounds.center();
+    Float d2 = distSqr(p, center);
+    d2 = std::max(d2, bounds.sizes().length() / 2);
+
+    const Vec3 wi = (d2 > 0) ? normalize(p - center) : Vec3(0, 0, 1);
+
+    // Angle from the axis to the point, less the spread of the normals
+    const Float cosTheta_w = Math::clamp(dot(axis, wi), (Float)-1, (Float)1);
+    const Float sinTheta_w = Math::sqrtSafe(1 - cosTheta_w * cosTheta_w);
+    const Float sinTheta_o = Math::sqrtSafe(1 - cosTheta_o * cosTheta_o);
+
+    const Float cosTheta_x = cosSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, cosTheta_o);
+    const Float sinTheta_x = sinSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, cosTheta_o);
+
+    // Less the angle the bounds subtend from the point
+    Float cosTheta_b = -1;
+    if (!bounds.contains(p)) {
+        const Float radius2 = distSqr(bounds.max(), center);
+        const Float dist2   = distSqr(p, center);
+
+        if (dist2 > radius2)
+            cosTheta_b = Math::sqrtSafe(1 - radius2 / dist2);
+    }
+
+    const Float sinTheta_b = Math::sqrtSafe(1 - cosTheta_b * cosTheta_b);
+
+    const Float cosThetap = cosSubClamped(sinTheta_x, cosTheta_x, sinTheta_b, cosTheta_b);
+    if (cosThetap <= cosTheta_e)
+        return 0;
+
+    Float importance = phi * cosThetap / d2;
+
+    // Cosine at the receiving point, its hemisphere is not known
+    if (n.lengthSqr() > 0) {
+        const Float cosTheta_i = absDot(n, wi);
+        const Float sinTheta_i = Math::sqrtSafe(1 - cosTheta_i * cosTheta_i);
+
+        importance *= cosSubClamped(sinTheta_i, cosTheta_i, sinTheta_b, cosTheta_b);
+    }
+
+    return std::max(importance, (Float)0);
+}
+
+LightBounds Photon::unionBounds(const LightBounds& lb1, const LightBounds& lb2) {
+    if (lb1.phi == 0)
+        return lb2;
+    if (lb2.phi == 0)
+        return lb1;
+
+    LightBounds result;
+    result.bounds = expand(lb1.bounds, lb2.bounds);
+    result.phi    = lb1.phi + lb2.phi;
+    result.cosTheta_e = std::min(lb1.cosTheta_e, lb2.cosTheta_e);
+
+    // Smallest cone around both cones of normals
+    const Float theta_1 = Math::acosSafe(lb1.cosTheta_o);
+    const Float theta_2 = Math::acosSafe(lb2.cosTheta_o);
+    const Float theta_d = Math::acosSafe(dot(lb1.axis, lb2.axis));
+
+    if (std::min(theta_d + theta_2, PI) <= theta_1) {
+        result.axis       = lb1.axis;
+        result.cosTheta_o = lb1.cosTheta_o;
+        return result;
+    }
+
+    if (std::min(theta_d + theta_1, PI) <= theta_2) {
+        result.axis       = lb2.axis;
+        result.cosTheta_o = lb2.cosTheta_o;
+        return result;
+    }
+
+    const Float theta_o = (theta_1 + theta_d + theta_2) / 2;
+    const Vec3  wr = cross(lb1.axis, lb2.axis);
+
+    if (theta_o >= PI || wr.lengthSqr() == 0) {
+        result.axis       = lb1.axis;
+        result.cosTheta_o = -1;
+        return result;
+    }
+
+    result.axis       = normalize(rotateAround(lb1.axis, normalize(wr), theta_o - theta_1));
+    result.cosTheta_o = std::cos(theta_o);
+
+    return result;
+}
+
+// Surface area orientation heuristic, the solid angle term measures the
+// directions the cone of emission reaches and the box is kept from
+// getting thin along the split axis
+static Float splitCost(const LightBounds& lb, const Bounds3& bbox, uint32 dim) {
+    if (lb.phi == 0)
+        return 0;
+
+    const Float theta_o = Math::acosSafe(lb.cosTheta_o);
+    const Float theta_e = Math::acosSafe(lb.cosTheta_e);
+    const Float theta_w = std::min(theta_o + theta_e, PI);
+    const Float sinTheta_o = Math::sqrtSafe(1 - lb.cosTheta_o * lb.cosTheta_o);
+
+    const Float M_omega = 2 * PI * (1 - lb.cosTheta_o) +
+        PI / 2 * (2 * theta_w * sinTheta_o - std::cos(theta_o - 2 * theta_w) -
+                  2 * theta_o * sinTheta_o + lb.cosTheta_o);
+
+    const Vec3 sizes = bbox.sizes();
+    const Float Kr = sizes[sizes.maxDim()] / sizes[dim];
+
+    return lb.phi * M_omega * Kr * lb.bounds.surfaceArea();
+}
+
+LightTree::LightTree(const std::vector<Light*>& lights) {
+    std::vector<BuildLight> buildLights;
+    buildLights.reserve(lights.size());
+
+    for (const Light* light : lights) {
+        LightBounds lb;
+        if (!light->lightBounds(&lb)) {
+            _infinite.push_back(light);
+            continue;
+        }
+
+        // Lights that can't contribute are never picked
+        if (lb.phi <= 0)
+            continue;
+
+        buildLights.push_back({ lb, lb.bounds.center(), (uint32)_lights.size() });
+        _lights.push_back(light);
+    }
+
+    _nodes.reserve(2 * buildLights.size());
+    if (!buildLights.empty())
+        buildNode(buildLights, 0, (uint32)buildLights.size(), 0);
+}
+
+uint32 LightTree::buildNode(std::vector<BuildLight>& lights, uint32 start, uint32 end, uint32 parent) {
+    const uint32 nodeIdx = (uint32)_nodes.size();
+    _nodes.emplace_back();
+    _nodes[nodeIdx].parent = parent;
+
+    if (end - start == 1) {
+        _nodes[nodeIdx].bounds = lights[start].bounds;
+        _nodes[nodeIdx].index  = lights[start].light;
+        _nodes[nodeIdx].leaf   = true;
+
+        _leaves[_lights[lights[start].light]] = nodeIdx;
+        return nodeIdx;
+    }
+
+    Bounds3 bbox = Bounds3::EMPTY;
+    Bounds3 centroidBounds = Bounds3::EMPTY;
+    for (uint32 l = start; l < end; ++l) {
+        bbox.expand(lights[l].bounds.bounds);
+        centroidBounds.expand(lights[l].centroid);
+    }
+
+    // Find the cheapest split along the three axes
+    Float  bestCost = F_INFINITY;
+    uint32 bestDim  = 0;
+    uint32 bestBin  = 0;
+
+    const Vec3 extent = centroidBounds.sizes();
+    auto binIndex = [&](const BuildLight& light, uint32 dim) {
+        uint32 b = (uint32)(LIGHT_TREE_NUM_BINS * (light.centroid[dim] - centroidBounds.min()[dim]) / extent[dim]);
+        return std::min(b, LIGHT_TREE_NUM_BINS - 1);
+    };
+
+    for (uint32 dim = 0; dim < 3; ++dim) {
+        if (extent[dim] == 0)
+            continue;
+
+        LightBounds bins[LIGHT_TREE_NUM_BINS];
+        for (uint32 l = start; l < end; ++l) {
+            const uint32 b = binIndex(lights[l], dim);
+            bins[b] = unionBounds(bins[b], lights[l].bounds);
+        }
+
+        for (uint32 split = 0; split < LIGHT_TREE_NUM_BINS - 1; ++split) {
+            LightBounds left, right;
+            for (uint32 b = 0; b <= split; ++b)
+                left = unionBounds(left, bins[b]);
+            for (uint32 b = split + 1; b < LIGHT_TREE_NUM_BINS; ++b)
+                right = unionBounds(right, bins[b]);
+
+            if (left.phi == 0 || right.phi == 0)
+                continue;
+
+            const Float cost = splitCost(left, bbox, dim) + splitCost(right, bbox, dim);
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestDim  = dim;
+                bestBin  = split;
+            }
+        }
+    }
+
+    // Lights on top of each other are split in halves
+    uint32 mid = (start + end) / 2;
+    if (bestCost < F_INFINITY) {
+        auto it = std::partition(lights.begin() + start, lights.begin() + end, [&](const BuildLight& light) {
+            return binIndex(light, bestDim) <= bestBin;
+        });
+
+        const uint32 partMid = (uint32)(it - lights.begin());
+        if (partMid > start && partMid < end)
+            mid = partMid;
+    }
+
+    buildNode(lights, start, mid, nodeIdx);
+    const uint32 second = buildNode(lights, mid, end, nodeIdx);
+
+    _nodes[nodeIdx].bounds = unionBounds(_nodes[nodeIdx + 1].bounds, _nodes[second].bounds);
+    _nodes[nodeIdx].index  = second;
+    _nodes[nodeIdx].leaf   = false;
+
+    return nodeIdx;
+}
+
+Float LightTree::importance(uint32 node, const RayEvent& ref) const {
+    return _nodes[node].bounds.importance(ref.point, ref.normal);
+}
+
+Float LightTree::infiniteProb() const {
+    if (_infinite.empty())
+        return 0;
+
+    return (Float)_infinite.size() / (_infinite.size() + (_nodes.empty() ? 0 : 1));
+}
+
+uint32 LightTree::numNodes() const {
+    return (uint32)_nodes.size();
+}
+
+const Light* LightTree::sample(const RayEvent& ref, Float rand, Float* pdf) const {
+    *pdf = 0;
+
+    // Lights without bounds count as one more child of the root
+    const Float pInfinite = infiniteProb();
+    if (rand < pInfinite) {
+        const uint32 numInfinite = (uint32)_infinite.size();
+        const uint32 idx = std::min((uint32)(rand / pInfinite * numInfinite), numInfinite - 1);
+
+        *pdf = pInfinite / numInfinite;
+        return _infinite[idx];
+    }
+
+    if (_nodes.empty())
+        return nullptr;
+
+    rand = std::min((rand - pInfinite) / (1 - pInfinite), ONE_MINUS_EPSILON);
+    Float pmf = 1 - pInfinite;
+
+    // Descend picking children by their importance, reusing the number
+    uint32 node = 0;
+    while (!_nodes[node].leaf) {
+        const uint32 first  = node + 1;
+        const uint32 second = _nodes[node].index;
+
+        const Float imp0 = importance(first, ref);
+        const Float imp1 = importance(second, ref);
+        if (imp0 == 0 && imp1 == 0)
+            return nullptr;
+
+        const Float p0 = imp0 / (imp0 + imp1);
+        if (rand < p0) {
+            node = first;
+            rand = std::min(rand / p0, ONE_MINUS_EPSILON);
+            pmf *= p0;
+        } else {
+            node = second;
+            rand = std::min((rand - p0) / (1 - p0), ONE_MINUS_EPSILON);
+            pmf *= 1 - p0;
+        }
+    }
+
+    // A lone light is only picked where it may contribute
+    if (node == 0 && importance(node, ref) == 0)
+        return nullptr;
+
+    *pdf = pmf;
+    return _lights[_nodes[node].index];
+}
+
+Float LightTree::pdf(const RayEvent& ref, const Light* light) const {
+    const Float pInfinite = infiniteProb();
+
+    auto it = _leaves.find(light);
+    if (it == _leaves.end()) {
+        if (std::find(_infinite.begin(), _infinite.end(), light) != _infinite.end())
+            return pInfinite / _infinite.size();
+
+        return 0;
+    }
+
+    // Climb to the root with the chance of each choice on the way
+    uint32 node = it->second;
+    if (node == 0)
+        return importance(node, ref) > 0 ? 1 - pInfinite : 0;
+
+    Float pmf = 1 - pInfinite;
+    while (node != 0) {
+        const uint32 parent  = _nodes[node].parent;
+        const uint32 sibling = (node == parent + 1) ? _nodes[parent].index : parent + 1;
+
+        const Float imp = importance(node, ref);
+        if (imp == 0)
+            return 0;
+
+        pmf *= imp / (imp + importance(sibling, ref));
+        node = parent;
+    }
+
+    return pmf;
+}
\ No newline at end of file
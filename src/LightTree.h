@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+#include <PhotonMath.h>
+#include <Vector.h>
+#include <Bounds.h>
+
+namespace Photon {
+
+    // Forward declarations
+    class Light;
+    class RayEvent;
+
+    // Where a light, or a group of them, emits from and towards. Normals
+    // lie within theta_o of the axis and emission leaves them at up to
+    // theta_e, both stored as cosines. Lights without power are empty.
+    struct LightBounds {
+        Bounds3 bounds;
+        Vec3    axis;
+        Float   cosTheta_o;
+        Float   cosTheta_e;
+        Float   phi;
+
+        LightBounds()
+            : bounds(Bounds3::EMPTY), axis(0, 0, 1), cosTheta_o(1), cosTheta_e(1), phi(0) { }
+        LightBounds(const Bounds3& bounds, const Vec3& axis, Float cosTheta_o, Float cosTheta_e, Float phi)
+            : bounds(bounds), axis(axis), cosTheta_o(cosTheta_o), cosTheta_e(cosTheta_e), phi(phi) { }
+
+        // Conservative estimate of the light reaching a point with the
+        // given normal, zero where none can. A zero normal is ignored.
+        Float importance(const Point3& p, const Normal& n) const;
+    };
+
+    LightBounds unionBounds(const LightBounds& lb1, const LightBounds& lb2);
+
+    // Bounding volume hierarchy over the lights with a position (Conty and
+    // Kulla, Importance Sampling of Many Lights with Adaptive Tree Splitting).
+    // Lights are picked by descending from the root, choosing children by
+    // their importance for the shading point, the pdf of a light is found
+    // by climbing from its leaf. Lights without bounds, like directional
+    // lights, are sampled uniformly besides the tree.
+    class LightTree {
+    public:
+        LightTree(const std::vector<Light*>& lights);
+
+        const Light* sample(const RayEvent& ref, Float rand, Float* pdf) const;
+        Float pdf(const RayEvent& ref, const Light* light) const;
+
+        uint32 numNodes() const;
+
+    private:
+        struct LightNode {
+            LightBounds bounds;
+            uint32 index;       // Second child of interior nodes, the first follows its parent. Light of leaves.
+            uint32 parent;
+            bool   leaf;
+        };
+
+        struct BuildLight {
+            LightBounds bounds;
+            Point3 centroid;
+            uint32 light;
+        };
+
+        uint32 buildNode(std::vector<BuildLight>& lights, uint32 start, uint32 end, uint32 parent);
+
+        Float importance(uint32 node, const RayEvent& ref) const;
+
+        // Chance of picking one of the lights without bounds
+        Float infiniteProb() const;
+
+        std::vector<LightNode> _nodes;
+        std::vector<const Light*> _lights;
+        std::vector<const Light*> _infinite;
+        std::unordered_map<const Light*, uint32> _leaves;
+    };
+
+}
\ No newline at end of file
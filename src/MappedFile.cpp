@@ -0,0 +1,109 @@
+#include <MappedFile.h>
+
+#include <cstdint>
+
+#ifdef PHOTON_WINDOWS
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace Photon;
+using namespace Photon::Utils;
+
+static const uintptr_t PAGE_SIZE_BYTES = 4096;
+
+#ifdef PHOTON_WINDOWS
+
+MappedFile::MappedFile(const std::string& path)
+    : _data(nullptr), _size(0), _file(INVALID_HANDLE_VALUE), _mapping(nullptr) {
+
+    _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (_file == INVALID_HANDLE_VALUE)
+        return;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+        return;
+
+    _mapping = CreateFileMappingA(_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (!_mapping)
+        return;
+
+    _data = (uint8*)MapViewOfFile(_mapping, FILE_MAP_COPY, 0, 0, 0);
+    if (_data)
+        _size = (size_t)size.QuadPart;
+}
+
+void MappedFile::release(const void* data, size_t size) {
+    const uintptr_t start = ((uintptr_t)data + PAGE_SIZE_BYTES - 1) & ~(PAGE_SIZE_BYTES - 1);
+    const uintptr_t end   = ((uintptr_t)data + size) & ~(PAGE_SIZE_BYTES - 1);
+
+    // Unlocking pages that are not locked removes them from the working set
+    if (end > start)
+        VirtualUnlock((void*)start, end - start);
+}
+
+MappedFile::~MappedFile() {
+    if (_data)
+        UnmapViewOfFile(_data);
+
+    if (_mapping)
+        CloseHandle(_mapping);
+
+    if (_file != INVALID_HANDLE_VALUE)
+        CloseHandle(_file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+    : _data(nullptr), _size(0) {
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        // The mapping outlives the descriptor
+        void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            _data = (uint8*)data;
+            _size = (size_t)info.st_size;
+        }
+    }
+
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (_data)
+        munmap(_data, _size);
+}
+
+void MappedFile::release(const void* data, size_t size) {
+    const uintptr_t start = ((uintptr_t)data + PAGE_SIZE_BYTES - 1) & ~(PAGE_SIZE_BYTES - 1);
+    const uintptr_t end   = ((uintptr_t)data + size) & ~(PAGE_SIZE_BYTES - 1);
+
+    if (end > start)
+        madvise((void*)start, end - start, MADV_DONTNEED);
+}
+
+#endif
+
+bool MappedFile::isOpen() const {
+    return _data != nullptr;
+}
+
+uint8* MappedFile::data() const {
+    return _data;
+}
+
+size_t MappedFile::size() const {
+    return _size;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+
+#include <PhotonTracer.h>
+#include <IntTypes.h>
+
+namespace Photon {
+
+    namespace Utils {
+
+        // File mapped into memory for as long as the object lives. Pages are
+        // copied on write, so buffers used in place can still be modified
+        // without touching the file.
+        class MappedFile {
+        public:
+            MappedFile(const std::string& path);
+            ~MappedFile();
+
+            // Do not allow copies, the mapping has a single owner
+            MappedFile(const MappedFile& file) = delete;
+            MappedFile& operator=(const MappedFile& file) = delete;
+
+            bool isOpen() const;
+
+            uint8* data() const;
+            size_t size() const;
+
+            // Drops the whole pages within a range of a mapping from memory.
+            // Unmodified pages are read again from the file when next used.
+            static void release(const void* data, size_t size);
+
+        private:
+            uint8* _data;
+            size_t _size;
+
+#ifdef PHOTON_WINDOWS
+            void* _file;
+            void* _mapping;
+#endif
+        };
+
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+
+#include <PhotonTracer.h>
+
+#ifdef PHOTON_WINDOWS
+#include <malloc.h>
+#endif
+
+namespace Photon {
+
+    namespace Utils {
+
+        static const size_t CACHE_LINE_SIZE = 64;
+
+        inline void* allocAligned(size_t size, size_t alignment = CACHE_LINE_SIZE) {
+#ifdef PHOTON_WINDOWS
+            return _aligned_malloc(size, alignment);
+#else
+            void* ptr = nullptr;
+            if (posix_memalign(&ptr, alignment, size) != 0)
+                return nullptr;
+
+            return ptr;
+#endif
+        }
+
+        inline void freeAligned(void* ptr) {
+#ifdef PHOTON_WINDOWS
+            _aligned_free(ptr);
+#else
+            free(ptr);
+#endif
+        }
+
+        // Allocator for containers whose storage must start on an aligned boundary
+        template <typename T, size_t Alignment = CACHE_LINE_SIZE>
+        class AlignedAllocator {
+        public:
+            typedef T value_type;
+
+            template <typename U>
+            struct rebind {
+                typedef AlignedAllocator<U, Alignment> other;
+            };
+
+            AlignedAllocator() { }
+
+            template <typename U>
+            AlignedAllocator(const AlignedAllocator<U, Alignment>&) { }
+
+            T* allocate(size_t n) {
+                void* ptr = allocAligned(n * sizeof(T), Alignment);
+                if (!ptr)
+                    throw std::bad_alloc();
+
+                return static_cast<T*>(ptr);
+            }
+
+            void deallocate(T* ptr, size_t) {
+                freeAligned(ptr);
+            }
+
+            template <typename U>
+            bool operator==(const AlignedAllocator<U, Alignment>&) const {
+                return true;
+            }
+
+            template <typename U>
+            bool operator!=(const AlignedAllocator<U, Alignment>&) const {
+                return false;
+            }
+        };
+
+    }
+
+}
\ No newline at end of file
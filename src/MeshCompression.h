@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <PhotonMath.h>
+#include <Vector.h>
+
+namespace Photon {
+
+    // Bits of each axis of a quantized position, the three fit in a word.
+    // The error is below 2^-22 of the extent of the mesh along the axis.
+    static const uint32 POSITION_BITS = 21;
+    static const uint64 POSITION_MAX  = (1ull << POSITION_BITS) - 1;
+
+    // Positions are stored as steps of scale from origin, the
+    // minimum of the mesh bounds
+    struct MeshQuantization {
+        Point3 origin;
+        Vec3   scale;
+    };
+
+    inline uint64 quantizePosition(const Point3& p, const MeshQuantization& quant) {
+        uint64 packed = 0;
+        for (uint32 i = 0; i < 3; ++i) {
+            Float steps = quant.scale[i] > 0 ? (p[i] - quant.origin[i]) / quant.scale[i] : 0;
+            uint64 q = (uint64)std::min(std::max(std::round(steps), (Float)0), (Float)POSITION_MAX);
+
+            packed |= q << (i * POSITION_BITS);
+        }
+
+        return packed;
+    }
+
+    inline Point3 dequantizePosition(uint64 packed, const MeshQuantization& quant) {
+        return Point3(quant.origin.x + (Float)(packed & POSITION_MAX) * quant.scale.x,
+                      quant.origin.y + (Float)(packed >> POSITION_BITS & POSITION_MAX) * quant.scale.y,
+                      quant.origin.z + (Float)(packed >> 2 * POSITION_BITS & POSITION_MAX) * quant.scale.z);
+    }
+
+    // Unit vector folded onto the octahedron and unwrapped into a square,
+    // 16 bits per coordinate. Zero vectors decode as +z.
+    inline uint32 encodeOctahedral(const Vec3& v) {
+        Float l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+        if (l1 == 0)
+            return 0x7FFF7FFF;
+
+        Float x = v.x / l1;
+        Float y = v.y / l1;
+        if (v.z < 0) {
+            Float fx = (1 - std::abs(y)) * (x < 0 ? -1 : 1);
+            Float fy = (1 - std::abs(x)) * (y < 0 ? -1 : 1);
+            x = fx;
+            y = fy;
+        }
+
+        uint32 qx = (uint32)std::round((x * 0.5 + 0.5) * 65535);
+        uint32 qy = (uint32)std::round((y * 0.5 + 0.5) * 65535);
+
+        return qx | qy << 16;
+    }
+
+    inline Vec3 decodeOctahedral(uint32 code) {
+        Float x = (Float)(code & 0xFFFF) / 65535 * 2 - 1;
+        Float y = (Float)(code >> 16) / 65535 * 2 - 1;
+        Float z = 1 - std::abs(x) - std::abs(y);
+
+        if (z < 0) {
+            Float fx = (1 - std::abs(y)) * (x < 0 ? -1 : 1);
+            Float fy = (1 - std::abs(x)) * (y < 0 ? -1 : 1);
+            x = fx;
+            y = fy;
+        }
+
+        return normalize(Vec3(x, y, z));
+    }
+
+    // IEEE half precision, rounded to the nearest even
+    inline uint16 floatToHalf(float value) {
+        uint32 bits;
+        memcpy(&bits, &value, sizeof(float));
+
+        const uint32 sign = bits >> 16 & 0x8000;
+        const uint32 mant = bits & 0x7FFFFF;
+        const int32  exp  = (int32)(bits >> 23 & 0xFF) - 127 + 15;
+
+        // Infinities and NaNs keep their kind, too large values overflow
+        if ((bits & 0x7F800000) == 0x7F800000)
+            return (uint16)(sign | 0x7C00 | (mant ? 0x200 : 0));
+        if (exp >= 31)
+            return (uint16)(sign | 0x7C00);
+
+        // Subnormals shift the implicit bit into the mantissa
+        if (exp <= 0) {
+            if (exp < -10)
+                return (uint16)sign;
+
+            const uint32 full  = mant | 0x800000;
+            const uint32 shift = 14 - exp;
+            const uint32 rem   = full & ((1u << shift) - 1);
+            const uint32 mid   = 1u << (shift - 1);
+
+            uint32 half = full >> shift;
+            if (rem > mid || (rem == mid && (half & 1)))
+                half++;
+
+            return (uint16)(sign | half);
+        }
+
+        // A carry out of the mantissa correctly bumps the exponent
+        uint32 half = sign | (uint32)exp << 10 | mant >> 13;
+        const uint32 rem = mant & 0x1FFF;
+        if (rem > 0x1000 || (rem == 0x1000 && (half & 1)))
+            half++;
+
+        return (uint16)half;
+    }
+
+    inline float halfToFloat(uint16 half) {
+        const uint32 sign = (uint32)(half & 0x8000) << 16;
+        const uint32 exp  = half >> 10 & 0x1F;
+        const uint32 mant = half & 0x3FF;
+
+        if (exp == 0) {
+            float value = std::ldexp((float)mant, -24);
+            return sign ? -value : value;
+        }
+
+        uint32 bits;
+        if (exp == 31)
+            bits = sign | 0x7F800000 | mant << 13;
+        else
+            bits = sign | (exp + 112) << 23 | mant << 13;
+
+        float value;
+        memcpy(&value, &bits, sizeof(float));
+
+        return value;
+    }
+
+}
\ No newline at end of file
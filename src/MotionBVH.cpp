@@ -0,0 +1,212 @@
+#include <MotionBVH.h>
+
+#include <Threading.h>
+
+using namespace Photon;
+
+// Slab test of the node bounds interpolated at the ray's time
+static inline bool intersectMotionBox(const MotionBounds& bounds, const Ray& ray, Float time,
+                                      const Vec3& invDir, const uint32 dirIsNeg[3]) {
+    const Point3& origin = ray.origin();
+
+    Float tMin = ray.minT();
+    Float tMax = ray.maxT();
+    for (uint32 i = 0; i < 3; ++i) {
+        const Float bboxMin = (1 - time) * bounds.bboxMin[0][i] + time * bounds.bboxMin[1][i];
+        const Float bboxMax = (1 - time) * bounds.bboxMax[0][i] + time * bounds.bboxMax[1][i];
+
+        Float tNear = ((dirIsNeg[i] ? bboxMax : bboxMin) - origin[i]) * invDir[i];
+        Float tFar  = ((dirIsNeg[i] ? bboxMin : bboxMax) - origin[i]) * invDir[i];
+
+        if (tNear > tMin)
+            tMin = tNear;
+        if (tFar < tMax)
+            tMax = tFar;
+
+        if (tMin > tMax)
+            return false;
+    }
+
+    return true;
+}
+
+MotionBVH::MotionBVH(const std::vector<std::shared_ptr<Shape>>& shapes, uint32 maxPrimsInNode)
+    : BVH(shapes, maxPrimsInNode) { }
+
+void MotionBVH::initialize() {
+    BVH::initialize();
+    computeMotionBounds();
+}
+
+bool MotionBVH::refit() {
+    BVH::refit();
+    computeMotionBounds();
+
+    return true;
+}
+
+void MotionBVH::computeMotionBounds() {
+    const uint32 numNodes = (uint32)_nodes.size();
+    _motionBounds.resize(numNodes);
+
+    std::vector<Bounds3> start(numNodes, Bounds3::EMPTY);
+    std::vector<Bounds3> end(numNodes, Bounds3::EMPTY);
+
+    // Leaves gather their primitives, faces never move
+    const uint32 numPartitions = Threading::Workers->numThreads() * 4;
+    Threading::parallelFor(0, numNodes, numPartitions, [&](uint32 n) {
+        const BVHNode& node = _nodes[n];
+        if (node.numPrims == 0)
+            return;
+
+        const uint32 numPackets = (node.numPrims + PACKET_WIDTH - 1) / PACKET_WIDTH;
+        TrianglePacket scratch;
+        for (uint32 p = 0; p < numPackets; ++p) {
+            const TrianglePacket& packet = leafPacket(node.offset + p, &scratch);
+
+            for (uint32 lane = 0; lane < PACKET_WIDTH; ++lane) {
+                if (!packet.shapes[lane])
+                    continue;
+
+                if (packet.shapeMask & (1 << lane)) {
+                    Bounds3 shapeStart, shapeEnd;
+                    packet.shapes[lane]->motionBounds(&shapeStart, &shapeEnd);
+
+                    start[n].expand(shapeStart);
+                    end[n].expand(shapeEnd);
+                } else {
+                    const Point3 v0(packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane]);
+                    const Vec3   e1(packet.e1[0][lane], packet.e1[1][lane], packet.e1[2][lane]);
+                    const Vec3   e2(packet.e2[0][lane], packet.e2[1][lane], packet.e2[2][lane]);
+
+                    Bounds3 face(v0);
+                    face.expand(v0 + e1);
+                    face.expand(v0 + e2);
+
+                    start[n].expand(face);
+                    end[n].expand(face);
+                }
+            }
+        }
+    });
+
+    // Children are laid out after their parent, so a reverse sweep
+    // sees them complete before the parent is reached
+    for (uint32 n = numNodes; n-- > 0;) {
+        const BVHNode& node = _nodes[n];
+        if (node.numPrims == 0) {
+            start[n] = expand(start[n + 1], start[node.offset]);
+            end[n]   = expand(end[n + 1], end[node.offset]);
+        }
+
+        MotionBounds& bounds = _motionBounds[n];
+        for (uint32 i = 0; i < 3; ++i) {
+            bounds.bboxMin[0][i] = floatRoundDown(start[n].min()[i]);
+            bounds.bboxMax[0][i] = floatRoundUp(start[n].max()[i]);
+            bounds.bboxMin[1][i] = floatRoundDown(end[n].min()[i]);
+            bounds.bboxMax[1][i] = floatRoundUp(end[n].max()[i]);
+        }
+    }
+}
+
+bool MotionBVH::intersectRay(const Ray& ray, SurfaceEvent* evt) const {
+    bool hit = false;
+    for (const Primitive& prim : _unbounded)
+        if (prim.intersectRay(ray, evt))
+            hit = true;
+
+    if (_nodes.empty())
+        return hit;
+
+    const Float time = ray.time();
+    const Vec3 invDir = ray.dir().recip();
+    const uint32 dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+    const PacketRay pray(ray);
+
+    uint32 stack[BVH_STACK_SIZE];
+    uint32 stackSize = 0;
+    uint32 nodeIdx   = 0;
+
+    while (true) {
+        const BVHNode& node = _nodes[nodeIdx];
+
+        if (intersectMotionBox(_motionBounds[nodeIdx], ray, time, invDir, dirIsNeg)) {
+            if (node.numPrims > 0) {
+                TrianglePacket scratch;
+                uint32 numPackets = (node.numPrims + PACKET_WIDTH - 1) / PACKET_WIDTH;
+                for (uint32 p = 0; p < numPackets; ++p)
+                    if (intersectPacket(leafPacket(node.offset + p, &scratch), pray, ray, evt))
+                        hit = true;
+            } else {
+                // Visit the child nearest to the ray first
+                if (dirIsNeg[node.axis]) {
+                    stack[stackSize++] = nodeIdx + 1;
+                    nodeIdx = node.offset;
+                } else {
+                    stack[stackSize++] = node.offset;
+                    nodeIdx = nodeIdx + 1;
+                }
+
+                continue;
+            }
+        }
+
+        if (stackSize == 0)
+            break;
+
+        nodeIdx = stack[--stackSize];
+    }
+
+    return hit;
+}
+
+bool MotionBVH::isOccluded(const Ray& ray) const {
+    for (const Primitive& prim : _unbounded)
+        if (prim.isOccluded(ray))
+            return true;
+
+    if (_nodes.empty())
+        return false;
+
+    const Float time = ray.time();
+    const Vec3 invDir = ray.dir().recip();
+    const uint32 dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+    const PacketRay pray(ray);
+
+    uint32 stack[BVH_STACK_SIZE];
+    uint32 stackSize = 0;
+    uint32 nodeIdx   = 0;
+
+    while (true) {
+        const BVHNode& node = _nodes[nodeIdx];
+
+        if (intersectMotionBox(_motionBounds[nodeIdx], ray, time, invDir, dirIsNeg)) {
+            if (node.numPrims > 0) {
+                TrianglePacket scratch;
+                uint32 numPackets = (node.numPrims + PACKET_WIDTH - 1) / PACKET_WIDTH;
+                for (uint32 p = 0; p < numPackets; ++p)
+                    if (isOccludedPacket(leafPacket(node.offset + p, &scratch), pray, ray))
+                        return true;
+            } else {
+                stack[stackSize++] = node.offset;
+                nodeIdx = nodeIdx + 1;
+                continue;
+            }
+        }
+
+        if (stackSize == 0)
+            break;
+
+        nodeIdx = stack[--stackSize];
+    }
+
+    return false;
+}
+
+void MotionBVH::intersectRays(const RayBatch& batch, HitBatch* hits) const {
+    Accelerator::intersectRays(batch, hits);
+}
+
+uint32 MotionBVH::occludedRays(const RayBatch& batch) const {
+    return Accelerator::occludedRays(batch);
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <BVH.h>
+
+namespace Photon {
+
+    // Node bounds at both ends of the shutter, a ray tests the box
+    // interpolated at its own time
+    struct alignas(16) MotionBounds {
+        float bboxMin[2][3];
+        float bboxMax[2][3];
+    };
+
+    // BVH for scenes with moving shapes. The tree is built over the boxes
+    // swept by the primitives, but each node is tested against its bounds
+    // at the ray's time, so moving shapes cost close to still ones.
+    class MotionBVH : public BVH {
+    public:
+        MotionBVH(const std::vector<std::shared_ptr<Shape>>& shapes, uint32 maxPrimsInNode = 4);
+
+        void initialize();
+        bool refit();
+
+        bool intersectRay(const Ray& ray, SurfaceEvent* evt) const;
+        bool isOccluded(const Ray& ray) const;
+
+        // Rays of a batch may differ in time, they are traced one by one
+        void intersectRays(const RayBatch& batch, HitBatch* hits) const;
+        uint32 occludedRays(const RayBatch& batch) const;
+
+    private:
+        void computeMotionBounds();
+
+        std::vector<MotionBounds, Utils::AlignedAllocator<MotionBounds>> _motionBounds;
+    };
+
+}
\ No newline at end of file
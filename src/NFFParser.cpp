@@ -1,9 +1,12 @@
 #include <NFFParser.h>
 
 #include <memory>
+#include <cstring>
 #include <filesystem>
 
 #include <Utils.h>
+#include <Tokenizer.h>
+#include <MappedFile.h>
 #include <Scene.h>
 #include <Sphere.h>
 #include <Cylinder.h>
@@ -14,6 +17,9 @@
 #include <Box.h>
 #include <Quad.h>
 #include <TriMesh.h>
+#include <Instance.h>
+#include <SceneCache.h>
+#include <PageCache.h>
 #include <Perspective.h>
 
 #include <DirectionalLight.h>
@@ -45,39 +51,62 @@ using namespace Photon;
 using namespace Photon::Utils;
 
 // Static attributes
-std::ifstream NFFParser::_buffer = std::ifstream();
-std::istringstream NFFParser::_lineBuffer = std::istringstream();
+std::unique_ptr<MappedFile> NFFParser::_file = nullptr;
+const char* NFFParser::_next = nullptr;
+const char* NFFParser::_end = nullptr;
+const char* NFFParser::_pos = nullptr;
+const char* NFFParser::_lineEnd = nullptr;
+std::string NFFParser::_token = std::string();
 BSDF* NFFParser::_bsdf = nullptr;
+Camera* NFFParser::_camera = nullptr;
 MatrixStack NFFParser::_matStack = MatrixStack();
+bool NFFParser::_hasMotion = false;
+Mat4 NFFParser::_motionStart = Mat4();
 
 bool NFFParser::isBufferEmpty() {
-    return !_lineBuffer.rdbuf()->in_avail();
+    skipBlanks(_pos, _lineEnd);
+    return _pos == _lineEnd;
 }
 
 bool NFFParser::loadLine() {
-    std::string line;
-    std::getline(_buffer, line);
-    _lineBuffer.clear();
-    _lineBuffer.str(line);
+    if (_next == _end) {
+        _pos = _lineEnd = _end;
+        return false;
+    }
+
+    const char* newline = (const char*)memchr(_next, '\n', _end - _next);
 
-    return !_buffer.eof();
+    _pos     = _next;
+    _lineEnd = newline ? newline : _end;
+    _next    = newline ? newline + 1 : _end;
+
+    return true;
 }
 
 std::shared_ptr<Scene> NFFParser::fromFile(const std::string& filePath) {
-    // Open file
-    _buffer.open(filePath, std::ios_base::in);
-    if (_buffer.fail()) {
+    // Map file
+    _file = std::make_unique<MappedFile>(filePath);
+    if (!_file->isOpen()) {
         perror(filePath.c_str());
         Utils::throwError("Couldn't read file " + filePath);
     }
 
+    _next = (const char*)_file->data();
+    _end  = _next + _file->size();
+
+    // State left by previously parsed files
+    _bsdf      = nullptr;
+    _camera    = nullptr;
+    _matStack  = MatrixStack();
+    _hasMotion = false;
+
     // Create scene
     std::shared_ptr<Scene> scene = std::make_shared<Scene>();
 
-    // Parse each line
+    // Parse each line, the command reuses its storage
+    std::string cmd;
     while (loadLine()) {
-        std::string cmd;
-        _lineBuffer >> cmd;
+        cmd = parseStr();
 
         // Matrix stack commands
         if (cmd.compare(0, 3, "pop") == 0) {
@@ -105,12 +134,25 @@ std::shared_ptr<Scene> NFFParser::fromFile(const std::string& filePath) {
 
         if (cmd.compare(0, 3, "obj") == 0) {
             parseTriMesh(*scene);
+        } else if (cmd.compare(0, 4, "inst") == 0) {
+            parseInstance(*scene);
+        } else if (cmd.compare(0, 6, "motion") == 0) {
+            _motionStart = _matStack.loadMatrix();
+            _hasMotion = true;
         } else
 
         if (cmd.compare(0, 4, "grid") == 0) {
             std::string str = parseStr();
             if (str.compare(0, 3, "off") == 0)
-                scene->useGrid(false);
+                scene->setAccelerator(NO_ACCELERATOR);
+            else
+                scene->setAccelerator(GRID_ACCELERATOR);
+        } else if (cmd.compare(0, 5, "accel") == 0) {
+            AcceleratorType type;
+            if (!parseAccelerator(parseStr(), &type))
+                throwError("Unknown accelerator found in scene file.");
+
+            scene->setAccelerator(type);
         } else
 
         /*if (cmd.compare(0, 7, "sampler") == 0) {
@@ -131,6 +173,14 @@ std::shared_ptr<Scene> NFFParser::fromFile(const std::string& filePath) {
 
         if (cmd.compare(0, 3, "box") == 0) {
             parseBox(*scene);
+        } else if (cmd.compare(0, 7, "shutter") == 0) {
+            Float open  = parseFloat();
+            Float close = parseFloat();
+
+            if (!_camera)
+                throwError("The shutter must be set after the view.");
+
+            _camera->setShutter(open, close);
         } else if(cmd.compare(0, 4, "tone") == 0) {
             std::string op = parseStr();
             if (op.compare(0, 6, "linear") == 0) {
@@ -156,6 +206,8 @@ std::shared_ptr<Scene> NFFParser::fromFile(const std::string& filePath) {
             parseSphericalLight(*scene);
         } else if (cmd.compare(0, 3, "alp") == 0) {
             parsePlanarLight(*scene);
+        } else if (cmd.compare(0, 3, "alm") == 0) {
+            parseMeshLight(*scene);
         } else if (cmd.compare(0, 1, "v") == 0) {
             parseCamera(*scene);
         } else if (cmd.compare(0, 1, "s") == 0) {
@@ -177,9 +229,17 @@ std::shared_ptr<Scene> NFFParser::fromFile(const std::string& filePath) {
         }
     }
 
-    // Close and clear buffers
-    _buffer.close();
-    _lineBuffer.clear();
+    // The structure depends on the scene file and every mesh it loaded,
+    // and on whether paging turned the obj placements into instances
+    if (Resources::get().cacheEnabled()) {
+        uint64 key = hashCombine(hashBytes(_file->data(), _file->size()), Resources::get().contentKey());
+        key = hashCombine(key, Utils::PageCache::get().enabled());
+        scene->setCache(filePath + SCENE_CACHE_EXT, key);
+    }
+
+    // Unmap file
+    _file.reset();
+    _next = _end = _pos = _lineEnd = nullptr;
 
     return std::move(scene);
 }
@@ -427,15 +487,48 @@ void NFFParser::parseTriMesh(Scene& scene) {
     std::string path = parseStr();
     std::string name = parseStr();
 
-    // Load mesh
-    auto mesh = Resources::get().loadObj(path, name);
+    // Meshes under a page cache are placed like instances, a baked copy
+    // and a top level tree over its faces would stay resident
+    if (Utils::PageCache::get().enabled()) {
+        auto mesh = Resources::get().loadObj(path, name);
+        auto bvh  = Resources::get().meshAccelerator(name);
+
+        auto instance = std::make_shared<Instance>(mesh, bvh, Transform(_matStack.loadMatrix()));
+        instance->setBsdf(_bsdf);
+
+        scene.addShape(instance);
+        return;
+    }
+
+    // Load mesh, the cached one is shared so bake the transform into a copy
+    auto mesh = std::make_shared<TriMesh>(*Resources::get().loadObj(path, name));
     mesh->setTransform(Transform(_matStack.loadMatrix()));
     mesh->setBsdf(_bsdf);
 
-    // Add triangles to the scene
-    const auto tris = mesh->getTris();
-    for (auto obj : tris)
-        scene.addShape(obj);
+    // Accelerators reference the faces directly
+    scene.addShape(mesh);
+}
+
+void NFFParser::parseInstance(Scene& scene) {
+    std::string path = parseStr();
+    std::string name = parseStr();
+
+    // Placements of a mesh share its data and bottom level BVH
+    auto mesh = Resources::get().loadObj(path, name);
+    auto bvh  = Resources::get().meshAccelerator(name);
+
+    std::shared_ptr<Instance> instance;
+    if (_hasMotion) {
+        AnimatedTransform motion(Transform(_motionStart), Transform(_matStack.loadMatrix()));
+        instance = std::make_shared<Instance>(mesh, bvh, motion);
+        _hasMotion = false;
+    } else {
+        instance = std::make_shared<Instance>(mesh, bvh, Transform(_matStack.loadMatrix()));
+    }
+
+    instance->setBsdf(_bsdf);
+
+    scene.addShape(instance);
 }
 
 void NFFParser::parseBox(Scene & scene) {
@@ -530,6 +623,26 @@ void NFFParser::parseSphericalLight(Scene& scene) {
     scene.addAreaLight((AreaLight*)light);
 }
 
+void NFFParser::parseMeshLight(Scene& scene) {
+    std::string path = parseStr();
+    std::string name = parseStr();
+
+    // Emitting copy of the mesh, with the transform baked in
+    auto mesh = std::make_shared<TriMesh>(*Resources::get().loadObj(path, name));
+    mesh->setTransform(Transform(_matStack.loadMatrix()));
+    mesh->setBsdf(_bsdf);
+
+    // Parse light emission
+    Color emission  = parseColor();
+    uint32 nSamples = parseInt();
+
+    Light* light = new AreaLight(mesh, emission, nSamples);
+    mesh->setLight((AreaLight*)light);
+
+    // Add mesh light
+    scene.addAreaLight((AreaLight*)light);
+}
+
 void NFFParser::parseCamera(Scene& scene) {
     std::string cmd;
     Point3 from, target;
@@ -541,42 +654,42 @@ void NFFParser::parseCamera(Scene& scene) {
 
     // 'from' line
     loadLine();
-    _lineBuffer >> cmd;
+    cmd = parseStr();
     if (cmd.compare(0, 4, "from") == 0)
         from = parsePoint3();
 
     // 'at' line
     loadLine();
-    _lineBuffer >> cmd;
+    cmd = parseStr();
     if (cmd.compare(0, 2, "at") == 0)
         target = parsePoint3();
 
     // 'up' line
     loadLine();
-    _lineBuffer >> cmd;
+    cmd = parseStr();
     if (cmd.compare(0, 2, "up") == 0)
         up = parseVector3();
 
     // 'angle' line
     loadLine();
-    _lineBuffer >> cmd;
+    cmd = parseStr();
     if (cmd.compare(0, 5, "angle") == 0)
         fov = parseFloat();
 
     // 'hither' line
     loadLine();
-    _lineBuffer >> cmd;
+    cmd = parseStr();
     if (cmd.compare(0, 6, "hither") == 0)
         near = parseFloat();
 
     // 'resolution' line
     loadLine();
-    _lineBuffer >> cmd;
+    cmd = parseStr();
     if (cmd.compare(0, 10, "resolution") == 0)
         res = parseVector2();
 
     loadLine();
-    _lineBuffer >> cmd;
+    cmd = parseStr();
     if (cmd.compare(0, 4, "lens") == 0) {
         radius = parseFloat();
         focalDist = parseFloat();
@@ -587,14 +700,21 @@ void NFFParser::parseCamera(Scene& scene) {
     Camera* cam = new Perspective(camToWorld, res, fov, near, 1000); // Camera(from, up, target, fov, near, res);
     cam->setLensParams(radius, focalDist);
 
+    // After a motion command the camera moves by the change of the
+    // matrix stack since, over the frames of a sequence
+    if (_hasMotion) {
+        Transform motion = Transform(_matStack.loadMatrix()) * inverse(Transform(_motionStart));
+        cam->setAnimation(AnimatedTransform(camToWorld, motion * camToWorld));
+        _hasMotion = false;
+    }
+    _camera = cam;
+
     scene.addCamera(*cam);
 }
 
 Float NFFParser::parseFloat() {
     Float x;
-    _lineBuffer >> x;
-
-    if (_lineBuffer.fail())
+    if (!parseReal(_pos, _lineEnd, &x))
         throwError("Failed to parse file.");
 
     return x;
@@ -602,9 +722,7 @@ Float NFFParser::parseFloat() {
 
 uint32 NFFParser::parseInt() {
     uint32 x;
-    _lineBuffer >> x;
-
-    if (_lineBuffer.fail())
+    if (!parseUInt(_pos, _lineEnd, &x))
         throwError("Failed to parse file.");
 
     return x;
@@ -612,10 +730,7 @@ uint32 NFFParser::parseInt() {
 
 const Vec2 NFFParser::parseVector2() {
     Float x, y;
-    _lineBuffer >> x;
-    _lineBuffer >> y;
-
-    if (_lineBuffer.fail())
+    if (!parseReal(_pos, _lineEnd, &x) || !parseReal(_pos, _lineEnd, &y))
         throwError("Failed to parse file.");
 
     return Vec2(x, y);
@@ -623,11 +738,7 @@ const Vec2 NFFParser::parseVector2() {
 
 const Vec3 NFFParser::parseVector3() {
     Float x, y, z;
-    _lineBuffer >> x;
-    _lineBuffer >> y;
-    _lineBuffer >> z;
-
-    if (_lineBuffer.fail())
+    if (!parseReal(_pos, _lineEnd, &x) || !parseReal(_pos, _lineEnd, &y) || !parseReal(_pos, _lineEnd, &z))
         throwError("Failed to parse file.");
 
     return Vec3(x, y, z);
@@ -635,11 +746,7 @@ const Vec3 NFFParser::parseVector3() {
 
 const Color NFFParser::parseColor() {
     Float r, g, b;
-    _lineBuffer >> r;
-    _lineBuffer >> g;
-    _lineBuffer >> b;
-
-    if (_lineBuffer.fail())
+    if (!parseReal(_pos, _lineEnd, &r) || !parseReal(_pos, _lineEnd, &g) || !parseReal(_pos, _lineEnd, &b))
         throwError("Failed to parse file.");
 
     return Color(r, g, b);
@@ -647,20 +754,21 @@ const Color NFFParser::parseColor() {
 
 const Point3 NFFParser::parsePoint3() {
     Float x, y, z;
-    _lineBuffer >> x;
-    _lineBuffer >> y;
-    _lineBuffer >> z;
-
-    if (_lineBuffer.fail())
+    if (!parseReal(_pos, _lineEnd, &x) || !parseReal(_pos, _lineEnd, &y) || !parseReal(_pos, _lineEnd, &z))
         throwError("Failed to parse file.");
 
     return Point3(x, y, z);
 }
 
-const std::string NFFParser::parseStr() {
-    std::string str;
+const std::string& NFFParser::parseStr() {
+    skipBlanks(_pos, _lineEnd);
+
+    const char* start = _pos;
+    while (_pos < _lineEnd && !isBlank(*_pos))
+        ++_pos;
 
-    _lineBuffer >> str;
+    // Keeps the capacity of the previous token
+    _token.assign(start, _pos - start);
 
-    return str;
+    return _token;
 }
\ No newline at end of file
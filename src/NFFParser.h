@@ -1,8 +1,6 @@
 #pragma once
 
 #include <string>
-#include <sstream>
-#include <fstream>
 #include <memory>
 
 #include <Vector.h>
@@ -14,9 +12,16 @@ namespace Photon {
 
     // Forward declaration
     class Scene;
+    class Camera;
 
     namespace Utils {
 
+        // Forward declaration
+        class MappedFile;
+
+        // Reads the scene file in place, one line at a time. Tokens are
+        // parsed straight from the mapping and commands share a single
+        // string, so lines are read without allocating.
         class NFFParser {
         public:
             static std::shared_ptr<Scene> fromFile(const std::string& filePath);
@@ -30,6 +35,7 @@ namespace Photon {
             static void parsePolygon(Scene& scene);
             static void parsePolygonPatch(Scene& scene);
             static void parseTriMesh(Scene& scene);
+            static void parseInstance(Scene& scene);
             static void parseBox(Scene& scene);
             //static void parseMaterial(Scene& scene);
             static void parseBsdf(Scene& scene);
@@ -39,6 +45,7 @@ namespace Photon {
             static void parseSpotLight(Scene& scene);
             static void parsePlanarLight(Scene& scene);
             static void parseSphericalLight(Scene& scene);
+            static void parseMeshLight(Scene& scene);
 
             static Float        parseFloat();
             static uint32       parseInt();
@@ -46,15 +53,28 @@ namespace Photon {
             static const Vec3   parseVector3();
             static const Point3 parsePoint3();
             static const Color  parseColor();
-            static const std::string parseStr();
+            static const std::string& parseStr();
 
             static bool isBufferEmpty();
             static bool loadLine();
 
             static BSDF* _bsdf;
-            static std::ifstream _buffer;
-            static std::istringstream _lineBuffer;
+            static Camera* _camera;
+
+            static std::unique_ptr<MappedFile> _file;
+            static const char* _next;       // Start of the next line
+            static const char* _end;        // End of the file
+            static const char* _pos;        // Cursor within the current line
+            static const char* _lineEnd;    // End of the current line
+            static std::string _token;      // Last string parsed
+
             static MatrixStack _matStack;
+
+            // Set by 'motion', the next instance moves from this
+            // matrix to the one on the stack when it is placed, the
+            // next camera by the change between them
+            static bool _hasMotion;
+            static Mat4 _motionStart;
         };
     
     }
@@ -0,0 +1,381 @@
+#include <ObjParser.h>
+
+#include <vector>
+#include <cmath>
+
+#include <TriMesh.h>
+#include <MappedFile.h>
+#include <Threading.h>
+#include <Timer.h>
+#include <Tokenizer.h>
+#include <Utils.h>
+
+using namespace Photon;
+using namespace Photon::Utils;
+
+// Files smaller than this are parsed by a single thread
+static const size_t OBJ_PARALLEL_BYTES = 1 << 20;
+
+// Missing texture coordinate or normal of a corner
+static const uint32 OBJ_NONE = 0xFFFFFFFF;
+
+namespace {
+
+    // Corner of a face as written in the file. Negative indices count back
+    // from the last element read, they are kept relative to the chunk
+    // until the elements of the previous chunks are known.
+    struct ObjCorner {
+        int64 idx[3];       // Position, texture coordinates and normal
+        uint8 relative;     // Bit per index, set if relative to the chunk
+    };
+
+    struct ObjChunk {
+        std::vector<Point3> positions;
+        std::vector<Point2> uvs;
+        std::vector<Normal> normals;
+        std::vector<ObjCorner> corners;     // Three per triangle
+
+        bool failed;
+        ObjChunk() : failed(false) { }
+    };
+
+    bool parseIndex(const char*& ptr, const char* end, int64* val) {
+        bool negative = false;
+        if (ptr < end && *ptr == '-') {
+            negative = true;
+            ++ptr;
+        }
+
+        if (ptr == end || *ptr < '0' || *ptr > '9')
+            return false;
+
+        int64 idx = 0;
+        for (; ptr < end && *ptr >= '0' && *ptr <= '9'; ++ptr)
+            idx = idx * 10 + (*ptr - '0');
+
+        *val = negative ? -idx : idx;
+        return idx != 0;
+    }
+
+    // Corner as v, v/vt, v//vn or v/vt/vn
+    bool parseCorner(const char*& ptr, const char* end, const ObjChunk& chunk, ObjCorner* corner) {
+        const size_t counts[3] = { chunk.positions.size(), chunk.uvs.size(), chunk.normals.size() };
+
+        corner->relative = 0;
+        auto parseElement = [&](uint32 i) {
+            int64 idx;
+            if (!parseIndex(ptr, end, &idx))
+                return false;
+
+            if (idx > 0) {
+                corner->idx[i] = idx - 1;
+            } else {
+                corner->idx[i] = (int64)counts[i] + idx;
+                corner->relative |= 1 << i;
+            }
+
+            return true;
+        };
+
+        // Texture coordinates and normals may be left out
+        corner->idx[1] = corner->idx[2] = -1;
+        if (!parseElement(0))
+            return false;
+
+        if (ptr < end && *ptr == '/') {
+            ++ptr;
+            if (ptr < end && *ptr != '/' && !parseElement(1))
+                return false;
+
+            if (ptr < end && *ptr == '/') {
+                ++ptr;
+                if (!parseElement(2))
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    void parseChunk(const char* ptr, const char* end, ObjChunk* chunk) {
+        std::vector<ObjCorner> polygon;
+
+        while (ptr < end) {
+            skipBlanks(ptr, end);
+            if (ptr == end)
+                break;
+
+            const char c0 = *ptr;
+            const char c1 = ptr + 1 < end ? ptr[1] : '\n';
+
+            if (c0 == 'v' && isBlank(c1)) {
+                ptr += 1;
+
+                Point3 pos;
+                if (!parseReal(ptr, end, &pos.x) || !parseReal(ptr, end, &pos.y) || !parseReal(ptr, end, &pos.z)) {
+                    chunk->failed = true;
+                    return;
+                }
+
+                chunk->positions.push_back(pos);
+            } else if (c0 == 'v' && c1 == 't') {
+                ptr += 2;
+
+                Point2 uv;
+                if (!parseReal(ptr, end, &uv.x)) {
+                    chunk->failed = true;
+                    return;
+                }
+
+                // The second coordinate is optional
+                if (!parseReal(ptr, end, &uv.y))
+                    uv.y = 0;
+
+                chunk->uvs.push_back(uv);
+            } else if (c0 == 'v' && c1 == 'n') {
+                ptr += 2;
+
+                Normal n;
+                if (!parseReal(ptr, end, &n.x) || !parseReal(ptr, end, &n.y) || !parseReal(ptr, end, &n.z)) {
+                    chunk->failed = true;
+                    return;
+                }
+
+                chunk->normals.push_back(n);
+            } else if (c0 == 'f' && isBlank(c1)) {
+                ptr += 1;
+
+                polygon.clear();
+                while (true) {
+                    skipBlanks(ptr, end);
+                    if (ptr == end || *ptr == '\n' || *ptr == '#')
+                        break;
+
+                    ObjCorner corner;
+                    if (!parseCorner(ptr, end, *chunk, &corner)) {
+                        chunk->failed = true;
+                        return;
+                    }
+
+                    polygon.push_back(corner);
+                }
+
+                // Polygons are split in a fan around their first corner
+                for (uint32 v = 1; v + 1 < polygon.size(); ++v) {
+                    chunk->corners.push_back(polygon[0]);
+                    chunk->corners.push_back(polygon[v]);
+                    chunk->corners.push_back(polygon[v + 1]);
+                }
+            }
+
+            // Objects, groups, materials and anything else are ignored
+            skipLine(ptr, end);
+        }
+    }
+
+}
+
+std::shared_ptr<TriMesh> ObjParser::fromFile(const std::string& filePath) {
+    Utils::Timer timer;
+
+    MappedFile file(filePath);
+    if (!file.isOpen())
+        throwError("There was an error loading model: " + filePath + ".");
+
+    const char* data = (const char*)file.data();
+    const size_t size = file.size();
+
+    // Chunks end on line breaks, each is parsed on its own
+    const uint32 numChunks = (size < OBJ_PARALLEL_BYTES || !Threading::Workers) ? 1 :
+                             Threading::Workers->numThreads() * 4;
+
+    std::vector<size_t> bounds(numChunks + 1, size);
+    bounds[0] = 0;
+    for (uint32 c = 1; c < numChunks; ++c) {
+        size_t pos = std::max(size * c / numChunks, bounds[c - 1]);
+        while (pos < size && data[pos - 1] != '\n')
+            ++pos;
+
+        bounds[c] = pos;
+    }
+
+    std::vector<ObjChunk> chunks(numChunks);
+    Threading::parallelFor(0, numChunks, numChunks, [&](uint32 c) {
+        parseChunk(data + bounds[c], data + bounds[c + 1], &chunks[c]);
+    });
+
+    // Elements of each chunk follow those of the previous ones
+    std::vector<uint64> bases[3];
+    std::vector<uint64> cornerBase(numChunks + 1, 0);
+    for (uint32 i = 0; i < 3; ++i)
+        bases[i].assign(numChunks + 1, 0);
+
+    for (uint32 c = 0; c < numChunks; ++c) {
+        if (chunks[c].failed)
+            throwError("Malformed model: " + filePath + ".");
+
+        bases[0][c + 1] = bases[0][c] + chunks[c].positions.size();
+        bases[1][c + 1] = bases[1][c] + chunks[c].uvs.size();
+        bases[2][c + 1] = bases[2][c] + chunks[c].normals.size();
+        cornerBase[c + 1] = cornerBase[c] + chunks[c].corners.size();
+    }
+
+    const uint64 numPositions = bases[0][numChunks];
+    const uint64 numCorners   = cornerBase[numChunks];
+    if (numCorners == 0)
+        throwError("Model has no faces: " + filePath + ".");
+
+    if (numCorners > 0xFFFFFFF0ull || numPositions > 0xFFFFFFF0ull)
+        throwError("Model is too large: " + filePath + ".");
+
+    // Resolve the corners against the whole file
+    std::vector<uint32> corners[3];
+    for (uint32 i = 0; i < 3; ++i)
+        corners[i].resize(numCorners);
+
+    std::vector<uint8> invalid(numChunks, 0);
+    std::vector<uint8> allNormals(numChunks, 1);
+    std::vector<uint8> anyUVs(numChunks, 0);
+
+    Threading::parallelFor(0, numChunks, numChunks, [&](uint32 c) {
+        const std::vector<ObjCorner>& chunkCorners = chunks[c].corners;
+        const uint64 base = cornerBase[c];
+
+        for (uint64 k = 0; k < chunkCorners.size(); ++k) {
+            const ObjCorner& corner = chunkCorners[k];
+
+            for (uint32 i = 0; i < 3; ++i) {
+                int64 idx = corner.idx[i];
+                if (idx < 0 && !(corner.relative & (1 << i))) {
+                    corners[i][base + k] = OBJ_NONE;
+                    continue;
+                }
+
+                if (corner.relative & (1 << i))
+                    idx += (int64)bases[i][c];
+
+                if (idx < 0 || (uint64)idx >= bases[i][numChunks]) {
+                    invalid[c] = 1;
+                    idx = 0;
+                }
+
+                corners[i][base + k] = (uint32)idx;
+            }
+
+            if (corners[1][base + k] != OBJ_NONE)
+                anyUVs[c] = 1;
+            if (corners[2][base + k] == OBJ_NONE)
+                allNormals[c] = 0;
+        }
+    });
+
+    bool hasUVs = false, hasNormals = true;
+    for (uint32 c = 0; c < numChunks; ++c) {
+        if (invalid[c])
+            throwError("Model references missing vertices: " + filePath + ".");
+
+        hasUVs     = hasUVs || anyUVs[c];
+        hasNormals = hasNormals && allNormals[c];
+    }
+
+    // Group corners by position, a counting sort keeps them in file order
+    std::vector<uint32> posStart(numPositions + 1, 0);
+    for (uint64 k = 0; k < numCorners; ++k)
+        posStart[corners[0][k] + 1]++;
+
+    for (uint64 p = 0; p < numPositions; ++p)
+        posStart[p + 1] += posStart[p];
+
+    std::vector<uint32> order(numCorners);
+    {
+        std::vector<uint32> fill(posStart.begin(), posStart.end() - 1);
+        for (uint64 k = 0; k < numCorners; ++k)
+            order[fill[corners[0][k]]++] = (uint32)k;
+    }
+
+    // Corners of a position share a vertex if their texture coordinates and
+    // normals match too. Distinct ones are few, a linear search finds them.
+    auto sameVertex = [&](uint32 k1, uint32 k2) {
+        return (!hasUVs || corners[1][k1] == corners[1][k2]) &&
+               (!hasNormals || corners[2][k1] == corners[2][k2]);
+    };
+
+    std::vector<uint32> cornerVertex(numCorners);
+    std::vector<uint32> firstCorner(numCorners);    // First corner of each vertex, within its group
+    std::vector<uint32> numWelded(numPositions + 1, 0);
+
+    const uint32 numPartitions = numChunks == 1 ? 1 : Threading::Workers->numThreads() * 4;
+    Threading::parallelRange(0, (uint32)numPositions, numPartitions, [&](uint32, uint32 pStart, uint32 pEnd) {
+        for (uint32 p = pStart; p < pEnd; ++p) {
+            const uint32 start = posStart[p];
+            uint32 count = 0;
+
+            for (uint32 o = start; o < posStart[p + 1]; ++o) {
+                const uint32 k = order[o];
+
+                uint32 v = 0;
+                while (v < count && !sameVertex(firstCorner[start + v], k))
+                    ++v;
+
+                if (v == count)
+                    firstCorner[start + count++] = k;
+
+                cornerVertex[k] = v;
+            }
+
+            numWelded[p + 1] = count;
+        }
+    });
+
+    for (uint64 p = 0; p < numPositions; ++p)
+        numWelded[p + 1] += numWelded[p];
+
+    const uint32 numVerts = numWelded[numPositions];
+    const uint32 numFaces = (uint32)(numCorners / 3);
+
+    // Gather the elements of the chunks into single arrays
+    std::vector<Point3> positions(numPositions);
+    std::vector<Point2> uvs(bases[1][numChunks]);
+    std::vector<Normal> normals(bases[2][numChunks]);
+    Threading::parallelFor(0, numChunks, numChunks, [&](uint32 c) {
+        std::copy(chunks[c].positions.begin(), chunks[c].positions.end(), positions.begin() + bases[0][c]);
+        std::copy(chunks[c].uvs.begin(), chunks[c].uvs.end(), uvs.begin() + bases[1][c]);
+        std::copy(chunks[c].normals.begin(), chunks[c].normals.end(), normals.begin() + bases[2][c]);
+    });
+
+    std::vector<Point3> verts(numVerts);
+    std::vector<Normal> vertNormals(hasNormals ? numVerts : 0);
+    std::vector<Point2> vertUVs(hasUVs ? numVerts : 0);
+    std::vector<uint32> indices(numCorners);
+
+    Threading::parallelRange(0, (uint32)numPositions, numPartitions, [&](uint32, uint32 pStart, uint32 pEnd) {
+        for (uint32 p = pStart; p < pEnd; ++p) {
+            for (uint32 v = 0; v < numWelded[p + 1] - numWelded[p]; ++v) {
+                const uint32 vertIdx = numWelded[p] + v;
+                const uint32 k = firstCorner[posStart[p] + v];
+
+                verts[vertIdx] = positions[p];
+
+                if (hasNormals)
+                    vertNormals[vertIdx] = normalize(normals[corners[2][k]]);
+
+                if (hasUVs)
+                    vertUVs[vertIdx] = corners[1][k] != OBJ_NONE ? uvs[corners[1][k]] : Point2(0);
+            }
+        }
+    });
+
+    Threading::parallelRange(0, (uint32)numCorners, numPartitions, [&](uint32, uint32 kStart, uint32 kEnd) {
+        for (uint32 k = kStart; k < kEnd; ++k)
+            indices[k] = numWelded[corners[0][k]] + cornerVertex[k];
+    });
+
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(numFaces, numVerts, indices.data(), verts.data(),
+        hasNormals ? vertNormals.data() : nullptr, nullptr, hasUVs ? vertUVs.data() : nullptr, nullptr, Transform());
+
+    timer.stop();
+    std::cout << "Obj: " << filePath << ", " << numFaces << " faces, " << numVerts << " vertices welded from "
+              << numCorners << " corners (" << Float(numCorners) / numVerts << "x) in " << timer.elapsed() << " ms" << std::endl;
+
+    return mesh;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <memory>
+
+namespace Photon {
+
+    // Forward declaration
+    class TriMesh;
+
+    namespace Utils {
+
+        // Wavefront OBJ reader. The file is mapped and split into chunks
+        // parsed concurrently, then corners sharing their position, normal
+        // and texture coordinates are welded into single vertices. Every
+        // object and group of the file ends up in the same mesh.
+        class ObjParser {
+        public:
+            static std::shared_ptr<TriMesh> fromFile(const std::string& filePath);
+        };
+
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include <PageCache.h>
+
+#include <algorithm>
+#include <cstdint>
+
+#include <MappedFile.h>
+
+using namespace Photon;
+using namespace Photon::Utils;
+
+void PageCache::setBudget(size_t bytes) {
+    _budget = bytes;
+}
+
+size_t PageCache::budget() const {
+    return _budget;
+}
+
+bool PageCache::enabled() const {
+    return _budget > 0;
+}
+
+uint64 PageCache::pageIns() const {
+    return _pageIns;
+}
+
+uint64 PageCache::evictions() const {
+    return _evictions;
+}
+
+void PageCache::resetCounters() {
+    _pageIns   = 0;
+    _evictions = 0;
+}
+
+size_t PageCache::residentBytes() const {
+    return _resident;
+}
+
+void PageCache::pageIn(PagedRegion& region, uint32 cluster) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Another thread may have paged it in meanwhile
+    std::atomic<uint8>& state = region._clusters[cluster];
+    if (state != PagedRegion::CLUSTER_RELEASED) {
+        state = PagedRegion::CLUSTER_REFERENCED;
+        return;
+    }
+
+    const uint8* start;
+    size_t size;
+    region.clusterRange(cluster, &start, &size);
+
+    state = PagedRegion::CLUSTER_REFERENCED;
+    _clock.push_back(std::make_pair(&region, cluster));
+    _resident += size;
+    _pageIns++;
+
+    // Clusters used since the last pass get a second chance, the
+    // new one is at the back so it is the last to be considered
+    while (_resident > _budget && _clock.size() > 1) {
+        std::pair<PagedRegion*, uint32> entry = _clock.front();
+        _clock.pop_front();
+
+        std::atomic<uint8>& entryState = entry.first->_clusters[entry.second];
+        if (entryState == PagedRegion::CLUSTER_REFERENCED) {
+            entryState = PagedRegion::CLUSTER_RESIDENT;
+            _clock.push_back(entry);
+        } else {
+            evict(*entry.first, entry.second);
+        }
+    }
+}
+
+void PageCache::evict(PagedRegion& region, uint32 cluster) {
+    const uint8* start;
+    size_t size;
+    region.clusterRange(cluster, &start, &size);
+
+    region._clusters[cluster] = PagedRegion::CLUSTER_RELEASED;
+    MappedFile::release(start, size);
+
+    _resident -= size;
+    _evictions++;
+}
+
+void PageCache::release(PagedRegion& region) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto end = std::remove_if(_clock.begin(), _clock.end(), [&region](const std::pair<PagedRegion*, uint32>& entry) {
+        return entry.first == &region;
+    });
+
+    for (auto it = end; it != _clock.end(); ++it) {
+        const uint8* start;
+        size_t size;
+        region.clusterRange(it->second, &start, &size);
+
+        _resident -= size;
+    }
+
+    _clock.erase(end, _clock.end());
+}
+
+PagedRegion::PagedRegion(const uint8* data, size_t size)
+    : _data(data), _size(size) {
+
+    _base = (const uint8*)((uintptr_t)data & ~(uintptr_t)(PAGE_CLUSTER_SIZE - 1));
+
+    // Nothing is counted as resident until it is first read
+    const size_t numClusters = (data + size - _base + PAGE_CLUSTER_SIZE - 1) / PAGE_CLUSTER_SIZE;
+    _clusters = std::make_unique<std::atomic<uint8>[]>(numClusters);
+    for (size_t c = 0; c < numClusters; ++c)
+        _clusters[c] = CLUSTER_RELEASED;
+}
+
+PagedRegion::~PagedRegion() {
+    PageCache::get().release(*this);
+}
+
+void PagedRegion::clusterRange(uint32 cluster, const uint8** start, size_t* size) const {
+    const uint8* begin = std::max(_base + cluster * PAGE_CLUSTER_SIZE, _data);
+    const uint8* end   = std::min(_base + (cluster + 1) * PAGE_CLUSTER_SIZE, _data + _size);
+
+    *start = begin;
+    *size  = end - begin;
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include <IntTypes.h>
+
+namespace Photon {
+
+    namespace Utils {
+
+        // Granularity of the residency tracking, a multiple of the page size
+        static const size_t PAGE_CLUSTER_SIZE = 64 * 1024;
+
+        // Forward declaration
+        class PagedRegion;
+
+        // Bounds the memory taken by geometry mapped from the scene cache.
+        // Regions are split into clusters which are marked as they are read,
+        // once the resident clusters exceed the budget the least recently
+        // used are found with a second chance sweep and released to the
+        // system. Released pages are clean copies of their file, reading
+        // them again simply faults them back in.
+        class PageCache {
+        public:
+            static PageCache& get() {
+                static PageCache instance;
+                return instance;
+            }
+
+            // Do not allow copies
+            PageCache(const PageCache& cache) = delete;
+            PageCache& operator=(const PageCache& cache) = delete;
+
+            // Zero leaves every mapping resident and disables the tracking
+            void setBudget(size_t bytes);
+            size_t budget() const;
+            bool enabled() const;
+
+            // Counted since the last reset, as clusters
+            uint64 pageIns() const;
+            uint64 evictions() const;
+            void resetCounters();
+
+            size_t residentBytes() const;
+
+        private:
+            friend class PagedRegion;
+
+            PageCache() : _budget(0), _resident(0), _pageIns(0), _evictions(0) { }
+
+            void pageIn(PagedRegion& region, uint32 cluster);
+            void evict(PagedRegion& region, uint32 cluster);
+            void release(PagedRegion& region);
+
+            std::mutex _mutex;
+            std::deque<std::pair<PagedRegion*, uint32>> _clock;    // Resident clusters, oldest first
+            size_t _budget;
+            std::atomic<size_t> _resident;
+            std::atomic<uint64> _pageIns;
+            std::atomic<uint64> _evictions;
+        };
+
+        // Range of a mapping whose residency is bounded by the page cache,
+        // its data must never be written
+        class PagedRegion {
+        public:
+            PagedRegion(const uint8* data, size_t size);
+            ~PagedRegion();
+
+            PagedRegion(const PagedRegion& region) = delete;
+            PagedRegion& operator=(const PagedRegion& region) = delete;
+
+            // Marks the clusters of a range as recently used, those
+            // released are paged in, which may release others
+            void touch(const void* ptr, size_t size) {
+                const size_t first = ((const uint8*)ptr - _base) / PAGE_CLUSTER_SIZE;
+                const size_t last  = ((const uint8*)ptr + size - 1 - _base) / PAGE_CLUSTER_SIZE;
+
+                for (size_t c = first; c <= last; ++c) {
+                    const uint8 state = _clusters[c].load(std::memory_order_relaxed);
+                    if (state == CLUSTER_REFERENCED)
+                        continue;
+
+                    if (state == CLUSTER_RELEASED)
+                        PageCache::get().pageIn(*this, (uint32)c);
+                    else
+                        _clusters[c].store(CLUSTER_REFERENCED, std::memory_order_relaxed);
+                }
+            }
+
+        private:
+            friend class PageCache;
+
+            enum ClusterState : uint8 {
+                CLUSTER_RELEASED,
+                CLUSTER_RESIDENT,
+                CLUSTER_REFERENCED      // Used since the sweep last passed
+            };
+
+            // Bytes of the region within a cluster
+            void clusterRange(uint32 cluster, const uint8** start, size_t* size) const;
+
+            const uint8* _data;
+            const uint8* _base;         // Data rounded down to a cluster
+            size_t _size;
+            std::unique_ptr<std::atomic<uint8>[]> _clusters;
+        };
+
+    }
+
+}
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <AreaLight.h>
 
 #include <Random.h>
+#include <RayBatch.h>
 
 #ifdef PHOTON_MSVC
 //#pragma warning(disable : 4838)
@@ -15,15 +16,17 @@ using namespace std::placeholders;
 
 void PathTracer::initialize() {
     
+    // Arrays are drawn anew in every sample, one layout serves them all
     if (_scene->lightStrategy() == ALL_LIGHTS) {
         std::vector<Light*> lights = _scene->getLights();
 
-        for (uint32 spp = 0; spp < _spp; ++spp) {
-            for (const Light* l : lights) {
-                uint32 numSamples = l->numSamples();
-                _sampler->allocArray2D(numSamples); // Light
-                _sampler->allocArray2D(numSamples); // BSDF
-            }
+        for (const Light* l : lights) {
+            if (l->isDelta())
+                continue;
+
+            uint32 numSamples = l->numSamples();
+            _sampler->allocArray2D(numSamples); // Light
+            _sampler->allocArray2D(numSamples); // BSDF
         }
     }
 
@@ -31,9 +34,14 @@ void PathTracer::initialize() {
 }
 
 void PathTracer::startRender(EndCallback endCallback) {
-    auto taskFunc = std::bind(&PathTracer::renderTile, this, _2, _1);
-    if (_useAdaptive)
-        taskFunc = std::bind(&PathTracer::renderTileAdaptive, this, _2, _1);
+    if (_progressive) {
+        startProgressive(endCallback);
+        return;
+    }
+
+    auto taskFunc = std::bind(&PathTracer::renderTile, this, _1);
+    if (_targetError > 0)
+        taskFunc = std::bind(&PathTracer::renderTileAdaptive, this, _1);
 
     // Add task for drawing tiles in parallel
     _renderTask = Threading::Workers->pushTask(
@@ -43,181 +51,191 @@ void PathTracer::startRender(EndCallback endCallback) {
     );
 }
 
-bool PathTracer::checkAdaptiveThreshold(const Color* samples, uint32 num) const {
-    for (uint32 i = num-1; i >= 1; --i) {
-        for (int32 it = i - 1; it >= 0; --it) {
-            Color diff = samples[i] - samples[it];
-            Float max = std::max(abs(diff.r), std::max(abs(diff.g), abs(diff.b)));
-            //return false;
-            if (max > 0.05) // Threshold check
-                return true;
+// Each pass is a task over all tiles, which queues the next one when it
+// ends. The render task stands for the whole job, the last pass completes
+// it by running it, so waiting on it or its end callback work as usual.
+void PathTracer::startProgressive(EndCallback endCallback) {
+    _numPasses = 0;
+    _timer = Utils::Timer();
+    _renderTask = std::make_shared<Task>([](uint32, uint32, uint32) {}, endCallback, 1);
+
+    if (_guiding)
+        _guide = std::make_unique<SDTree>(_scene->bounds());
+
+    pushPass();
+}
+
+void PathTracer::pushPass() {
+    const uint32 first = _numPasses * _passSpp;
+    const uint32 count = std::min(_passSpp, _sampler->spp() - first);
+
+    Threading::Workers->pushTask(
+        std::bind(&PathTracer::renderTilePass, this, _1, first, count),
+        uint32(_tiles.size()),
+        std::bind(&PathTracer::endPass, this)
+    );
+}
+
+// Runs on the thread that finished the last tile of the pass
+void PathTracer::endPass() {
+    _numPasses++;
+
+    Utils::Timer timer = _timer;
+    timer.stop();
+
+    const Film& film = _scene->getCamera().film();
+    const Float elapsed = timer.elapsed() / 1000.0;
+    const Float noise = film.noiseEstimate();
+    const uint32 spp = std::min(_numPasses * _passSpp, _sampler->spp());
+
+    std::cout << "Pass " << _numPasses << ": " << spp << " spp in " << elapsed << " s, noise " << noise << std::endl;
+
+    // Stop before a pass would run past the time budget, passes are
+    // assumed to take about as long as the average so far
+    bool done = spp >= _sampler->spp();
+    if (_timeBudget > 0 && elapsed * (_numPasses + 1) / _numPasses > _timeBudget)
+        done = true;
+    if (_noiseTarget > 0 && noise <= _noiseTarget)
+        done = true;
+
+    if (done) {
+        _renderTask->run(0, 0);
+        return;
+    }
+
+    // Guiding learns in iterations of doubling length, each one sampling
+    // with what the previous ones recorded. All of them reach the film.
+    if (_guide && (_numPasses & (_numPasses - 1)) == 0)
+        _guide->refine(std::max(_numPasses / 2, 1u) * _passSpp);
+
+    pushPass();
+}
+
+// Adds count samples to every pixel of a tile, converged pixels are
+// skipped in adaptive mode
+void PathTracer::renderTilePass(uint32 tileId, uint32 first, uint32 count) const {
+    const ImageTile& tile = _tiles[tileId];
+    Sampler& sampler = *tile.samp.get();
+
+    Film& film = _scene->getCamera().film();
+    FilmTile filmTile = film.tile(Point2ui(tile.x, tile.y), Vec2ui(tile.w, tile.h));
+
+    for (uint32 y = 0; y < tile.h; ++y) {
+        for (uint32 x = 0; x < tile.w; ++x) {
+            Point2ui pixel(x + tile.x, y + tile.y);
+
+            if (_targetError > 0 && film.relativeError(pixel) < _targetError)
+                continue;
+
+            sampler.start(pixel);
+            renderPixel(sampler, pixel, first, count, filmTile);
+        }
+    }
+
+    film.mergeTile(filmTile);
+
+    // The preview shows everything merged so far
+    for (uint32 y = 0; y < tile.h; ++y) {
+        for (uint32 x = 0; x < tile.w; ++x) {
+            const Pixel& px = film.pixel(Point2ui(x + tile.x, y + tile.y));
+            film.addPreviewSample(x + tile.x, y + tile.y, px.color / std::max(px.weight, (Float)1));
         }
     }
-        
-    return false;
 }
 
-Color PathTracer::subdivide(Sampler& sampler, const Point2& min, const Point2& max, std::vector<Color>& table, const Point2ui& pixel, Float weight, uint32* nSamples) const {
+// Traces count samples of a pixel from first on, the pixel must have
+// been started on the sampler
+Color PathTracer::renderPixel(Sampler& sampler, const Point2ui& pixel, uint32 first, uint32 count, FilmTile& filmTile) const {
     const Camera& camera = _scene->getCamera();
-    Color res = Color::BLACK;
-
-    const Point2 corners[4] = {
-        Point2(min.x, max.y), // Top left
-        max,                  // Top right
-        min,                  // Bottom left
-        Point2(max.x, min.y)  // Bottom right
-    };
-
-    const Float halfX = (max.x + min.x) / 2.0;
-    const Float halfY = (max.y + min.y) / 2.0;
-
-    // The 5 new samples
-    const Point2 samples[5] = {
-        Point2(halfX, max.y), // Half top
-        Point2(min.x, halfY), // Half left
-        Point2(halfX, halfY), // Center
-        Point2(max.x, halfY), // Half right
-        Point2(halfX, min.y)  // Half bottom
-    };
-
-    // Index of adjacent samples for each corner
-    const uint32 adjIdx[4][3] = {
-        { 0, 1, 2 },    // For top left corner
-        { 0, 2, 3 },    // For top right corner
-        { 1, 2, 4 },    // For bottom left corner
-        { 2, 3, 4 }     // For botoom left corner
-    };
-  
-    Color Li[5];
-
-    const uint32 w = _adaptWidth;
-    const uint32 h = _adaptHeight;
-
-    // Trace paths through the new 5 sample points
-    for (uint32 i = 0; i < 5; i++) {
-        Point2 p = Point2(samples[i].x + pixel.x,
-                          samples[i].y + pixel.y);
-        uint32 tblIdx = (samples[i].x * (w - 1)) +
-                        w * ((h - 1) * samples[i].y);
-
-        // Compute integrand evaluation
-        Ray ray = camera.primaryRay(p, samples[i]);
-        Li[i] = tracePath(ray, sampler, pixel);
-        
-        // Store in sample table
-        table[tblIdx] = Li[i];
-    }
 
-    // Iterate the 4 corners
-    for (uint32 i = 0; i < 4; i++) {
-        // Map corner to 1D array
-        uint32 tableIdx = (corners[i].x * (w - 1)) +
-                          w * ((h - 1) * corners[i].y);
+    RayBatch primary;
+    HitBatch hits;
+    Point2   pFilm[RAY_BATCH_SIZE];
+
+    Color color = Color::BLACK;
+    for (uint32 batch = first; batch < first + count; batch += RAY_BATCH_SIZE) {
+        const uint32 batchCount = std::min(RAY_BATCH_SIZE, first + count - batch);
 
-        uint32 cornerIdx[4] = {
-            (corners[i].x * (w - 1)) + w * ((h - 1) * corners[i].y),
-            (samples[adjIdx[i][0]].x * (w - 1)) + w * ((h - 1)  * samples[adjIdx[i][0]].y),
-            (samples[adjIdx[i][1]].x * (w - 1)) + w * ((h - 1)  * samples[adjIdx[i][1]].y),
-            (samples[adjIdx[i][2]].x * (w - 1)) + w * ((h - 1)  * samples[adjIdx[i][2]].y)
-        };
+        // Primary rays of a pixel are coherent, trace them together
+        primary.clear();
+        for (uint32 s = 0; s < batchCount; ++s) {
+            sampler.startSample(batch + s);
+            primary.add(camera.primaryRay(pixel, sampler, &pFilm[s]));
+        }
 
-        Color colors[4];
-        for (uint32 idx = 0; idx < 4; ++idx)
-            colors[idx] = table[cornerIdx[idx]];
+        _scene->intersectRays(primary, &hits);
 
-        bool recurse = checkAdaptiveThreshold(colors, 4);
-        
-        // If there is no need to subdivide
-        if (!recurse || weight <= 1.0 / (_adaptWidth * _adaptHeight)) {
-            // Compute average to return
-            Color avg = Color::BLACK;
-            for (uint32 s = 0; s < 4; ++s)
-                avg += colors[s];
-            avg *= weight;  // Weight according to the area they represent
-
-            res += avg / 4.0; // Add average to current estimate
-        } else {
-            // Recurse 
-            Point2 min = corners[i];
-            Point2 max = corners[i];
+        for (uint32 s = 0; s < batchCount; ++s) {
+            sampler.startSample(batch + s);
+            sampler.skip1D(camera.primaryRayDims1D());
+            sampler.skip2D(camera.primaryRayDims());
 
-            for (uint32 s = 0; s < 3; ++s) {
-                min = Math::min(min, samples[adjIdx[i][s]]);
-                max = Math::max(max, samples[adjIdx[i][s]]);
-            }
-            
-            *nSamples += 5;
-            res += subdivide(sampler, min, max, table, pixel, weight / 4.0, nSamples);
+            Color Li = tracePath(primary.rays[s], sampler, pixel, &hits.events[s]);
+
+            // Record sample on the tile, filtered around where it was taken
+            filmTile.addSample(pFilm[s], Li);
+
+            color += Li;
         }
     }
 
-    return res;
+    return color;
 }
 
-void PathTracer::renderTileAdaptive(uint32 tId, uint32 tileId) const {
+// Samples are taken in passes over the pixels of the tile still above
+// the target error, the tile is done once all of them converged
+void PathTracer::renderTileAdaptive(uint32 tileId) const {
     const ImageTile& tile = _tiles[tileId];
     Sampler& sampler = *tile.samp.get();
 
-    const uint32 w = _adaptWidth;
-    const uint32 h = _adaptHeight;
+    const Camera& camera = _scene->getCamera();
+    FilmTile filmTile = camera.film().tile(Point2ui(tile.x, tile.y), Vec2ui(tile.w, tile.h));
 
-    const Point2 pts[4] = {
-        Point2(0.0, 1.0),
-        Point2(1.0, 1.0),
-        Point2(0.0, 0.0),
-        Point2(1.0, 0.0)
-    };
+    std::vector<uint8> active(tile.w * tile.h, 1);
+    uint32 numActive = tile.w * tile.h;
 
-    // Maps of pts to 1D array
-    const uint32 tblIdx[4] = {
-        w * (h - 1), 
-        (w - 1) + w * (h - 1),
-        0,
-        (w - 1)
-    };
+    const uint32 spp = sampler.spp();
+    for (uint32 first = 0; first < spp && numActive > 0; first += ADAPTIVE_PASS_SPP) {
+        const uint32 count = std::min(ADAPTIVE_PASS_SPP, spp - first);
 
-    // Initialize 1D array for samples
-    std::vector<Color> sampleTable(w * h); 
+        for (uint32 y = 0; y < tile.h; ++y) {
+            for (uint32 x = 0; x < tile.w; ++x) {
+                if (!active[x + tile.w * y])
+                    continue;
 
-    const Camera& camera = _scene->getCamera();
-    for (uint32 y = 0; y < tile.h; ++y) {
-        for (uint32 x = 0; x < tile.w; ++x) {
-            Point2ui pixel(x + tile.x, y + tile.y);
-    
-            sampler.start(pixel);
+                Point2ui pixel(x + tile.x, y + tile.y);
 
-            Color samples[4];
-            Color sum = Color::BLACK;
-            for (uint32 i = 0; i < 4; i++) {
-                Point2 p = Point2(pixel.x + pts[i].x, pixel.y + pts[i].y);
-                Ray ray = camera.primaryRay(p, pts[i]);
-                samples[i] = tracePath(ray, sampler, pixel);
-                sum += samples[i];
-                sampleTable[tblIdx[i]] = samples[i];
-            }
-            
-            uint32 nSamples = 4;
-            Color Li = Color::BLACK;
-            if (!checkAdaptiveThreshold(&samples[0], 4)) {
-                Li = sum / 4.0;  // Just compute the average
-            } else {
-                nSamples += 5; // Compute 5 new samples
-                Li = subdivide(sampler, pts[2], pts[1], sampleTable, pixel, 1.0 / 4.0, &nSamples);
+                sampler.start(pixel);
+                renderPixel(sampler, pixel, first, count, filmTile);
+
+                // Converged pixels take no more samples
+                if (filmTile.relativeError(pixel.x, pixel.y) < _targetError) {
+                    active[x + tile.w * y] = 0;
+                    numActive--;
+                }
             }
+        }
+    }
 
-            camera.film().addColorSample(pixel.x, pixel.y, Li, nSamples);
-            camera.film().addPreviewSample(pixel.x, pixel.y, Li);
+    // Use a box filter for the preview
+    for (uint32 y = 0; y < tile.h; ++y) {
+        for (uint32 x = 0; x < tile.w; ++x) {
+            const TilePixel& px = filmTile.pixel(x + tile.x, y + tile.y);
+            camera.film().addPreviewSample(x + tile.x, y + tile.y, px.color / std::max(px.weight, (Float)1));
         }
     }
 
+    camera.film().mergeTile(filmTile);
 }
 
 // This is called by different threads
-void PathTracer::renderTile(uint32 tId, uint32 tileId) const {
+void PathTracer::renderTile(uint32 tileId) const {
     const ImageTile& tile = _tiles[tileId];
     Sampler& sampler = *tile.samp.get();
 
     const Camera& camera = _scene->getCamera();
+    FilmTile filmTile = camera.film().tile(Point2ui(tile.x, tile.y), Vec2ui(tile.w, tile.h));
+
     for (uint32 y = 0; y < tile.h; ++y) {
         for (uint32 x = 0; x < tile.w; ++x) {
             Point2ui pixel(x + tile.x, y + tile.y);
@@ -225,31 +243,29 @@ void PathTracer::renderTile(uint32 tId, uint32 tileId) const {
             sampler.start(pixel);
 
             // Iterate samples per pixel
-            Color color = Color::BLACK;
-            for (uint32 s = 0; s < sampler.spp(); ++s) {
-                sampler.startSample(s);
-
-                //pixel = Point2ui(253, 348);
-
-                const Ray ray = camera.primaryRay(pixel, sampler);
-                Color Li = tracePath(ray, sampler, pixel);
-
-                // Record sample on camera's film
-                camera.film().addColorSample(pixel.x, pixel.y, Li);
-
-                color += Li;
-            }
+            Color color = renderPixel(sampler, pixel, 0, sampler.spp(), filmTile);
 
             // Use a box filter for the preview
             color /= sampler.spp();
             camera.film().addPreviewSample(pixel.x, pixel.y, color);
         }
     }
+
+    camera.film().mergeTile(filmTile);
 }
 
 #define DEBUG(str) std::cout << str << std::endl;
 
-Color PathTracer::tracePath(const Ray& ray, Sampler& sampler, const Point2ui& pixel) const {
+// Vertex of a path whose incident radiance is recorded on the SD-tree
+struct GuideVertex {
+    DirectionalTree* tree;
+    Vec3  dir;
+    Color beta;         // Throughput up to the next vertex
+    Color Li;           // Radiance gathered before the direction was taken
+    Float pdf;
+};
+
+Color PathTracer::tracePath(const Ray& ray, Sampler& sampler, const Point2ui& pixel, const SurfaceEvent* primaryHit) const {
     Color Li = Color::BLACK;
     Ray   subPath = ray;           // Current sub-path
 
@@ -258,10 +274,20 @@ Color PathTracer::tracePath(const Ray& ray, Sampler& sampler, const Point2ui& pi
 
     const BSDF* bsdf = nullptr;
 
+    GuideVertex vertices[GUIDING_MAX_VERTICES];
+    uint32 numVertices = 0;
+
     uint32 depth = 1;
     while (depth <= _maxDepth) {
         SurfaceEvent event = SurfaceEvent();
-        bool intersect = _scene->intersectRay(subPath, &event);
+
+        bool intersect;
+        if (depth == 1 && primaryHit) {
+            event = *primaryHit;
+            intersect = event.hit();
+        } else {
+            intersect = _scene->intersectRay(subPath, &event);
+        }
 
         if (!intersect) {
             // If this was a primary ray or
@@ -297,13 +323,50 @@ Color PathTracer::tracePath(const Ray& ray, Sampler& sampler, const Point2ui& pi
         /* -----------------------------------------------------------------------------------
                 Indirect Illumination
         --------------------------------------------------------------------------------------*/
-        // Sample a direction from the BSDF
+        // Sample a direction from the BSDF, or from the learned incident
+        // radiance with one-sample MIS, which evaluates both densities
+        SDTree::Leaf* guideLeaf = nullptr;
+        Float randGuide = 0;
+        if (_guide) {
+            randGuide = sampler.next1D();
+
+            guideLeaf = &_guide->leaf(event.point);
+            if (bsdf->type() & (BSDFType::SPECULAR | BSDFType::REFRACTION))
+                guideLeaf = nullptr;
+        }
+
+        const bool guided = guideLeaf && guideLeaf->sampling.energy() > 0;
+
         BSDFSample sample(event);
-        Color f = bsdf->sample(sampler.next2D(), &sample);
+        Color f;
+        if (guided && randGuide >= GUIDING_BSDF_FRACTION) {
+            const Vec3 wi = guideLeaf->sampling.sample(sampler.next2D());
+
+            sample = BSDFSample(event, wi, Transport::RADIANCE);
+            sample.type = bsdf->type();
+
+            f = bsdf->eval(sample);
+            sample.pdf = GUIDING_BSDF_FRACTION * bsdf->evalPdf(sample) +
+                         (1 - GUIDING_BSDF_FRACTION) * guideLeaf->sampling.pdf(wi);
+
+            if (dot(event.normal, wi) * Frame::cosTheta(sample.wi) <= 0)
+                f = Color::BLACK;
+        } else {
+            f = bsdf->sample(sampler.next2D(), &sample);
+
+            if (guided && sample.pdf > 0) {
+                sample.pdf = GUIDING_BSDF_FRACTION * sample.pdf +
+                             (1 - GUIDING_BSDF_FRACTION) * guideLeaf->sampling.pdf(event.toWorld(sample.wi));
+            }
+        }
 
         // Leave if no contribution from sampled direction
-        if (sample.pdf == 0 || f.isBlack())
+        if (sample.pdf == 0 || f.isBlack()) {
+            if (guideLeaf)
+                guideLeaf->building.record(event.toWorld(sample.wi), 0);
+
             break;
+        }
 
         // If we just sampled refraction, keep track of radiance scaling
         if (hasType(sample.type, BSDFType(BSDFType::REFRACTION)))
@@ -312,6 +375,11 @@ Color PathTracer::tracePath(const Ray& ray, Sampler& sampler, const Point2ui& pi
         // Update the throughput
         beta *= f * Frame::absCosTheta(sample.wi) / sample.pdf;
 
+        if (guideLeaf && numVertices < GUIDING_MAX_VERTICES) {
+            vertices[numVertices++] = { &guideLeaf->building, event.toWorld(sample.wi),
+                                        beta, Li, sample.pdf };
+        }
+
         // Possibly end path with russian roulette
         Float rr = (refrScale * beta).max();
         if (depth > 4 && rr < 0.8) {
@@ -353,6 +421,20 @@ Color PathTracer::tracePath(const Ray& ray, Sampler& sampler, const Point2ui& pi
 
     }
 
-    return Li;
-}
+    // The radiance arriving along each direction is what the path
+    // gathered past its vertex, without the throughput up to it. Direct
+    // light is left out, as estimateDirect accounts for it.
+    for (uint32 v = 0; v < numVertices; ++v) {
+        const GuideVertex& vertex = vertices[v];
+
+        Color incident = Color::BLACK;
+        for (uint32 c = 0; c < 3; ++c) {
+            if (vertex.beta[c] > 0)
+                incident[c] = (Li[c] - vertex.Li[c]) / vertex.beta[c];
+        }
 
+        vertex.tree->record(vertex.dir, incident.lum() / vertex.pdf);
+    }
+
+    return Li;
+}
\ No newline at end of file
@@ -4,39 +4,67 @@
 #include <Renderer.h>
 #include <Spectral.h>
 #include <Integrator.h>
+#include <FilmTile.h>
+#include <Timer.h>
+#include <SDTree.h>
 
 #include <deque>
+#include <memory>
 
 namespace Photon {
 
+    // Samples per pixel of each pass of adaptive rendering, the
+    // error of a pixel is first estimated after one pass
+    static const uint32 ADAPTIVE_PASS_SPP = 16;
+
+    // Chance of sampling the BSDF instead of the learned radiance when
+    // guiding, and how many vertices of a path are recorded at most
+    static const Float  GUIDING_BSDF_FRACTION = 0.5;
+    static const uint32 GUIDING_MAX_VERTICES = 32;
+
     class PathTracer : public Integrator {
     public:
         PathTracer(const Scene& scene, uint32 spp = 256)
-            : Integrator(scene, spp), _maxDepth(8), _useAdaptive(false),
-            _adaptWidth(20), _adaptHeight(20), _spp(spp) {}
+            : Integrator(scene, spp), _maxDepth(8), _targetError(0),
+            _progressive(false), _passSpp(0), _timeBudget(0), _noiseTarget(0), _guiding(false), _numPasses(0) {}
 
-        PathTracer(const Scene& scene, RendererSettings settings)
-            : Integrator(scene) {}
+        PathTracer(const Scene& scene, const RendererSettings& settings)
+            : Integrator(scene), _maxDepth(8), _targetError(settings.adaptiveError),
+            _progressive(settings.progressive || settings.guiding), _passSpp(std::max(settings.passSpp, 1u)),
+            _timeBudget(settings.timeBudget), _noiseTarget(settings.noiseTarget), _guiding(settings.guiding),
+            _numPasses(0) {}
         
         void initialize();
         void startRender(EndCallback endCallback = EndCallback());
 
     private:
-        void renderTile(uint32 tId, uint32 tileId) const;
-        void renderTileAdaptive(uint32 tId, uint32 tileId) const;
+        void renderTile(uint32 tileId) const;
+        void renderTileAdaptive(uint32 tileId) const;
 
-        Color tracePath(const Ray& ray, Sampler& sampler, const Point2ui& pixel = Point2ui(0)) const;
+        // Progressive rendering, in passes adding samples to every tile
+        void startProgressive(EndCallback endCallback);
+        void pushPass();
+        void endPass();
+        void renderTilePass(uint32 tileId, uint32 first, uint32 count) const;
 
-        Color subdivide(Sampler& sampler, const Point2& min, const Point2& max, 
-                        std::vector<Color>& table, const Point2ui& pixel, Float weight, uint32* nSamples) const;
+        Color renderPixel(Sampler& sampler, const Point2ui& pixel, uint32 first, uint32 count, FilmTile& filmTile) const;
 
-        bool checkAdaptiveThreshold(const Color* samples, uint32 num) const;
+        // If given, primaryHit is the already traced first hit of ray
+        Color tracePath(const Ray& ray, Sampler& sampler, const Point2ui& pixel = Point2ui(0),
+                        const SurfaceEvent* primaryHit = nullptr) const;
 
-        uint32 _spp;
         uint32 _maxDepth;
-        uint32 _adaptWidth;
-        uint32 _adaptHeight;
-        bool _useAdaptive;
+        Float  _targetError;    // Relative error where pixels stop, zero samples them all
+
+        bool   _progressive;
+        uint32 _passSpp;
+        Float  _timeBudget;     // Seconds, zero for none
+        Float  _noiseTarget;    // Mean relative error of the film, zero for none
+        bool   _guiding;        // Learns the incident radiance over the passes, which must be progressive
+        uint32 _numPasses;
+        Utils::Timer _timer;
+
+        std::unique_ptr<SDTree> _guide;
     };
 
 }
\ No newline at end of file
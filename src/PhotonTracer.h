@@ -43,4 +43,13 @@
 #define PHOTON_CONSTEXPR const
 #else
 #define PHOTON_CONSTEXPR constexpr
+#endif
+
+// Instruction set used by the SIMD kernels, define
+// PHOTON_NO_SIMD to force their scalar versions
+#if !defined(PHOTON_NO_SIMD) && defined(__AVX__)
+#define PHOTON_AVX
+#define PHOTON_SSE
+#elif !defined(PHOTON_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define PHOTON_SSE
 #endif
\ No newline at end of file
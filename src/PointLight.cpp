@@ -1,5 +1,7 @@
 #include <PointLight.h>
 
+#include <LightTree.h>
+
 using namespace Photon;
 
 bool PointLight::isDelta() const {
@@ -10,6 +12,12 @@ Color PointLight::power() const {
     return _Le * 4 * PI;
 }
 
+// Emits in every direction from its position
+bool PointLight::lightBounds(LightBounds* bounds) const {
+    *bounds = LightBounds(Bounds3(_pos), Vec3(0, 0, 1), -1, 0, power().lum());
+    return true;
+}
+
 Color PointLight::evalL(const SurfaceEvent& it, const Vec3& wo) const {
     return Color::BLACK;
 }
@@ -0,0 +1,54 @@
+#include <Primitive.h>
+
+#include <Threading.h>
+
+using namespace Photon;
+
+// Meshes with fewer faces than this are gathered serially
+static const uint32 PARALLEL_GATHER_FACES = 64 * 1024;
+
+Bounds3 Primitive::bbox() const {
+    if (!isFace())
+        return shape->bbox();
+
+    const Point3 v1 = v0 + e1;
+    const Point3 v2 = v0 + e2;
+
+    Point3 max = Math::max(v0, Math::max(v1, v2));
+    Point3 min = Math::min(v0, Math::min(v1, v2));
+
+    Bounds3 box = Bounds3(min, max);
+    box.expand(F_EPSILON);
+
+    return box;
+}
+
+void Photon::gatherPrimitives(const std::vector<std::shared_ptr<Shape>>& shapes, std::vector<Primitive>* prims) {
+    // Find where the primitives of each shape start
+    std::vector<uint32> offsets(shapes.size() + 1, 0);
+    for (uint32 s = 0; s < shapes.size(); ++s) {
+        const TriMesh* mesh = shapes[s]->triMesh();
+        offsets[s + 1] = offsets[s] + (mesh ? mesh->numFaces() : 1);
+    }
+
+    prims->resize(offsets[shapes.size()]);
+
+    for (uint32 s = 0; s < shapes.size(); ++s) {
+        const TriMesh* mesh = shapes[s]->triMesh();
+        if (!mesh) {
+            (*prims)[offsets[s]] = { Point3(0), Vec3(0), Vec3(0), shapes[s].get(), PRIM_NOT_FACE };
+            continue;
+        }
+
+        uint32 numFaces = mesh->numFaces();
+        uint32 numPartitions = numFaces < PARALLEL_GATHER_FACES ? 1 : Threading::Workers->numThreads() * 4;
+
+        Primitive* meshPrims = &(*prims)[offsets[s]];
+        Threading::parallelFor(0, numFaces, numPartitions, [&](uint32 f) {
+            const MeshFace idx = mesh->face(f);
+            const Point3 V0 = mesh->vertex(idx[0]);
+
+            meshPrims[f] = { V0, mesh->vertex(idx[1]) - V0, mesh->vertex(idx[2]) - V0, mesh, f };
+        });
+    }
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include <Bounds.h>
+#include <Ray.h>
+#include <Shape.h>
+#include <TriMesh.h>
+
+namespace Photon {
+
+    static const uint32 PRIM_NOT_FACE = 0xFFFFFFFF;
+
+    // Element stored by the accelerators, either a mesh face with its
+    // edges precomputed, intersected without a virtual call, or any
+    // other shape, intersected through its own interface
+    struct Primitive {
+        Point3 v0;
+        Vec3   e1;
+        Vec3   e2;
+        const Shape* shape;
+        uint32 face;            // Face index into the mesh, PRIM_NOT_FACE otherwise
+
+        bool isFace() const {
+            return face != PRIM_NOT_FACE;
+        }
+
+        Bounds3 bbox() const;
+
+        inline bool intersectRay(const Ray& ray, SurfaceEvent* evt) const;
+        inline bool isOccluded(const Ray& ray) const;
+    };
+
+    // Turns the shapes into primitives, meshes contribute one per face
+    void gatherPrimitives(const std::vector<std::shared_ptr<Shape>>& shapes, std::vector<Primitive>* prims);
+
+    inline bool Primitive::intersectRay(const Ray& ray, SurfaceEvent* evt) const {
+        if (!isFace())
+            return shape->intersectRay(ray, evt);
+
+        Float t, u, v;
+        if (!intersectTriangle(ray, v0, e1, e2, &t, &u, &v))
+            return false;
+
+        ray.setMaxT(t);
+        evt->obj    = shape;
+        evt->primId = face;
+        evt->point  = v0 + u * e1 + v * e2;
+        evt->normal = normalize(Normal(cross(e1, e2)));
+
+        // Save the (u, v) barycentric coordinates for later
+        evt->uv = Point2(u, v);
+
+        return true;
+    }
+
+    inline bool Primitive::isOccluded(const Ray& ray) const {
+        if (!isFace())
+            return shape->isOccluded(ray);
+
+        Float t, u, v;
+        return intersectTriangle(ray, v0, e1, e2, &t, &u, &v);
+    }
+
+}
\ No newline at end of file
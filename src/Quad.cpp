@@ -31,6 +31,7 @@ bool Quad::intersectRay(const Ray& ray, SurfaceEvent* evt) const {
 
     ray.setMaxT(t);
     evt->obj = this;
+    evt->primId = 0;
     evt->uv = uv;
 
     if (-dz < 0)
@@ -80,6 +81,11 @@ Float Quad::area() const {
     return _area;
 }
 
+void Quad::normalCone(Vec3* axis, Float* cosTheta) const {
+    *axis     = Vec3(normalize(_objToWorld(Normal(0, 0, 1))));
+    *cosTheta = 1;
+}
+
 void Quad::samplePosition(const Point2& rand, PositionSample* sample) const {
     const Point3 quad = Point3(rand.x - 0.5, rand.y - 0.5, 0);
 
@@ -16,6 +16,8 @@ namespace Photon {
         Bounds3 bbox() const;
         Float area() const;
 
+        void normalCone(Vec3* axis, Float* cosTheta) const;
+
         void samplePosition(const Point2& rand, PositionSample* sample) const;
         Float pdfPosition(const PositionSample& sample) const;
 
@@ -5,7 +5,42 @@ using namespace Photon;
 using namespace Photon::Math;
 
 Quat::Quat(const Transform& transform) {
-
+    const Mat4& m = transform.matrix();
+
+    Float trace = m.m[0][0] + m.m[1][1] + m.m[2][2];
+    if (trace > 0) {
+        Float s = std::sqrt(trace + 1.0);
+        w = 0.5 * s;
+        s = 0.5 / s;
+
+        vec.x = (m.m[2][1] - m.m[1][2]) * s;
+        vec.y = (m.m[0][2] - m.m[2][0]) * s;
+        vec.z = (m.m[1][0] - m.m[0][1]) * s;
+    } else {
+        // Start from the largest diagonal element to stay accurate
+        const uint32 next[3] = { 1, 2, 0 };
+        Float q[3];
+
+        uint32 i = 0;
+        if (m.m[1][1] > m.m[0][0])
+            i = 1;
+        if (m.m[2][2] > m.m[i][i])
+            i = 2;
+
+        uint32 j = next[i];
+        uint32 k = next[j];
+
+        Float s = std::sqrt((m.m[i][i] - (m.m[j][j] + m.m[k][k])) + 1.0);
+        q[i] = 0.5 * s;
+        if (s != 0)
+            s = 0.5 / s;
+
+        w    = (m.m[k][j] - m.m[j][k]) * s;
+        q[j] = (m.m[j][i] + m.m[i][j]) * s;
+        q[k] = (m.m[k][i] + m.m[i][k]) * s;
+
+        vec = Vec3(q[0], q[1], q[2]);
+    }
 }
 
 Quat Quat::operator+(const Quat& quat) const {
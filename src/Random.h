@@ -16,6 +16,17 @@ namespace Photon {
     static const Float ONE_MINUS_EPSILON = F_ONE_MINUS_EPSILON;
 #endif
 
+    // Scrambles the bits of a seed, neighbouring seeds would otherwise
+    // start out correlated sequences
+    inline uint64 mixBits(uint64 v) {
+        v ^= v >> 31;
+        v *= 0x7fb5d329728ea185ull;
+        v ^= v >> 27;
+        v *= 0x81dadef4bc2dd44dull;
+        v ^= v >> 33;
+        return v;
+    }
+
     class RandGen {
     public:
         RandGen(uint64 seq = 0);
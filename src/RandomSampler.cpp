@@ -13,14 +13,7 @@ void RandomSampler::start(const Point2ui& pixel) {
 
 void RandomSampler::startSample(uint32 sample) {
     _currSample = sample;
-}
-
-void RandomSampler::allocArray1D(uint32 numSamples) {
-
-}
-
-void RandomSampler::allocArray2D(uint32 numSamples) {
-
+    resetArrays();
 }
 
 void RandomSampler::allocArray1D(std::vector<Float>& arr, uint32 numSamples) const {
@@ -48,16 +41,18 @@ void RandomSampler::nextND(uint32 N, std::vector<Float>& arr) const {
         arr[n] = _rng.uniform1D();
 }
 
-const Float*  RandomSampler::next1DArray(uint32 numSamples) {
-    return nullptr;
+void RandomSampler::fillArray1D(uint32, uint32 numSamples, Float* arr) {
+    for (uint32 s = 0; s < numSamples; ++s)
+        arr[s] = _rng.uniform1D();
 }
 
-const Point2* RandomSampler::next2DArray(uint32 numSamples) {
-    return nullptr;
+void RandomSampler::fillArray2D(uint32, uint32 numSamples, Point2* arr) {
+    for (uint32 s = 0; s < numSamples; ++s)
+        arr[s] = _rng.uniform2D();
 }
 
 std::unique_ptr<Sampler> RandomSampler::copy(uint32 seed) const {
     std::unique_ptr<Sampler> samp = std::make_unique<RandomSampler>(*this);
     samp->setSeq(seed);
     return std::move(samp);
-}
+}
\ No newline at end of file
@@ -11,9 +11,6 @@ namespace Photon {
         void start(const Point2ui& pixel);
         void startSample(uint32 sample);
 
-        void allocArray1D(uint32 numSamples);
-        void allocArray2D(uint32 numSamples);
-
         void allocArray1D(std::vector<Float>& arr, uint32 numSamples) const;
         void allocArray2D(std::vector<Point2>& arr, uint32 numSamples) const;
 
@@ -21,10 +18,11 @@ namespace Photon {
         Point2 next2D();
         void nextND(uint32 N, std::vector<Float>& arr) const;
 
-        const Float*  next1DArray(uint32 numSamples);
-        const Point2* next2DArray(uint32 numSamples);
-
         std::unique_ptr<Sampler> copy(uint32 seed) const;
+
+    protected:
+        void fillArray1D(uint32 index, uint32 numSamples, Float* arr);
+        void fillArray2D(uint32 index, uint32 numSamples, Point2* arr);
     };
 
 }
\ No newline at end of file
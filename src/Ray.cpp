@@ -16,7 +16,7 @@ Ray::Ray(const Point3& origin, const Vec3& direction, Float minT, Float maxT)
     : _origin(origin), _dir(direction), _time(0), _minT(minT), _maxT(maxT), _isPrimary(false) {}
 
 Ray::Ray(const Point3& origin, const Point3& target)
-    : _origin(origin), _minT(F_RAY_OFFSET), _isPrimary(false) {
+    : _origin(origin), _minT(F_RAY_OFFSET), _isPrimary(false), _time(0) {
 
     _dir = normalize(target - origin);
     _maxT = arg(target);
@@ -83,24 +83,35 @@ Point3 Ray::operator()(Float t) const {
 ---------------------------------------------------------*/
 
 RayEvent::RayEvent(const Ray& ray)
-    : point(ray.hitPoint()), wo(-ray.dir()), normal(0) {}
+    : point(ray.hitPoint()), wo(-ray.dir()), normal(0), time(ray.time()) {}
 
 RayEvent::RayEvent(const Point3& point, const Normal& n)
-    : point(point), normal(n) {}
+    : point(point), normal(n), time(0) {}
 
 RayEvent::RayEvent(const Point3& point, const Normal& n, const Vec3& wo)
-    : point(point), normal(n), wo(wo) {}
+    : point(point), normal(n), wo(wo), time(0) {}
 
+// Spawned rays keep the time of the event, so moving shapes
+// are seen at the same instant along the whole path
 Ray RayEvent::spawnRay(const Point3& target) const {
-    return Ray(point, target);
+    Ray ray(point, target);
+    ray.setTime(time);
+
+    return ray;
 }
 
 Ray RayEvent::spawnRay(const Vec3& dir) const {
-    return Ray(point, dir);
+    Ray ray(point, dir);
+    ray.setTime(time);
+
+    return ray;
 }
 
 Ray RayEvent::spawnRay(const Vec3& dir, Float dist) const {
-    return Ray(point, dir, F_RAY_OFFSET, dist - F_EPSILON);
+    Ray ray(point, dir, F_RAY_OFFSET, dist - F_EPSILON);
+    ray.setTime(time);
+
+    return ray;
 }
 
 /* ----------------------------------------------------------
@@ -108,6 +119,7 @@ Ray RayEvent::spawnRay(const Vec3& dir, Float dist) const {
 ---------------------------------------------------------*/
 void SurfaceEvent::setEvent(const Ray& ray, Shape const* shape, const Normal& n) {
     obj    = shape;
+    primId = 0;
     point  = ray.hitPoint();
     normal = normalize(n);
     gFrame = Frame(normal); 
@@ -57,8 +57,9 @@ namespace Photon {
         Point3 point;
         Normal normal;
         Vec3   wo;
+        Float  time;     // Shutter time of the ray that found the event
         
-        RayEvent() : point(0), normal(0), wo(0) { }
+        RayEvent() : point(0), normal(0), wo(0), time(0) { }
         RayEvent(const Ray& ray);
         RayEvent(const Point3& point, const Normal& normal);
         RayEvent(const Point3& point, const Normal& normal, const Vec3& wo);
@@ -72,16 +73,17 @@ namespace Photon {
     class SurfaceEvent : public RayEvent {
     public:
         const Shape* obj;
+        uint32 primId;      // Face of the hit, for shapes made of several
         Point2 uv;
         Frame  gFrame;
         Frame  sFrame;
         bool   backface;
 
         SurfaceEvent() 
-            : RayEvent(), obj(nullptr), backface(false) { }
+            : RayEvent(), obj(nullptr), primId(0), backface(false) { }
 
         SurfaceEvent(const Ray& ray, Shape const* obj) 
-            : RayEvent(ray), obj(obj), backface(false) { }
+            : RayEvent(ray), obj(obj), primId(0), backface(false) { }
 
         bool hit() const;
         void setEvent(const Ray& ray, Shape const* obj, const Normal& normal);                 
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Ray.h>
+
+namespace Photon {
+
+    // Rays per batch, one bit of a uint32 mask each
+    static const uint32 RAY_BATCH_SIZE = 16;
+
+    // Coherent rays traced together, such as the camera rays of a pixel
+    // or the shadow rays leaving a shading point
+    struct RayBatch {
+        Ray    rays[RAY_BATCH_SIZE];
+        uint32 size;
+
+        RayBatch() : size(0) { }
+
+        void add(const Ray& ray) {
+            rays[size++] = ray;
+        }
+
+        bool full() const {
+            return size == RAY_BATCH_SIZE;
+        }
+
+        void clear() {
+            size = 0;
+        }
+    };
+
+    // Closest hits of a batch, bit i of hitMask is set if ray i hit
+    struct HitBatch {
+        SurfaceEvent events[RAY_BATCH_SIZE];
+        uint32       hitMask;
+
+        HitBatch() : hitMask(0) { }
+
+        bool hit(uint32 idx) const {
+            return (hitMask & (1u << idx)) != 0;
+        }
+    };
+
+}
\ No newline at end of file
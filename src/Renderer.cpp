@@ -1,6 +1,9 @@
 #include <Renderer.h>
 
 #include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
 
 #include <Vector.h>
 #include <Scene.h>
@@ -9,7 +12,10 @@
 #include <Integrator.h>
 #include <WhittedRayTracer.h>
 #include <PathTracer.h>
+#include <WavefrontPathTracer.h>
 #include <BDPT.h>
+#include <Timer.h>
+#include <PageCache.h>
 
 #include <json\json.hpp>
 #include <FreeImage.h>
@@ -18,24 +24,96 @@ using namespace Photon;
 
 using json = nlohmann::json;
 
+// Paging activity of the geometry since the last report
+static void reportPaging() {
+    Utils::PageCache& cache = Utils::PageCache::get();
+    if (!cache.enabled())
+        return;
+
+    std::cout << "Geometry: " << cache.pageIns() << " page-ins, " << cache.evictions() << " evictions, "
+              << cache.residentBytes() / (1024 * 1024) << " of " << cache.budget() / (1024 * 1024)
+              << " MB resident" << std::endl;
+
+    cache.resetCounters();
+}
+
 void Renderer::initialize() {
     
 }
 
+std::shared_ptr<Integrator> Renderer::createIntegrator(const Scene& scene) const {
+    std::shared_ptr<Integrator> integrator;
+    if (_settings.integrator == "wavefront")
+        integrator = std::make_shared<WavefrontPathTracer>(scene);
+    else
+        integrator = std::make_shared<PathTracer>(scene, _settings); // or <BidirPathTracer>
+
+    integrator->setSampler(createSampler());
+    return integrator;
+}
+
+std::unique_ptr<Sampler> Renderer::createSampler() const {
+    const uint32 spp = std::max(_settings.spp, 1u);
+
+    if (_settings.sampler == "sobol")
+        return std::make_unique<SobolSampler>(spp);
+    if (_settings.sampler == "random")
+        return std::make_unique<RandomSampler>(spp, 0);
+
+    const uint32 side = std::max((uint32)std::sqrt((Float)spp), 1u);
+    return std::make_unique<StratifiedSampler>(side, side, 8);
+}
+
 void Renderer::renderScene(const std::shared_ptr<Scene>& scene) {
     _scene = scene;
-    _integrator = std::make_shared<PathTracer>(*scene); // or <BidirPathTracer>
+    _integrator = createIntegrator(*scene);
     
-    // Export file as an end callback after rendering
-    std::function<void()> endCallback = EndCallback();
-    if (_settings.exportFile)
-        endCallback = [this]() { this->exportImage(); };
+    // Report paging and export file as an end callback after rendering
+    const bool exportFile = _settings.exportFile;
+    std::function<void()> endCallback = [this, exportFile]() {
+        reportPaging();
+
+        if (exportFile)
+            this->exportImage();
+    };
 
     // Init and start render
     _integrator->initialize();
     _integrator->startRender(endCallback);
 }
 
+void Renderer::renderSequence(const std::shared_ptr<Scene>& scene) {
+    _scene = scene;
+    Film& film = scene->getCamera().film();
+
+    const uint32 numFrames = std::max(_settings.frames, 1u);
+    for (uint32 frame = 0; frame < numFrames; ++frame) {
+        Utils::Timer timer;
+
+        // Each frame shows its own slice of the animation
+        scene->setFrame(Float(frame) / numFrames, Float(frame + 1) / numFrames);
+        scene->updateRender();
+        film.clear();
+
+        Utils::PageCache::get().resetCounters();
+
+        _integrator = createIntegrator(*scene);
+        _integrator->initialize();
+        _integrator->startRender();
+        _integrator->waitForCompletion();
+
+        timer.stop();
+        std::cout << "Frame " << frame + 1 << "/" << numFrames << " in " << timer.elapsed() / 1000.0 << " s" << std::endl;
+        reportPaging();
+
+        // There is no window to show a sequence in, frames are always saved
+        // under the export name, numbered
+        std::ostringstream name;
+        name << _settings.outFileName << "_" << std::setw(4) << std::setfill('0') << frame;
+        film.exportImage(BufferType::COLOR, name.str(), _settings.outFormat);
+    }
+}
+
 void Renderer::waitForCompletion() {
     _integrator->waitForCompletion();
 }
@@ -58,6 +136,22 @@ void Renderer::initDefaultSettings() {
     _settings.exportFile  = false;
     _settings.outFileName = "out";
     _settings.outFormat   = "tiff";
+    _settings.accelerator = "bvh";
+    _settings.integrator  = "path";
+    _settings.lightStrategy = "tree";
+    _settings.sampler     = "stratified";
+    _settings.filter      = "box";
+    _settings.spp         = 64;
+    _settings.adaptiveError = 0;
+    _settings.progressive = false;
+    _settings.passSpp     = 4;
+    _settings.timeBudget  = 0;
+    _settings.noiseTarget = 0;
+    _settings.guiding     = false;
+    _settings.frames      = 1;
+    _settings.sceneCache  = true;
+    _settings.compressMeshes = false;
+    _settings.geometryBudget = 0;
 }
 
 void Renderer::loadSettingsFile(const std::string& settingsFilePath) {
@@ -71,7 +165,23 @@ void Renderer::loadSettingsFile(const std::string& settingsFilePath) {
             settings["renderToScreen"].get<bool>(),
             settings["exportFile"].get<bool>(),
             settings["exportFilename"].get<std::string>(),
-            settings["exportFormat"].get<std::string>()
+            settings["exportFormat"].get<std::string>(),
+            settings.value("accelerator", _settings.accelerator),
+            settings.value("integrator", _settings.integrator),
+            settings.value("lightStrategy", _settings.lightStrategy),
+            settings.value("sampler", _settings.sampler),
+            settings.value("filter", _settings.filter),
+            settings.value("spp", _settings.spp),
+            settings.value("adaptiveError", _settings.adaptiveError),
+            settings.value("progressive", _settings.progressive),
+            settings.value("passSpp", _settings.passSpp),
+            settings.value("timeBudget", _settings.timeBudget),
+            settings.value("noiseTarget", _settings.noiseTarget),
+            settings.value("guiding", _settings.guiding),
+            settings.value("frames", _settings.frames),
+            settings.value("sceneCache", _settings.sceneCache),
+            settings.value("compressMeshes", _settings.compressMeshes),
+            settings.value("geometryBudget", _settings.geometryBudget)
         };
 
         _settings = tmpSettings;
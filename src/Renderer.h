@@ -6,12 +6,29 @@ namespace Photon {
 
     class Scene;
     class Integrator;
+    class Sampler;
 
     struct RendererSettings {
         bool renderToScreen;
         bool exportFile;
         std::string outFileName;
         std::string outFormat;
+        std::string accelerator;
+        std::string integrator;     // "path" or "wavefront"
+        std::string lightStrategy;  // "all", "uniform", "power" or "tree"
+        std::string sampler;        // "stratified", "sobol" or "random"
+        std::string filter;         // Pixel reconstruction filter, "box" or "gaussian"
+        uint32 spp;                 // Samples per pixel, rounded down to a square when stratified
+        Float adaptiveError;        // Relative error where pixels stop taking samples, zero disables
+        bool progressive;           // Render in passes adding passSpp to every tile until a budget is met
+        uint32 passSpp;
+        Float timeBudget;           // Seconds of a progressive render, zero for no limit
+        Float noiseTarget;          // Mean relative error ending a progressive render, zero for none
+        bool guiding;               // Learn where light comes from over the passes to guide paths, renders progressively
+        uint32 frames;              // Frames of the animation, rendered as a sequence if more than one
+        bool sceneCache;            // Compile meshes and structures for faster startups
+        bool compressMeshes;        // Quantize mesh attributes to fit larger scenes in memory
+        uint32 geometryBudget;      // MB of cached geometry kept in memory, zero for no limit
     };
 
     class Renderer {
@@ -25,12 +42,19 @@ namespace Photon {
 
         void initialize();
         void renderScene(const std::shared_ptr<Scene>& scene);
+
+        // Renders and exports every frame in turn, the scene and its
+        // structures are updated between frames rather than rebuilt
+        void renderSequence(const std::shared_ptr<Scene>& scene);
         bool hasCompleted();
         void waitForCompletion();
         const RendererSettings& settings();
         void exportImage();
 
     private:    
+        std::shared_ptr<Integrator> createIntegrator(const Scene& scene) const;
+        std::unique_ptr<Sampler> createSampler() const;
+
         void initDefaultSettings();
         void loadSettingsFile(const std::string& settingsFilePath);
 
@@ -1,15 +1,67 @@
 #include <Resources.h>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-
 #include <TriMesh.h>
+#include <ObjParser.h>
+#include <BVH.h>
 #include <Utils.h>
+#include <SceneCache.h>
+#include <PageCache.h>
+
+#include <iostream>
 
 #pragma warning(disable : 4267)  // size_t to unsigned int
 
 using namespace Photon;
 
+// Sizes of a cached mesh, its buffers follow in a chunk of their own
+struct MeshCacheInfo {
+    uint32 numFaces;
+    uint32 numVerts;
+    uint32 attributes;
+    uint32 pad;
+};
+
+static std::shared_ptr<TriMesh> readMeshCache(const std::string& path, uint64 key) {
+    std::shared_ptr<Utils::CacheFile> file = Utils::CacheFile::open(path, key);
+    if (!file)
+        return nullptr;
+
+    size_t infoSize, buffersSize;
+    const MeshCacheInfo* info = (const MeshCacheInfo*)file->chunk(Utils::CACHE_MESH, &infoSize);
+    uint8* buffers = file->chunk(Utils::CACHE_MESH_BUFFERS, &buffersSize);
+
+    if (!info || !buffers || infoSize != sizeof(MeshCacheInfo) ||
+        buffersSize != TriMesh::bufferSize(info->numFaces, info->numVerts, info->attributes))
+        return nullptr;
+
+    // The buffers stay in the mapping, which the mesh keeps alive
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(info->numFaces, info->numVerts, info->attributes,
+                                                              buffers, file, nullptr, Transform());
+    mesh->setPageable();
+
+    return mesh;
+}
+
+static void writeMeshCache(const TriMesh& mesh, const std::string& path, uint64 key) {
+    const MeshCacheInfo info = { mesh.numFaces(), mesh.numVertices(), mesh.attributes(), 0 };
+
+    Utils::CacheWriter writer(key);
+    writer.addChunk(Utils::CACHE_MESH, &info, sizeof(MeshCacheInfo));
+    writer.addChunk(Utils::CACHE_MESH_BUFFERS, mesh.buffers(),
+                    TriMesh::bufferSize(info.numFaces, info.numVerts, info.attributes));
+
+    // A missing cache only costs the next run a parse
+    writer.write(path);
+}
+
+Resources::Resources()
+    : _cacheEnabled(false), _compressMeshes(false) {
+
+    // Paged meshes and trees release their regions on destruction,
+    // so the page cache must be created first to outlive them
+    Utils::PageCache::get();
+}
+
 std::shared_ptr<Transform> Resources::addTransform(const Transform& transform) {
     std::shared_ptr<Transform> tr = std::make_shared<Transform>(transform);
     
@@ -18,92 +70,143 @@ std::shared_ptr<Transform> Resources::addTransform(const Transform& transform) {
     return tr;
 }
 
-std::shared_ptr<TriMesh> Resources::loadObj(const std::string& path, const std::string& name) {
+std::shared_ptr<BVH> Resources::meshAccelerator(const std::string& name) {
+    auto it = _meshAccelMap.find(name);
+    if (it != _meshAccelMap.end())
+        return it->second;
+
+    auto mesh = _meshMap.find(name);
+    if (mesh == _meshMap.end())
+        Utils::throwError("Mesh " + name + " was not loaded.");
+
+    std::vector<std::shared_ptr<Shape>> shapes = { mesh->second };
+    std::shared_ptr<BVH> bvh = std::make_shared<BVH>(shapes);
 
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string err;
+    _meshAccelMap.insert(std::make_pair(name, bvh));
 
-    std::string filePath(path);
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filePath.c_str());
+    return bvh;
+}
+
+void Resources::buildMeshAccelerators() {
+    // Each build is parallel on its own, skip those already up to date
+    for (auto& accel : _meshAccelMap) {
+        const uint32 version = _meshMap[accel.first]->version();
+
+        if (accel.second->numNodes() == 0) {
+            buildMeshAccelerator(accel.first, *accel.second);
+        } else if (_meshAccelVersions[accel.first] != version) {
+            accel.second->refit();
+            if (accel.second->degradation() > ACCEL_REBUILD_DEGRADATION)
+                accel.second->initialize();
+        }
 
-    if (!ret)
-        Utils::throwError("There was an error loading model: " + path + ".");
+        _meshAccelVersions[accel.first] = version;
+    }
+}
 
-    if (shapes.size() > 1)
-        Utils::throwError("More than one model in an obj file.");
+void Resources::buildMeshAccelerator(const std::string& name, BVH& bvh) {
+    const MeshSource& source = _meshSources[name];
 
-    uint32 numIndices = shapes[0].mesh.indices.size();
-    uint32 numVerts   = numIndices;
-    uint32 numFaces   = 0;
+    // Trees are cached for the meshes as loaded, not once deformed
+    const bool cached = _cacheEnabled && _meshMap[name]->version() == 0;
+    const std::string path = source.path + Utils::BVH_CACHE_EXT;
 
-    std::vector<uint32> indices;
-    indices.reserve(numIndices);
+    // Trees of paged scenes are read in place
+    const bool paged = Utils::PageCache::get().enabled();
 
-    std::unique_ptr<Point3[]> verts = std::make_unique<Point3[]>(numVerts);
+    if (cached) {
+        std::shared_ptr<Utils::CacheFile> file = Utils::CacheFile::open(path, source.key);
+        if (file && (paged ? bvh.mapCache(file) : bvh.readCache(*file)))
+            return;
+    }
 
-    std::unique_ptr<Normal[]> norms = nullptr;
-    if (attrib.normals.size() > 0)
-        norms = std::make_unique<Normal[]>(numVerts);
+    bvh.initialize();
 
-    std::unique_ptr<Point2[]> uvs = nullptr;
-    if (attrib.texcoords.size() > 0)
-        uvs = std::make_unique<Point2[]>(numVerts);
+    if (cached) {
+        Utils::CacheWriter writer(source.key);
+        bvh.writeCache(writer);
 
-    // Loop over shapes
-    for (size_t s = 0; s < shapes.size(); s++) {
+        // The tree just built is swapped for its mapping
+        if (writer.write(path) && paged) {
+            std::shared_ptr<Utils::CacheFile> file = Utils::CacheFile::open(path, source.key);
+            if (file)
+                bvh.mapCache(file);
+        }
+    }
+}
 
-        // Loop over faces(polygon)
-        size_t index_offset = 0;
-        for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-            int fv = shapes[s].mesh.num_face_vertices[f];
+void Resources::setCacheEnabled(bool enabled) {
+    _cacheEnabled = enabled;
+}
 
-            // Loop over vertices in the face.
-            for (int v = 0; v < fv; v++) {
-                // Access to vertex
-                tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-                uint32 vertIdx = 3 * idx.vertex_index;
-                verts[3*f + v].x = attrib.vertices[vertIdx];
-                verts[3*f + v].y = attrib.vertices[vertIdx + 1];
-                verts[3*f + v].z = attrib.vertices[vertIdx + 2];
+bool Resources::cacheEnabled() const {
+    return _cacheEnabled;
+}
 
-                if (attrib.normals.size() > 0) {
-                    uint32 normIdx = 3 * idx.normal_index;
+void Resources::setMeshCompression(bool enabled) {
+    _compressMeshes = enabled;
+}
 
-                    norms[3 * f + v].x = attrib.normals[normIdx];
-                    norms[3 * f + v].y = attrib.normals[normIdx + 1];
-                    norms[3 * f + v].z = attrib.normals[normIdx + 2];
+bool Resources::meshCompression() const {
+    return _compressMeshes;
+}
 
-                    norms[3 * f + v].normalize();
-                }
+uint64 Resources::contentKey() const {
+    uint64 key = 0;
+    for (const auto& source : _meshSources)
+        key += source.second.key;
 
-                if (attrib.texcoords.size() > 0) {
-                    uint32 uvIdx = 2 * idx.texcoord_index;
+    return key;
+}
 
-                    uvs[2 * f + v].x = attrib.texcoords[uvIdx];
-                    uvs[2 * f + v].y = attrib.texcoords[uvIdx + 1];
-                }
+std::shared_ptr<TriMesh> Resources::loadObj(const std::string& path, const std::string& name) {
+    auto it = _meshMap.find(name);
+    if (it != _meshMap.end())
+        return it->second;
+
+    // Meshes compiled from the same file are mapped instead of parsed
+    std::shared_ptr<TriMesh> mesh = nullptr;
+    uint64 key = 0;
+    if (_cacheEnabled) {
+        Utils::MappedFile file(path);
+        if (!file.isOpen())
+            Utils::throwError("There was an error loading model: " + path + ".");
+
+        // Compressed meshes are cached apart from full precision ones
+        key = Utils::hashBytes(file.data(), file.size());
+        if (_compressMeshes)
+            key = Utils::hashCombine(key, MESH_COMPRESSED);
+
+        mesh = readMeshCache(path + Utils::MESH_CACHE_EXT, key);
+    }
 
-                indices.push_back(3*f + v);
-            }
+    if (!mesh) {
+        mesh = Utils::ObjParser::fromFile(path);
 
-            ++numFaces;
+        if (_compressMeshes) {
+            size_t size = TriMesh::bufferSize(mesh->numFaces(), mesh->numVertices(), mesh->attributes());
+            mesh->compress();
+            size_t compressedSize = TriMesh::bufferSize(mesh->numFaces(), mesh->numVertices(), mesh->attributes());
 
-            // Offset indexes
-            index_offset += fv;
+            std::cout << "Mesh: " << name << " compressed from " << size / 1024 << " KB to "
+                      << compressedSize / 1024 << " KB" << std::endl;
+        }
 
-            // Per-face material
-            shapes[s].mesh.material_ids[f];
+        if (_cacheEnabled) {
+            writeMeshCache(*mesh, path + Utils::MESH_CACHE_EXT, key);
 
+            // Paged meshes live in the file they were just written to
+            if (Utils::PageCache::get().enabled()) {
+                std::shared_ptr<TriMesh> mapped = readMeshCache(path + Utils::MESH_CACHE_EXT, key);
+                if (mapped)
+                    mesh = mapped;
+            }
         }
     }
 
-    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(numFaces, numVerts, &indices[0],
-                                                              verts.get(), norms.get(), nullptr, uvs.get(), nullptr, Transform());
-
     // Insert mesh into the resource map
     _meshMap.insert(std::make_pair(name, mesh));
+    _meshSources[name] = { path, key };
 
     return mesh;
 }
\ No newline at end of file
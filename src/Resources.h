@@ -2,16 +2,22 @@
 
 #include <unordered_map>
 #include <memory>
+#include <string>
+#include <vector>
+
+#include <IntTypes.h>
 
 namespace Photon {
 
     class TriMesh;
     class Transform;
+    class BVH;
 
     // A singleton manager for resources, to be initialized at the start
     class Resources {
     public:
         ~Resources() {
+            _meshAccelMap.clear();
             _meshMap.clear();
         }
 
@@ -27,13 +33,44 @@ namespace Photon {
             get(); // Initialize instance
         }
 
+        // Meshes are loaded once per name and kept in object space
         std::shared_ptr<TriMesh> loadObj(const std::string& path, const std::string& name);
         std::shared_ptr<Transform> addTransform(const Transform& transform);
 
+        // Bottom level structure shared by the instances of a loaded mesh,
+        // built along with the others by buildMeshAccelerators. Those of
+        // meshes whose vertices moved since are refit.
+        std::shared_ptr<BVH> meshAccelerator(const std::string& name);
+        void buildMeshAccelerators();
+
+        // Loaded meshes and their structures are compiled into files next to
+        // their sources, later runs map them instead of parsing and building
+        void setCacheEnabled(bool enabled);
+        bool cacheEnabled() const;
+
+        // Combined content hash of the loaded meshes
+        uint64 contentKey() const;
+
+        // Meshes loaded from then on are stored compressed
+        void setMeshCompression(bool enabled);
+        bool meshCompression() const;
+
     private:
-        Resources() { }
+        Resources();
+
+        struct MeshSource {
+            std::string path;
+            uint64 key;         // Content hash of the file, zero without a cache
+        };
+
+        void buildMeshAccelerator(const std::string& name, BVH& bvh);
 
         std::unordered_map<std::string, std::shared_ptr<TriMesh>> _meshMap;
+        std::unordered_map<std::string, std::shared_ptr<BVH>> _meshAccelMap;
+        std::unordered_map<std::string, uint32> _meshAccelVersions;  // Mesh version of the last update
+        std::unordered_map<std::string, MeshSource> _meshSources;
+        bool _cacheEnabled;
+        bool _compressMeshes;
         //std::unordered_map<std::string, std::shared_ptr<Transform>> _transfMap;
         std::vector<std::shared_ptr<Transform>> _transforms;
     };
@@ -0,0 +1,310 @@
+#include <SDTree.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <Random.h>
+#include <Timer.h>
+
+using namespace Photon;
+
+// Equal area mapping between the sphere and the unit square
+static Point2 dirToSquare(const Vec3& dir) {
+    const Float cosTheta = Math::clamp(dir.z, (Float)-1, (Float)1);
+
+    Float phi = std::atan2(dir.y, dir.x);
+    if (phi < 0)
+        phi += 2 * PI;
+
+    return Point2(Math::clamp((cosTheta + 1) / 2, (Float)0, ONE_MINUS_EPSILON),
+                  Math::clamp(phi * INV2PI, (Float)0, ONE_MINUS_EPSILON));
+}
+
+static Vec3 squareToDir(const Point2& p) {
+    const Float cosTheta = 2 * p.x - 1;
+    const Float sinTheta = Math::sqrtSafe(1 - cosTheta * cosTheta);
+    const Float phi = 2 * PI * p.y;
+
+    return Vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+}
+
+// Quadrants are numbered by their x half, then their y half
+static uint32 quadrant(Point2* p) {
+    uint32 c = 0;
+    if (p->x >= 0.5) {
+        c |= 1;
+        p->x -= 0.5;
+    }
+
+    if (p->y >= 0.5) {
+        c |= 2;
+        p->y -= 0.5;
+    }
+
+    p->x *= 2;
+    p->y *= 2;
+
+    return c;
+}
+
+/* ======================================================================
+        DirectionalTree member functions
+ ========================================================================*/
+DirectionalTree::DirectionalTree() : _nodes(1), _numRecords(0) { }
+
+DirectionalTree::DirectionalTree(const DirectionalTree& tree)
+    : _nodes(tree._nodes), _numRecords(tree._numRecords.load()) { }
+
+DirectionalTree& DirectionalTree::operator=(const DirectionalTree& tree) {
+    _nodes = tree._nodes;
+    _numRecords = tree._numRecords.load();
+    return *this;
+}
+
+void DirectionalTree::record(const Vec3& dir, Float value) {
+    _numRecords++;
+
+    if (!(value > 0) || std::isinf(value))
+        return;
+
+    // Every node on the way holds the energy of its subtrees
+    Point2 p = dirToSquare(dir);
+    uint32 node = 0;
+    while (true) {
+        const uint32 c = quadrant(&p);
+        _nodes[node].sum[c].add(value);
+
+        if (!_nodes[node].child[c])
+            break;
+
+        node = _nodes[node].child[c];
+    }
+}
+
+Vec3 DirectionalTree::sample(const Point2& rand) const {
+    Point2 u = rand;
+    Point2 origin(0, 0);
+    Float  size = 1;
+
+    uint32 node = 0;
+    while (true) {
+        const Node& n = _nodes[node];
+
+        // Choose the x half, then the y half within it
+        const Float sums[4] = { n.sum[0].val(), n.sum[1].val(), n.sum[2].val(), n.sum[3].val() };
+        const Float total = sums[0] + sums[1] + sums[2] + sums[3];
+        if (total <= 0)
+            return squareToDir(Point2(origin.x + u.x * size, origin.y + u.y * size));
+
+        uint32 c = 0;
+        const Float left = (sums[0] + sums[2]) / total;
+        if (u.x < left) {
+            u.x = std::min(u.x / left, ONE_MINUS_EPSILON);
+        } else {
+            u.x = std::min((u.x - left) / (1 - left), ONE_MINUS_EPSILON);
+            c |= 1;
+        }
+
+        const Float bottom = sums[c] / (sums[c] + sums[c | 2]);
+        if (u.y < bottom) {
+            u.y = std::min(u.y / bottom, ONE_MINUS_EPSILON);
+        } else {
+            u.y = std::min((u.y - bottom) / (1 - bottom), ONE_MINUS_EPSILON);
+            c |= 2;
+        }
+
+        size /= 2;
+        origin.x += (c & 1) ? size : 0;
+        origin.y += (c & 2) ? size : 0;
+
+        if (!n.child[c])
+            return squareToDir(Point2(origin.x + u.x * size, origin.y + u.y * size));
+
+        node = n.child[c];
+    }
+}
+
+Float DirectionalTree::pdf(const Vec3& dir) const {
+    Point2 p = dirToSquare(dir);
+    Float pdf = INV4PI;
+
+    uint32 node = 0;
+    while (true) {
+        const Node& n = _nodes[node];
+
+        const Float total = n.total();
+        if (total <= 0)
+            return pdf;
+
+        const uint32 c = quadrant(&p);
+        pdf *= 4 * n.sum[c].val() / total;
+
+        if (!n.child[c] || pdf == 0)
+            return pdf;
+
+        node = n.child[c];
+    }
+}
+
+Float DirectionalTree::energy() const {
+    return _nodes[0].total();
+}
+
+uint64 DirectionalTree::numRecords() const {
+    return _numRecords;
+}
+
+uint32 DirectionalTree::numNodes() const {
+    return (uint32)_nodes.size();
+}
+
+void DirectionalTree::halveRecords() {
+    _numRecords = _numRecords / 2;
+}
+
+void DirectionalTree::refine(const DirectionalTree& tree) {
+    // Quadrants of the source tree, leaves split their energy evenly
+    // among the nodes they are subdivided into
+    struct Entry {
+        uint32 dst;
+        uint32 src;
+        bool   hasSrc;
+        Float  energy;      // Of a node not in the source
+        uint32 depth;
+    };
+
+    _nodes.clear();
+    _nodes.emplace_back();
+    _numRecords = 0;
+
+    const Float total = tree.energy();
+    if (total <= 0)
+        return;
+
+    std::vector<Entry> stack;
+    stack.push_back({ 0, 0, true, total, 1 });
+
+    while (!stack.empty()) {
+        const Entry entry = stack.back();
+        stack.pop_back();
+
+        for (uint32 c = 0; c < 4; ++c) {
+            const Float energy = entry.hasSrc ? tree._nodes[entry.src].sum[c].val() : entry.energy / 4;
+            if (entry.depth >= SDTREE_MAX_DEPTH || energy / total <= SDTREE_ENERGY_FRACTION)
+                continue;
+
+            const uint32 child = (uint32)_nodes.size();
+            _nodes.emplace_back();
+            _nodes[entry.dst].child[c] = child;
+
+            if (entry.hasSrc && tree._nodes[entry.src].child[c])
+                stack.push_back({ child, tree._nodes[entry.src].child[c], true, 0, entry.depth + 1 });
+            else
+                stack.push_back({ child, 0, false, energy, entry.depth + 1 });
+        }
+    }
+}
+
+/* ======================================================================
+        SDTree member functions
+ ========================================================================*/
+SDTree::SDTree(const Bounds3& bounds) : _iteration(0) {
+    // A cube around the scene, so the halves of every axis stay square
+    const Vec3 sizes = bounds.sizes();
+    const Float side = std::max(sizes[sizes.maxDim()], F_EPSILON) * (1 + 2 * F_EPSILON);
+    const Point3 center = bounds.center();
+
+    _bounds = Bounds3(center - Vec3(side / 2), center + Vec3(side / 2));
+
+    _nodes.push_back({ { 0, 0 }, 0, 0 });
+    _leaves.emplace_back();
+}
+
+uint32 SDTree::findLeaf(const Point3& pos) const {
+    const Vec3 sizes = _bounds.sizes();
+
+    Point3 p;
+    for (uint32 i = 0; i < 3; ++i)
+        p[i] = Math::clamp((pos[i] - _bounds.min()[i]) / sizes[i], (Float)0, ONE_MINUS_EPSILON);
+
+    uint32 node = 0;
+    while (_nodes[node].child[0]) {
+        const uint8 axis = _nodes[node].axis;
+
+        if (p[axis] < 0.5) {
+            p[axis] *= 2;
+            node = _nodes[node].child[0];
+        } else {
+            p[axis] = p[axis] * 2 - 1;
+            node = _nodes[node].child[1];
+        }
+    }
+
+    return _nodes[node].leaf;
+}
+
+SDTree::Leaf& SDTree::leaf(const Point3& pos) {
+    return _leaves[findLeaf(pos)];
+}
+
+const SDTree::Leaf& SDTree::leaf(const Point3& pos) const {
+    return _leaves[findLeaf(pos)];
+}
+
+uint32 SDTree::iteration() const {
+    return _iteration;
+}
+
+void SDTree::subdivide(uint32 node, uint32 threshold) {
+    const uint32 leafIdx = _nodes[node].leaf;
+    if (_leaves[leafIdx].sampling.numRecords() <= threshold)
+        return;
+
+    // Both halves start from what the leaf learned
+    _leaves[leafIdx].sampling.halveRecords();
+    _leaves.push_back(_leaves[leafIdx]);
+
+    const uint8 axis = (_nodes[node].axis + 1) % 3;
+    const uint32 first = (uint32)_nodes.size();
+    _nodes.push_back({ { 0, 0 }, leafIdx, axis });
+    _nodes.push_back({ { 0, 0 }, (uint32)_leaves.size() - 1, axis });
+
+    _nodes[node].child[0] = first;
+    _nodes[node].child[1] = first + 1;
+
+    subdivide(first, threshold);
+    subdivide(first + 1, threshold);
+}
+
+void SDTree::refine(uint32 spp) {
+    Utils::Timer timer;
+
+    // What was recorded is sampled from now on
+    for (Leaf& l : _leaves)
+        l.sampling = l.building;
+
+    // Leaves with many records are split, the threshold grows with the
+    // square root of the samples as the noise of their estimates shrinks
+    const uint32 threshold = (uint32)(SDTREE_SPATIAL_THRESHOLD * std::sqrt((Float)spp));
+
+    const uint32 numNodes = (uint32)_nodes.size();
+    for (uint32 node = 0; node < numNodes; ++node) {
+        if (!_nodes[node].child[0])
+            subdivide(node, threshold);
+    }
+
+    // The next iteration records into trees refined by this one
+    uint32 numDirNodes = 0;
+    for (Leaf& l : _leaves) {
+        l.building.refine(l.sampling);
+        numDirNodes += l.sampling.numNodes();
+    }
+
+    _iteration++;
+    timer.stop();
+
+    std::cout << "Guiding: iteration " << _iteration << " of " << spp << " spp, "
+              << _leaves.size() << " spatial leaves, " << numDirNodes << " directional nodes in "
+              << timer.elapsed() << " ms" << std::endl;
+}
\ No newline at end of file
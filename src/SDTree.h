@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include <PhotonMath.h>
+#include <Vector.h>
+#include <Bounds.h>
+#include <Atomic.h>
+
+namespace Photon {
+
+    // Spatial leaves holding more records than this, scaled by the square
+    // root of the samples per pixel of the iteration, are split in two
+    static const uint32 SDTREE_SPATIAL_THRESHOLD = 12000;
+
+    // Directional nodes above this fraction of the energy are subdivided
+    static const Float  SDTREE_ENERGY_FRACTION = 0.01;
+    static const uint32 SDTREE_MAX_DEPTH = 20;
+
+    // Quadtree over the directions, mapped to the unit square by their
+    // cosine of theta and phi, which keeps areas. Each node holds the
+    // energy of its four quadrants, so descending by them samples
+    // directions proportionally to the recorded radiance.
+    class DirectionalTree {
+    public:
+        DirectionalTree();
+
+        DirectionalTree(const DirectionalTree& tree);
+        DirectionalTree& operator=(const DirectionalTree& tree);
+
+        // Adds energy to the leaf of the direction, safe from any thread
+        void record(const Vec3& dir, Float value);
+
+        // Density over the sphere
+        Vec3  sample(const Point2& rand) const;
+        Float pdf(const Vec3& dir) const;
+
+        Float  energy() const;
+        uint64 numRecords() const;
+        uint32 numNodes() const;
+
+        // Subdivides the nodes holding enough of the energy of tree, and
+        // merges the others, starting empty
+        void refine(const DirectionalTree& tree);
+
+        // Splitting a spatial leaf leaves half of the records on each side
+        void halveRecords();
+
+    private:
+        struct Node {
+            AtomicFloat sum[4];
+            uint32 child[4];    // Zero for leaves, the root is never a child
+
+            Node() {
+                for (uint32 c = 0; c < 4; ++c)
+                    child[c] = 0;
+            }
+
+            Node(const Node& node) {
+                *this = node;
+            }
+
+            Node& operator=(const Node& node) {
+                for (uint32 c = 0; c < 4; ++c) {
+                    sum[c].set(node.sum[c].val());
+                    child[c] = node.child[c];
+                }
+
+                return *this;
+            }
+
+            Float total() const {
+                return sum[0].val() + sum[1].val() + sum[2].val() + sum[3].val();
+            }
+        };
+
+        std::vector<Node> _nodes;
+        std::atomic<uint64> _numRecords;
+    };
+
+    // Binary tree over the scene, splitting the axes in turn, whose leaves
+    // learn the incident radiance of the points within them. A leaf samples
+    // with what was recorded up to the last refinement while recording into
+    // a refined copy, which replaces it on the next one (Muller et al.,
+    // Practical Path Guiding for Efficient Light-Transport Simulation).
+    //
+    // Recording and sampling are safe from the workers during a pass,
+    // refining must happen in between.
+    class SDTree {
+    public:
+        SDTree(const Bounds3& bounds);
+
+        struct Leaf {
+            DirectionalTree sampling;
+            DirectionalTree building;
+        };
+
+        Leaf& leaf(const Point3& pos);
+        const Leaf& leaf(const Point3& pos) const;
+
+        // Ends an iteration of spp samples per pixel, the recorded
+        // radiance is used for sampling from then on
+        void refine(uint32 spp);
+
+        uint32 iteration() const;
+
+    private:
+        struct Node {
+            uint32 child[2];    // Zero for leaves
+            uint32 leaf;
+            uint8  axis;
+        };
+
+        uint32 findLeaf(const Point3& pos) const;
+
+        // Splits the node until its leaves are under the threshold
+        void subdivide(uint32 node, uint32 threshold);
+
+        Bounds3 _bounds;
+        std::vector<Node> _nodes;
+        std::vector<Leaf> _leaves;
+        uint32 _iteration;
+    };
+
+}
\ No newline at end of file
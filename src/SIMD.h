@@ -0,0 +1,129 @@
+#pragma once
+
+#include <PhotonTracer.h>
+#include <PhotonMath.h>
+
+#if defined(PHOTON_AVX)
+#include <immintrin.h>
+#elif defined(PHOTON_SSE)
+#include <emmintrin.h>
+#endif
+
+namespace Photon {
+
+    // Thin wrappers over the vector registers of the selected
+    // instruction set, so kernels are written once for all of them
+    namespace SIMD {
+
+#if defined(PHOTON_AVX)
+        static const uint32 DOUBLE_WIDTH = 4;
+
+        typedef __m256d VecD;
+        typedef __m256d MaskD;
+
+        inline VecD  setD(double x)                 { return _mm256_set1_pd(x); }
+        inline VecD  loadD(const double* ptr)       { return _mm256_load_pd(ptr); }
+        inline void  storeD(double* ptr, VecD a)    { _mm256_store_pd(ptr, a); }
+        inline VecD  add(VecD a, VecD b)            { return _mm256_add_pd(a, b); }
+        inline VecD  sub(VecD a, VecD b)            { return _mm256_sub_pd(a, b); }
+        inline VecD  mul(VecD a, VecD b)            { return _mm256_mul_pd(a, b); }
+        inline VecD  div(VecD a, VecD b)            { return _mm256_div_pd(a, b); }
+        inline MaskD lt(VecD a, VecD b)             { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+        inline MaskD le(VecD a, VecD b)             { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+        inline MaskD gt(VecD a, VecD b)             { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+        inline MaskD ge(VecD a, VecD b)             { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+        inline MaskD maskAnd(MaskD a, MaskD b)      { return _mm256_and_pd(a, b); }
+        inline MaskD maskOr(MaskD a, MaskD b)       { return _mm256_or_pd(a, b); }
+        inline uint32 maskBits(MaskD a)             { return (uint32)_mm256_movemask_pd(a); }
+
+        static const uint32 FLOAT_WIDTH = 8;
+
+        typedef __m256 VecF;
+        typedef __m256 MaskF;
+
+        inline VecF  setF(float x)                  { return _mm256_set1_ps(x); }
+        inline VecF  loadF(const float* ptr)        { return _mm256_load_ps(ptr); }
+        inline void  storeF(float* ptr, VecF a)     { _mm256_store_ps(ptr, a); }
+        inline VecF  add(VecF a, VecF b)            { return _mm256_add_ps(a, b); }
+        inline VecF  sub(VecF a, VecF b)            { return _mm256_sub_ps(a, b); }
+        inline VecF  mul(VecF a, VecF b)            { return _mm256_mul_ps(a, b); }
+        inline VecF  vmin(VecF a, VecF b)           { return _mm256_min_ps(a, b); }
+        inline VecF  vmax(VecF a, VecF b)           { return _mm256_max_ps(a, b); }
+        inline MaskF le(VecF a, VecF b)             { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        inline uint32 maskBits(MaskF a)             { return (uint32)_mm256_movemask_ps(a); }
+#elif defined(PHOTON_SSE)
+        static const uint32 DOUBLE_WIDTH = 2;
+
+        typedef __m128d VecD;
+        typedef __m128d MaskD;
+
+        inline VecD  setD(double x)                 { return _mm_set1_pd(x); }
+        inline VecD  loadD(const double* ptr)       { return _mm_load_pd(ptr); }
+        inline void  storeD(double* ptr, VecD a)    { _mm_store_pd(ptr, a); }
+        inline VecD  add(VecD a, VecD b)            { return _mm_add_pd(a, b); }
+        inline VecD  sub(VecD a, VecD b)            { return _mm_sub_pd(a, b); }
+        inline VecD  mul(VecD a, VecD b)            { return _mm_mul_pd(a, b); }
+        inline VecD  div(VecD a, VecD b)            { return _mm_div_pd(a, b); }
+        inline MaskD lt(VecD a, VecD b)             { return _mm_cmplt_pd(a, b); }
+        inline MaskD le(VecD a, VecD b)             { return _mm_cmple_pd(a, b); }
+        inline MaskD gt(VecD a, VecD b)             { return _mm_cmpgt_pd(a, b); }
+        inline MaskD ge(VecD a, VecD b)             { return _mm_cmpge_pd(a, b); }
+        inline MaskD maskAnd(MaskD a, MaskD b)      { return _mm_and_pd(a, b); }
+        inline MaskD maskOr(MaskD a, MaskD b)       { return _mm_or_pd(a, b); }
+        inline uint32 maskBits(MaskD a)             { return (uint32)_mm_movemask_pd(a); }
+
+        static const uint32 FLOAT_WIDTH = 4;
+
+        typedef __m128 VecF;
+        typedef __m128 MaskF;
+
+        inline VecF  setF(float x)                  { return _mm_set1_ps(x); }
+        inline VecF  loadF(const float* ptr)        { return _mm_load_ps(ptr); }
+        inline void  storeF(float* ptr, VecF a)     { _mm_store_ps(ptr, a); }
+        inline VecF  add(VecF a, VecF b)            { return _mm_add_ps(a, b); }
+        inline VecF  sub(VecF a, VecF b)            { return _mm_sub_ps(a, b); }
+        inline VecF  mul(VecF a, VecF b)            { return _mm_mul_ps(a, b); }
+        inline VecF  vmin(VecF a, VecF b)           { return _mm_min_ps(a, b); }
+        inline VecF  vmax(VecF a, VecF b)           { return _mm_max_ps(a, b); }
+        inline MaskF le(VecF a, VecF b)             { return _mm_cmple_ps(a, b); }
+        inline uint32 maskBits(MaskF a)             { return (uint32)_mm_movemask_ps(a); }
+#else
+        static const uint32 DOUBLE_WIDTH = 1;
+
+        typedef double VecD;
+        typedef bool   MaskD;
+
+        inline VecD  setD(double x)                 { return x; }
+        inline VecD  loadD(const double* ptr)       { return *ptr; }
+        inline void  storeD(double* ptr, VecD a)    { *ptr = a; }
+        inline VecD  add(VecD a, VecD b)            { return a + b; }
+        inline VecD  sub(VecD a, VecD b)            { return a - b; }
+        inline VecD  mul(VecD a, VecD b)            { return a * b; }
+        inline VecD  div(VecD a, VecD b)            { return a / b; }
+        inline MaskD lt(VecD a, VecD b)             { return a < b; }
+        inline MaskD le(VecD a, VecD b)             { return a <= b; }
+        inline MaskD gt(VecD a, VecD b)             { return a > b; }
+        inline MaskD ge(VecD a, VecD b)             { return a >= b; }
+        inline MaskD maskAnd(MaskD a, MaskD b)      { return a && b; }
+        inline MaskD maskOr(MaskD a, MaskD b)       { return a || b; }
+        inline uint32 maskBits(MaskD a)             { return a ? 1 : 0; }
+
+        static const uint32 FLOAT_WIDTH = 1;
+
+        typedef float VecF;
+        typedef bool  MaskF;
+
+        inline VecF  setF(float x)                  { return x; }
+        inline VecF  loadF(const float* ptr)        { return *ptr; }
+        inline void  storeF(float* ptr, VecF a)     { *ptr = a; }
+        inline VecF  add(VecF a, VecF b)            { return a + b; }
+        inline VecF  sub(VecF a, VecF b)            { return a - b; }
+        inline VecF  mul(VecF a, VecF b)            { return a * b; }
+        inline VecF  vmin(VecF a, VecF b)           { return a < b ? a : b; }
+        inline VecF  vmax(VecF a, VecF b)           { return a > b ? a : b; }
+        inline MaskF le(VecF a, VecF b)             { return a <= b; }
+#endif
+
+    }
+
+}
\ No newline at end of file
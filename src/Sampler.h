@@ -6,10 +6,9 @@
 
 #include <vector>
 
-namespace Photon {
+#include <Sampler.inl>
 
-    template<typename T>
-    struct SampleArrays;
+namespace Photon {
 
     class Sampler {
     public:
@@ -28,8 +27,15 @@ namespace Photon {
         virtual void start(const Point2ui& pixel) = 0;
         virtual void startSample(uint32 sample) = 0;
 
-        virtual void allocArray1D(uint32 numSamples) = 0;
-        virtual void allocArray2D(uint32 numSamples) = 0;
+        // Lays out an array drawn in every sample, independently of the
+        // sample count. Must be called before the sampler is copied.
+        void allocArray1D(uint32 numSamples) {
+            _arrays1D.allocArray(numSamples);
+        }
+
+        void allocArray2D(uint32 numSamples) {
+            _arrays2D.allocArray(numSamples);
+        }
 
         virtual void allocArray1D(std::vector<Float>& arr, uint32 numSamples) const = 0;
         virtual void allocArray2D(std::vector<Point2>& arr, uint32 numSamples) const = 0;
@@ -38,8 +44,39 @@ namespace Photon {
         virtual Point2 next2D() = 0;      
         virtual void nextND(uint32 N, std::vector<Float>& arr) const = 0;
 
-        virtual const Float*  next1DArray(uint32 numSamples) = 0;
-        virtual const Point2* next2DArray(uint32 numSamples) = 0;
+        // Arrays are drawn in the order they were laid out, nullptr
+        // once they run out or if the size does not match
+        const Float* next1DArray(uint32 numSamples) {
+            if (!_arrays1D.hasNext(numSamples))
+                return nullptr;
+
+            const uint32 index = _arrays1D.currDim;
+            Float* arr = _arrays1D.nextArray();
+            fillArray1D(index, numSamples, arr);
+            return arr;
+        }
+
+        const Point2* next2DArray(uint32 numSamples) {
+            if (!_arrays2D.hasNext(numSamples))
+                return nullptr;
+
+            const uint32 index = _arrays2D.currDim;
+            Point2* arr = _arrays2D.nextArray();
+            fillArray2D(index, numSamples, arr);
+            return arr;
+        }
+
+        // Skips dimensions of the current sample that were already drawn,
+        // when its first stage was evaluated apart (e.g. in a ray batch)
+        virtual void skip1D(uint32 count) {
+            for (uint32 i = 0; i < count; ++i)
+                next1D();
+        }
+
+        virtual void skip2D(uint32 count) {
+            for (uint32 i = 0; i < count; ++i)
+                next2D();
+        }
 
         virtual std::unique_ptr<Sampler> copy(uint32 seed) const = 0;
 
@@ -52,6 +89,16 @@ namespace Photon {
         }
 
     protected:
+        // Generates the values of the index-th array of the current sample
+        virtual void fillArray1D(uint32 index, uint32 numSamples, Float* arr) = 0;
+        virtual void fillArray2D(uint32 index, uint32 numSamples, Point2* arr) = 0;
+
+        // Arrays of the current sample start over
+        void resetArrays() {
+            _arrays1D.reset();
+            _arrays2D.reset();
+        }
+
         RandGen _rng;
 
         uint32 _spp;
@@ -59,8 +106,9 @@ namespace Photon {
 
         uint32   _currSample;
         Point2ui _currPixel;
-    };
 
-}
+        SampleArrays<Float>  _arrays1D;
+        SampleArrays<Point2> _arrays2D;
+    };
 
-#include <Sampler.inl>
\ No newline at end of file
+}
\ No newline at end of file
@@ -1,24 +1,24 @@
 namespace Photon {
 
+    // Arrays drawn within a sample, packed one after another in a single
+    // arena. The layout is fixed before rendering, the values are filled
+    // by the sampler as each array is drawn.
     template<typename T>
     struct SampleArrays {
     public:
         uint32 currDim;
-        std::vector<std::vector<T>> arrays;
+        std::vector<uint32> offsets;
+        std::vector<uint32> sizes;
+        std::vector<T> arena;
 
         SampleArrays() : currDim(0) {}
 
-        bool hasNext() {
-            return currDim < arrays.size();
+        bool hasNext() const {
+            return currDim < sizes.size();
         }
 
-        bool hasNext(uint32 numSamples) {
-            uint32 i = currDim;
-            while (i < arrays.size() && 
-                   arrays[i++].size() != numSamples)
-                ;
-
-            return i < arrays.size();
+        bool hasNext(uint32 numSamples) const {
+            return currDim < sizes.size() && sizes[currDim] == numSamples;
         }
 
         void reset() {
@@ -26,15 +26,13 @@ namespace Photon {
         }
 
         void allocArray(uint32 size) {
-            arrays.emplace_back(size);
-        }
-
-        const std::vector<T>& nextArray(uint32 numSamples) {
-            return arrays[currDim++];
+            offsets.push_back((uint32)arena.size());
+            sizes.push_back(size);
+            arena.resize(arena.size() + size);
         }
 
-        T& next(uint32 sample) {
-            return arrays[currDim++][sample];
+        T* nextArray() {
+            return &arena[offsets[currDim++]];
         }
     };
 
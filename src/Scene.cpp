@@ -5,49 +5,154 @@
 #include <Shape.h>
 #include <Bounds.h>
 #include <UniformGrid.h>
+#include <BVH.h>
+#include <WideBVH.h>
+#include <MotionBVH.h>
 
 #include <AreaLight.h>
+#include <Resources.h>
+#include <SceneCache.h>
 
 #include <PhotonTracer.h>
+#include <Threading.h>
+#include <Timer.h>
 
 using namespace Photon;
 
-Scene::Scene() : _background(0), _camera(), _lights(), _bounds(Point3(0)), 
-                 _uniformGrid(nullptr), _hideLights(false), _useGrid(true), 
-                 _lightDistr(nullptr), _lightStrat(POWER) { }
+Scene::Scene() : _background(0), _camera(), _lights(), _numAreaLights(0), _bounds(Point3(0)), 
+                 _accel(nullptr), _hideLights(false), _accelFromFile(false),
+                 _accelType(BVH_ACCELERATOR), _lightDistr(nullptr), _lightStrat(POWER), _cacheKey(0) { }
 
 void Scene::prepareRender() {
-    // Build bounding box
-    for (std::shared_ptr<Shape> s : _objects) {
-        const Bounds3 bbox = s->bbox();
-        if (bbox.isBounded())
-            _bounds.expand(bbox);
+    // Instances are bounded by the structures of their meshes, build those first
+    Utils::Timer meshTimer;
+    Resources::get().buildMeshAccelerators();
+    meshTimer.stop();
+
+    Utils::Timer boundsTimer;
+    computeBounds();
+    boundsTimer.stop();
+
+    // Static bounds of moving shapes span their whole motion, prefer a
+    // structure that follows them over time
+    if (_accelType == BVH_ACCELERATOR) {
+        for (const std::shared_ptr<Shape>& obj : _objects) {
+            if (obj->isAnimated()) {
+                _accelType = MOTION_BVH_ACCELERATOR;
+                break;
+            }
+        }
     }
 
-    // Initialize spatial subdivision, if needed
-    if (_useGrid) {
-        _uniformGrid = std::make_unique<UniformGrid>(*this, 2.0f);
-        //_uniformGrid = std::make_unique<UniformGrid>(*this, Vec3ui(6, 6, 6));
-        _uniformGrid->initialize();
+    // Initialize acceleration structure, if needed
+    Utils::Timer accelTimer;
+    _accel = loadAccelerator();
+    accelTimer.stop();
+
+    std::cout << "Scene: " << _objects.size() << " shapes, meshes in " << meshTimer.elapsed()
+              << " ms, bounds in " << boundsTimer.elapsed()
+              << " ms, " << acceleratorName(_accelType) << " ready in " << accelTimer.elapsed() << " ms" << std::endl;
+
+    initializeLights();
+}
+
+void Scene::setFrame(Float start, Float end) {
+    for (const std::shared_ptr<Shape>& obj : _objects)
+        obj->setFrame(start, end);
+
+    if (_camera)
+        _camera->setFrame(start);
+}
+
+void Scene::updateRender() {
+    if (!_accel && _accelType != NO_ACCELERATOR) {
+        prepareRender();
+        return;
     }
 
-    // Initialize light distribution, use uniform if unspecified
-    std::vector<Float> vals(_lights.size());
+    Utils::Timer meshTimer;
+    Resources::get().buildMeshAccelerators();
+    meshTimer.stop();
 
-    for (uint32 l = 0; l < _lights.size(); ++l)
-        vals[l] = (_lightStrat == POWER) ? _lights[l]->power().lum() : 1;
+    computeBounds();
+
+    // Only the bounds move, unless the tree got too slow to traverse
+    Utils::Timer accelTimer;
+    bool rebuilt = false;
+    if (_accel && (!_accel->refit() || _accel->degradation() > ACCEL_REBUILD_DEGRADATION)) {
+        _accel  = buildAccelerator(_accelType);
+        rebuilt = true;
+    }
+    accelTimer.stop();
 
-    _lightDistr = std::make_unique<DiscretePdf1D>(vals);
+    std::cout << "Scene: meshes updated in " << meshTimer.elapsed() << " ms, " << acceleratorName(_accelType)
+              << (rebuilt ? " rebuilt in " : " refit in ") << accelTimer.elapsed() << " ms" << std::endl;
+
+    initializeLights();
+}
+
+void Scene::computeBounds() {
+    _bounds = Bounds3(Point3(0));
+
+    // Build bounding box, each partition gathers its own
+    const uint32 numPartitions = Threading::Workers->numThreads() * 4;
+    std::vector<Bounds3> partBounds(numPartitions, Bounds3::EMPTY);
+    Threading::parallelRange(0, (uint32)_objects.size(), numPartitions, [&](uint32 part, uint32 start, uint32 end) {
+        for (uint32 idx = start; idx < end; ++idx) {
+            const Bounds3 bbox = _objects[idx]->bbox();
+            if (bbox.isBounded())
+                partBounds[part].expand(bbox);
+        }
+    });
+
+    for (const Bounds3& bbox : partBounds)
+        if (bbox.isBounded())
+            _bounds.expand(bbox);
+}
 
-    // Initialize lights
+void Scene::initializeLights() {
+    // Initialize lights first, their power and bounds may depend on the scene
     for (Light* light : _lights)
         light->initialize(*this);
+
+    // Initialize light distribution, use uniform if unspecified. Paths
+    // starting from the lights use it with the spatial strategy too.
+    std::vector<Float> vals(_lights.size());
+
+    const bool byPower = (_lightStrat == POWER || _lightStrat == SPATIAL);
+    for (uint32 l = 0; l < _lights.size(); ++l)
+        vals[l] = byPower ? _lights[l]->power().lum() : 1;
+
+    // Without lights there is nothing to sample
+    _lightDistr.reset();
+    if (!_lights.empty())
+        _lightDistr = std::make_unique<DiscretePdf1D>(vals);
+
+    // Lights are found by their address when evaluating the pdf of
+    // paths that hit them
+    _lightIndices.clear();
+    for (uint32 l = 0; l < _lights.size(); ++l)
+        _lightIndices[_lights[l]] = l;
+
+    _lightTree.reset();
+    if (_lightStrat == SPATIAL && !_lights.empty()) {
+        Utils::Timer treeTimer;
+        _lightTree = std::make_unique<LightTree>(_lights);
+        treeTimer.stop();
+
+        std::cout << "Scene: light tree of " << _lightTree->numNodes() << " nodes built in "
+                  << treeTimer.elapsed() << " ms" << std::endl;
+    }
 }
 
 DiscretePdf1D* Scene::lightDistribution() const {
     return _lightDistr.get();
 }
 
+void Scene::setLightStrategy(LightStrategy strat) {
+    _lightStrat = strat;
+}
+
 LightStrategy Scene::lightStrategy() const {
     return _lightStrat;
 }
@@ -64,6 +169,31 @@ const Light* Scene::sampleLightPdf(Float rand, Float* lightPdf) const {
     return _lights[lightIdx];
 }
 
+Float Scene::lightPdf(const Light* light) const {
+    if (!_lightDistr)
+        return 0;
+
+    auto it = _lightIndices.find(light);
+    if (it == _lightIndices.end())
+        return 0;
+
+    return _lightDistr->pdf(it->second);
+}
+
+const Light* Scene::sampleLight(const RayEvent& ref, Float rand, Float* lightPdf) const {
+    if (_lightTree)
+        return _lightTree->sample(ref, rand, lightPdf);
+
+    return sampleLightPdf(rand, lightPdf);
+}
+
+Float Scene::lightPdf(const RayEvent& ref, const Light* light) const {
+    if (_lightTree)
+        return _lightTree->pdf(ref, light);
+
+    return lightPdf(light);
+}
+
 void Scene::setBackgroundColor(const Color& color) {
     _background = color;
 }
@@ -72,7 +202,7 @@ const Color& Scene::getBackgroundColor() const {
     return _background;
 }
 
-void Scene::addCamera(const Camera& camera) {
+void Scene::addCamera(Camera& camera) {
     _camera = &camera;
 }
 
@@ -91,6 +221,7 @@ void Scene::addAreaLight(AreaLight* light) {
     if (shape) {
         addShape(light->shape());
         _lights.push_back(light);
+        _numAreaLights++;
     }
 }
 
@@ -98,8 +229,74 @@ const std::vector<Light*>& Scene::getLights() const {
     return _lights;
 }
 
-void Scene::useGrid(bool state) {
-    _useGrid = state;
+bool Scene::hasAreaLights() const {
+    return _numAreaLights > 0;
+}
+
+void Scene::setAccelerator(AcceleratorType type) {
+    _accelType = type;
+    _accelFromFile = true;
+}
+
+void Scene::setDefaultAccelerator(AcceleratorType type) {
+    // The scene file takes precedence over the defaults
+    if (!_accelFromFile)
+        _accelType = type;
+}
+
+AcceleratorType Scene::acceleratorType() const {
+    return _accelType;
+}
+
+std::unique_ptr<Accelerator> Scene::buildAccelerator(AcceleratorType type) const {
+    std::unique_ptr<Accelerator> accel = nullptr;
+
+    switch (type) {
+        case GRID_ACCELERATOR:
+            accel = std::make_unique<UniformGrid>(*this, 2.0f);
+            //accel = std::make_unique<UniformGrid>(*this, Vec3ui(6, 6, 6));
+            break;
+        case BVH_ACCELERATOR:
+            accel = std::make_unique<BVH>(_objects);
+            break;
+        case WIDE_BVH_ACCELERATOR:
+            accel = std::make_unique<WideBVH>(_objects);
+            break;
+        case MOTION_BVH_ACCELERATOR:
+            accel = std::make_unique<MotionBVH>(_objects);
+            break;
+        default:
+            return nullptr;
+    }
+
+    accel->initialize();
+
+    return accel;
+}
+
+void Scene::setCache(const std::string& path, uint64 key) {
+    _cachePath = path;
+    _cacheKey  = key;
+}
+
+std::unique_ptr<Accelerator> Scene::loadAccelerator() {
+    // Only the plain BVH is stored, the others are built every time
+    if (_cachePath.empty() || _accelType != BVH_ACCELERATOR)
+        return buildAccelerator(_accelType);
+
+    std::unique_ptr<BVH> bvh = std::make_unique<BVH>(_objects);
+
+    std::shared_ptr<Utils::CacheFile> file = Utils::CacheFile::open(_cachePath, _cacheKey);
+    if (file && bvh->readCache(*file))
+        return std::move(bvh);
+
+    bvh->initialize();
+
+    Utils::CacheWriter writer(_cacheKey);
+    bvh->writeCache(writer);
+    writer.write(_cachePath);
+
+    return std::move(bvh);
 }
 
 void Scene::addShape(const std::shared_ptr<Shape> object) {
@@ -111,13 +308,15 @@ const std::vector<std::shared_ptr<Shape>>& Scene::getShapes() const {
 }
 
 bool Scene::intersectRay(const Ray& ray, SurfaceEvent* info) const {
-    if (_uniformGrid) {
+    if (_accel) {
         // Use acceleration structure
-        _uniformGrid->intersectRay(ray, info);
+        _accel->intersectRay(ray, info);
 
         // If there is a hit, compute surface intersection info
-        if (info->hit())
+        if (info->hit()) {
             info->obj->computeSurfaceEvent(ray, *info);
+            info->time = ray.time();
+        }
 
         return info->hit();
     } else {
@@ -125,16 +324,18 @@ bool Scene::intersectRay(const Ray& ray, SurfaceEvent* info) const {
             obj->intersectRay(ray, info);
 
         // If there is a hit, compute surface intersection info
-        if (info->hit())
+        if (info->hit()) {
             info->obj->computeSurfaceEvent(ray, *info);
+            info->time = ray.time();
+        }
 
         return info->hit();
     }
 }
 
 bool Scene::isOccluded(const Ray& ray) const {
-    if (_uniformGrid) {
-        return _uniformGrid->isOccluded(ray);
+    if (_accel) {
+        return _accel->isOccluded(ray);
     } else {
         for (const std::shared_ptr<Shape> obj : _objects)
             if (obj->isOccluded(ray))
@@ -144,6 +345,42 @@ bool Scene::isOccluded(const Ray& ray) const {
     return false;
 }
 
+void Scene::intersectRays(const RayBatch& batch, HitBatch* hits) const {
+    for (uint32 r = 0; r < batch.size; ++r)
+        hits->events[r] = SurfaceEvent();
+
+    if (_accel) {
+        _accel->intersectRays(batch, hits);
+    } else {
+        for (uint32 r = 0; r < batch.size; ++r)
+            for (const std::shared_ptr<Shape> obj : _objects)
+                obj->intersectRay(batch.rays[r], &hits->events[r]);
+    }
+
+    // Compute surface intersection info of the hits
+    hits->hitMask = 0;
+    for (uint32 r = 0; r < batch.size; ++r) {
+        SurfaceEvent& evt = hits->events[r];
+        if (evt.hit()) {
+            evt.obj->computeSurfaceEvent(batch.rays[r], evt);
+            evt.time = batch.rays[r].time();
+            hits->hitMask |= 1u << r;
+        }
+    }
+}
+
+uint32 Scene::occludedRays(const RayBatch& batch) const {
+    if (_accel)
+        return _accel->occludedRays(batch);
+
+    uint32 occluded = 0;
+    for (uint32 r = 0; r < batch.size; ++r)
+        if (isOccluded(batch.rays[r]))
+            occluded |= 1u << r;
+
+    return occluded;
+}
+
 Bounds3 Scene::bounds() const {
     return _bounds;
-}
+}
\ No newline at end of file
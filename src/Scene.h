@@ -2,13 +2,16 @@
 
 #include <vector>
 #include <memory>
+#include <string>
+#include <unordered_map>
 
 #include <Vector.h>
 #include <Camera.h>
 #include <Bounds.h>
 #include <Shape.h>
-#include <UniformGrid.h>
+#include <Accelerator.h>
 #include <Distribution.h>
+#include <LightTree.h>
 
 namespace Photon {
 
@@ -18,24 +21,47 @@ namespace Photon {
     enum LightStrategy {
         ALL_LIGHTS = 0,
         UNIFORM = 1,
-        POWER = 2
+        POWER = 2,
+        SPATIAL = 3     // Light tree, by the estimated contribution to the shading point
     };
 
+    inline bool parseLightStrategy(const std::string& name, LightStrategy* strat) {
+        if (name.compare(0, 3, "all") == 0)
+            *strat = ALL_LIGHTS;
+        else if (name.compare(0, 7, "uniform") == 0)
+            *strat = UNIFORM;
+        else if (name.compare(0, 5, "power") == 0)
+            *strat = POWER;
+        else if (name.compare(0, 4, "tree") == 0 || name.compare(0, 7, "spatial") == 0)
+            *strat = SPATIAL;
+        else
+            return false;
+
+        return true;
+    }
+
     class Scene {
     public:
         Scene();
 
         void prepareRender();
 
+        // Sequences keep the scene between frames, moving the shapes to the
+        // given part of their animation and the camera to where it starts. The update refits the structures
+        // built by prepareRender, or builds them again once too degraded.
+        void setFrame(Float start, Float end);
+        void updateRender();
+
         void setBackgroundColor(const Color& color);
         const Color& getBackgroundColor() const;
 
-        void addCamera(const Camera& camera);
+        void addCamera(Camera& camera);
         const Camera& getCamera() const;
 
         void addLight(Light* light);
         void addAreaLight(AreaLight* light);
         const std::vector<Light*>& getLights() const;
+        bool hasAreaLights() const;
 
         void addShape(const std::shared_ptr<Shape> object);
         const std::vector<std::shared_ptr<Shape>>& getShapes() const;
@@ -43,24 +69,55 @@ namespace Photon {
         bool intersectRay(const Ray& ray, SurfaceEvent* info) const;
         bool isOccluded(const Ray& ray) const;
 
+        // Batched queries of coherent rays, occludedRays returns a bit mask
+        void intersectRays(const RayBatch& batch, HitBatch* hits) const;
+        uint32 occludedRays(const RayBatch& batch) const;
+
         Bounds3 bounds() const;
 
-        void useGrid(bool state);
+        void setAccelerator(AcceleratorType type);
+        void setDefaultAccelerator(AcceleratorType type);
+        AcceleratorType acceleratorType() const;
+        std::unique_ptr<Accelerator> buildAccelerator(AcceleratorType type) const;
+
+        // Compiled cache of the scene structure, keyed by the contents of
+        // the files the scene was loaded from
+        void setCache(const std::string& path, uint64 key);
 
         const Light* sampleLightPdf(Float rand, Float* lightPdf) const;
+
+        // Probability of sampleLightPdf choosing the light, in constant time
+        Float lightPdf(const Light* light) const;
+
+        // Picks a light to illuminate the reference point, the spatial
+        // strategy prefers the lights that contribute most to it
+        const Light* sampleLight(const RayEvent& ref, Float rand, Float* lightPdf) const;
+        Float lightPdf(const RayEvent& ref, const Light* light) const;
+
+        void setLightStrategy(LightStrategy strat);
         LightStrategy lightStrategy() const;
         DiscretePdf1D* lightDistribution() const;
     private:
+        void computeBounds();
+        void initializeLights();
+        std::unique_ptr<Accelerator> loadAccelerator();
+
         Color _background;
-        const Camera* _camera;
+        Camera* _camera;
         Bounds3 _bounds;
         std::vector<Light*> _lights;
+        uint32 _numAreaLights;
         std::vector<std::shared_ptr<Shape>> _objects;
-        std::unique_ptr<UniformGrid> _uniformGrid;
+        std::unique_ptr<Accelerator> _accel;
         std::unique_ptr<DiscretePdf1D> _lightDistr;
+        std::unordered_map<const Light*, uint32> _lightIndices;
+        std::unique_ptr<LightTree> _lightTree;
         bool _hideLights;
-        bool _useGrid;
+        bool _accelFromFile;  // Accelerator chosen by the scene file
+        AcceleratorType _accelType;
         LightStrategy _lightStrat;
+        std::string _cachePath;
+        uint64 _cacheKey;
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include <SceneCache.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <PhotonMath.h>
+#include <BVH.h>
+
+using namespace Photon;
+using namespace Photon::Utils;
+
+static const uint64 FNV_PRIME = 0x100000001b3ull;
+
+namespace {
+
+    struct CacheHeader {
+        char   magic[4];
+        uint32 version;
+        uint64 key;
+        uint32 layout;
+        uint32 numChunks;
+    };
+
+    struct CacheChunkEntry {
+        uint32 type;
+        uint32 pad;
+        uint64 offset;
+        uint64 size;
+    };
+
+    const char CACHE_MAGIC[4] = { 'P', '3', 'D', 'C' };
+
+    // Sizes of the stored types, caches from builds with other
+    // precisions or packet widths are never read
+    uint32 layoutSignature() {
+        return (uint32)(sizeof(Float) | sizeof(Point3) << 4 | PACKET_WIDTH << 12 |
+                        sizeof(TrianglePacket) << 16);
+    }
+
+    size_t alignChunk(size_t offset) {
+        return (offset + CACHE_ALIGNMENT - 1) & ~(size_t)(CACHE_ALIGNMENT - 1);
+    }
+
+}
+
+uint64 Utils::hashBytes(const void* data, size_t size, uint64 seed) {
+    const uint8* bytes = (const uint8*)data;
+    uint64 hash = seed;
+
+    // Whole words first, then the remaining bytes
+    size_t i = 0;
+    for (; i + sizeof(uint64) <= size; i += sizeof(uint64)) {
+        uint64 word;
+        memcpy(&word, bytes + i, sizeof(uint64));
+
+        hash ^= word;
+        hash *= FNV_PRIME;
+    }
+
+    for (; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+uint64 Utils::hashCombine(uint64 seed, uint64 value) {
+    return hashBytes(&value, sizeof(uint64), seed);
+}
+
+CacheFile::CacheFile(std::unique_ptr<MappedFile> file)
+    : _file(std::move(file)) { }
+
+std::shared_ptr<CacheFile> CacheFile::open(const std::string& path, uint64 key) {
+    std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>(path);
+    if (!file->isOpen() || file->size() < sizeof(CacheHeader))
+        return nullptr;
+
+    const CacheHeader* header = (const CacheHeader*)file->data();
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header->version != CACHE_VERSION ||
+        header->key != key || header->layout != layoutSignature())
+        return nullptr;
+
+    // Every chunk must lie within the file
+    const size_t tableEnd = sizeof(CacheHeader) + header->numChunks * sizeof(CacheChunkEntry);
+    if (tableEnd > file->size())
+        return nullptr;
+
+    const CacheChunkEntry* entries = (const CacheChunkEntry*)(file->data() + sizeof(CacheHeader));
+    for (uint32 c = 0; c < header->numChunks; ++c)
+        if (entries[c].offset < tableEnd || entries[c].offset + entries[c].size > file->size())
+            return nullptr;
+
+    return std::make_shared<CacheFile>(std::move(file));
+}
+
+uint8* CacheFile::chunk(uint32 type, size_t* size) const {
+    const CacheHeader* header = (const CacheHeader*)_file->data();
+    const CacheChunkEntry* entries = (const CacheChunkEntry*)(_file->data() + sizeof(CacheHeader));
+
+    for (uint32 c = 0; c < header->numChunks; ++c) {
+        if (entries[c].type != type)
+            continue;
+
+        if (size)
+            *size = (size_t)entries[c].size;
+
+        return _file->data() + entries[c].offset;
+    }
+
+    return nullptr;
+}
+
+CacheWriter::CacheWriter(uint64 key)
+    : _key(key) { }
+
+void CacheWriter::addChunk(uint32 type, const void* data, size_t size) {
+    const uint8* bytes = (const uint8*)data;
+    _chunks.push_back({ type, std::vector<uint8>(bytes, bytes + size) });
+}
+
+bool CacheWriter::write(const std::string& path) const {
+    CacheHeader header;
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version   = CACHE_VERSION;
+    header.key       = _key;
+    header.layout    = layoutSignature();
+    header.numChunks = (uint32)_chunks.size();
+
+    std::vector<CacheChunkEntry> entries(_chunks.size());
+    size_t offset = sizeof(CacheHeader) + entries.size() * sizeof(CacheChunkEntry);
+    for (uint32 c = 0; c < _chunks.size(); ++c) {
+        offset = alignChunk(offset);
+        entries[c] = { _chunks[c].type, 0, offset, _chunks[c].data.size() };
+        offset += _chunks[c].data.size();
+    }
+
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        if (file.fail())
+            return false;
+
+        file.write((const char*)&header, sizeof(CacheHeader));
+        file.write((const char*)entries.data(), entries.size() * sizeof(CacheChunkEntry));
+
+        const char padding[CACHE_ALIGNMENT] = { };
+        size_t written = sizeof(CacheHeader) + entries.size() * sizeof(CacheChunkEntry);
+        for (uint32 c = 0; c < _chunks.size(); ++c) {
+            file.write(padding, entries[c].offset - written);
+            file.write((const char*)_chunks[c].data.data(), _chunks[c].data.size());
+            written = entries[c].offset + _chunks[c].data.size();
+        }
+
+        if (file.fail()) {
+            file.close();
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+
+    std::remove(path.c_str());
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <IntTypes.h>
+#include <MappedFile.h>
+
+namespace Photon {
+
+    namespace Utils {
+
+        static const uint32 CACHE_VERSION   = 3;
+        static const uint32 CACHE_ALIGNMENT = 64;    // Chunks start on a cache line
+
+        // Compiled files live next to their sources
+        static const char* const MESH_CACHE_EXT  = ".mesh.p3c";
+        static const char* const BVH_CACHE_EXT   = ".bvh.p3c";
+        static const char* const SCENE_CACHE_EXT = ".p3c";
+
+        enum CacheChunkType {
+            CACHE_MESH = 1,             // Mesh sizes and attributes
+            CACHE_MESH_BUFFERS = 2,     // Vertex and index buffers, used in place
+            CACHE_BVH = 3,              // Tree sizes, bounds and cost
+            CACHE_BVH_NODES = 4,
+            CACHE_BVH_PACKETS = 5,
+            CACHE_BVH_LANES = 6,        // Shape index of each packet lane
+            CACHE_BVH_UNBOUNDED = 7     // Shape index of each unbounded primitive
+        };
+
+        // FNV-1a over the 64-bit words of a buffer, keys caches by the contents of their sources
+        uint64 hashBytes(const void* data, size_t size, uint64 seed = 0xcbf29ce484222325ull);
+        uint64 hashCombine(uint64 seed, uint64 value);
+
+        // Compiled data stored as typed chunks after a header. The file is
+        // mapped and chunks are aligned, so their contents are used directly.
+        class CacheFile {
+        public:
+            // Opens the cache if it was compiled from the same key by
+            // this build, returns nullptr otherwise
+            static std::shared_ptr<CacheFile> open(const std::string& path, uint64 key);
+
+            // Contents of a chunk, nullptr if it is missing
+            uint8* chunk(uint32 type, size_t* size = nullptr) const;
+
+            CacheFile(std::unique_ptr<MappedFile> file);
+
+        private:
+            std::unique_ptr<MappedFile> _file;
+        };
+
+        // Gathers chunks and writes them as a cache file
+        class CacheWriter {
+        public:
+            CacheWriter(uint64 key);
+
+            void addChunk(uint32 type, const void* data, size_t size);
+
+            // Written to a temporary file first, a failed write never leaves a
+            // partial cache behind. Returns false if the cache can't be saved.
+            bool write(const std::string& path) const;
+
+        private:
+            struct Chunk {
+                uint32 type;
+                std::vector<uint8> data;
+            };
+
+            uint64 _key;
+            std::vector<Chunk> _chunks;
+        };
+
+    }
+
+}
\ No newline at end of file
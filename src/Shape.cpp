@@ -47,6 +47,20 @@ Float Shape::area() const {
     return 0;
 }
 
+bool Shape::isAnimated() const {
+    return false;
+}
+
+void Shape::motionBounds(Bounds3* start, Bounds3* end) const {
+    *start = *end = bbox();
+}
+
+void Shape::setFrame(Float start, Float end) { }
+
+const TriMesh* Shape::triMesh() const {
+    return nullptr;
+}
+
 bool Shape::isLight() const {
     return _light != nullptr;
 }
@@ -80,4 +94,13 @@ void Shape::sampleDirect(const Point2& rand, DirectSample* sample) const {
 
 Float Shape::pdfDirect(const DirectSample& sample) const {
     return 0;
+}
+
+void Shape::prepareSampling() {
+
+}
+
+void Shape::normalCone(Vec3* axis, Float* cosTheta) const {
+    *axis     = Vec3(0, 0, 1);
+    *cosTheta = -1;
 }
\ No newline at end of file
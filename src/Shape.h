@@ -11,6 +11,7 @@ namespace Photon {
     class Light;
     class AreaLight;
     class BSDF;
+    class TriMesh;
 
     class Shape {
     public:
@@ -35,6 +36,18 @@ namespace Photon {
         virtual Bounds3 bbox() const;
         virtual Float area() const;
 
+        // Moving shapes are bounded at both ends of the shutter, by boxes
+        // whose interpolation contains them at any time in between
+        virtual bool isAnimated() const;
+        virtual void motionBounds(Bounds3* start, Bounds3* end) const;
+
+        // Frames of a sequence each show part of the animation, the
+        // shutter then spans times start to end of the whole motion
+        virtual void setFrame(Float start, Float end);
+
+        // Meshes are split into their faces by the accelerators
+        virtual const TriMesh* triMesh() const;
+
         // -------------------------------------------------------------
         //      Shape sampling
         // -------------------------------------------------------------
@@ -44,6 +57,14 @@ namespace Photon {
         virtual void  sampleDirect(const Point2& rand, DirectSample* sample) const;
         virtual Float pdfDirect(const DirectSample& sample) const;
 
+        // Cone bounding the normals of the surface, as its axis and the
+        // cosine of its spread. The whole sphere unless known better.
+        virtual void normalCone(Vec3* axis, Float* cosTheta) const;
+
+        // Builds what sampling the shape needs, called by its light
+        // whenever the scene is prepared
+        virtual void prepareSampling();
+
     protected:
         Transform _objToWorld;
         Transform _worldToObj;
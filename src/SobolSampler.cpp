@@ -0,0 +1,165 @@
+#include <SobolSampler.h>
+
+#include <algorithm>
+
+using namespace Photon;
+
+namespace {
+
+    // Seeds of the sample arrays, kept apart from the dimensions
+    const uint64 ARRAY1D_SEED = 0x9e3779b97f4a7c15ull;
+    const uint64 ARRAY2D_SEED = 0xc2b2ae3d27d4eb4full;
+
+    inline uint32 reverseBits(uint32 v) {
+        v = (v << 16) | (v >> 16);
+        v = ((v & 0x00ff00ff) << 8) | ((v & 0xff00ff00) >> 8);
+        v = ((v & 0x0f0f0f0f) << 4) | ((v & 0xf0f0f0f0) >> 4);
+        v = ((v & 0x33333333) << 2) | ((v & 0xcccccccc) >> 2);
+        v = ((v & 0x55555555) << 1) | ((v & 0xaaaaaaaa) >> 1);
+        return v;
+    }
+
+    // Hashed approximation of Owen's nested uniform scramble (Burley,
+    // Practical Hash-based Owen Scrambling), on bit reversed values. Each
+    // bit is only flipped by the more significant bits of the value, so
+    // intervals stay intervals.
+    inline uint32 laineKarras(uint32 v, uint32 seed) {
+        v += seed;
+        v ^= v * 0x6c50b47cu;
+        v ^= v * 0xb82f1e52u;
+        v ^= v * 0xc7afe638u;
+        v ^= v * 0x8d22f6e6u;
+        return v;
+    }
+
+    // The first two Sobol dimensions, a (0,2)-sequence, bit reversed. Their
+    // generator matrices are the identity and the Pascal matrix mod 2,
+    // which factors into one shifted XOR per bit of the index width.
+    inline uint32 sobolReversed0(uint32 index) {
+        return index;
+    }
+
+    inline uint32 sobolReversed1(uint32 index) {
+        index ^= (index & 0xaaaaaaaa) >> 1;
+        index ^= (index & 0xcccccccc) >> 2;
+        index ^= (index & 0xf0f0f0f0) >> 4;
+        index ^= (index & 0xff00ff00) >> 8;
+        index ^= (index & 0xffff0000) >> 16;
+        return index;
+    }
+
+    inline Float toFloat(uint32 reversed) {
+        return std::min(reverseBits(reversed) * Float(2.3283064365386963e-10), ONE_MINUS_EPSILON);  // 2^-32
+    }
+
+    // The index is shuffled before the lookup so that dimensions padded
+    // from the same points are not correlated. Shuffled power of two
+    // prefixes map to aligned blocks of the sequence, which keep the
+    // stratification of the prefix.
+    inline uint32 shuffle(uint32 index, uint32 seed) {
+        return reverseBits(laineKarras(reverseBits(index), seed));
+    }
+
+    inline Float sample1D(uint32 index, uint64 hash) {
+        index = shuffle(index, (uint32)hash);
+        return toFloat(laineKarras(sobolReversed0(index), (uint32)(hash >> 32)));
+    }
+
+    inline Point2 sample2D(uint32 index, uint64 hash) {
+        index = shuffle(index, (uint32)hash);
+
+        const uint64 scramble = mixBits(hash);
+        return Point2(toFloat(laineKarras(sobolReversed0(index), (uint32)scramble)),
+                      toFloat(laineKarras(sobolReversed1(index), (uint32)(scramble >> 32))));
+    }
+
+    inline uint64 dimensionHash(uint64 seed, uint64 dim) {
+        return mixBits(seed ^ mixBits(dim + 1));
+    }
+
+}
+
+SobolSampler::SobolSampler(uint32 spp, uint32 seed)
+    : Sampler(spp), _seed(mixBits(seed)), _pixelSeed(0), _dim(0) {
+
+    _numDims = 0;
+    _currSample = 0;
+}
+
+void SobolSampler::start(const Point2ui& pixel) {
+    _currPixel = pixel;
+    _currSample = 0;
+    _dim = 0;
+    _pixelSeed = mixBits(((uint64)pixel.x << 32 | pixel.y) ^ _seed);
+
+    resetArrays();
+}
+
+void SobolSampler::startSample(uint32 sample) {
+    _currSample = sample;
+    _dim = 0;
+
+    resetArrays();
+}
+
+void SobolSampler::allocArray1D(std::vector<Float>& arr, uint32 numSamples) const {
+    const uint64 hash = mixBits((uint64)_rng.uniformUInt32() << 32 | _rng.uniformUInt32());
+
+    arr.resize(numSamples);
+    for (uint32 s = 0; s < numSamples; ++s)
+        arr[s] = sample1D(s, hash);
+}
+
+void SobolSampler::allocArray2D(std::vector<Point2>& arr, uint32 numSamples) const {
+    const uint64 hash = mixBits((uint64)_rng.uniformUInt32() << 32 | _rng.uniformUInt32());
+
+    arr.resize(numSamples);
+    for (uint32 s = 0; s < numSamples; ++s)
+        arr[s] = sample2D(s, hash);
+}
+
+Float SobolSampler::next1D() {
+    return sample1D(_currSample, dimensionHash(_pixelSeed, _dim++));
+}
+
+Point2 SobolSampler::next2D() {
+    const Point2 sample = sample2D(_currSample, dimensionHash(_pixelSeed, _dim));
+    _dim += 2;
+
+    return sample;
+}
+
+void SobolSampler::nextND(uint32 N, std::vector<Float>& arr) const {
+    arr.resize(N);
+    for (uint32 i = 0; i < N; ++i)
+        arr[i] = _rng.uniform1D();
+}
+
+// The array of each sample is a consecutive run of points of its own
+// scrambled sequence, so the arrays of all samples of the pixel are
+// stratified together
+void SobolSampler::fillArray1D(uint32 index, uint32 numSamples, Float* arr) {
+    const uint64 hash = dimensionHash(_pixelSeed ^ ARRAY1D_SEED, index);
+    for (uint32 s = 0; s < numSamples; ++s)
+        arr[s] = sample1D(_currSample * numSamples + s, hash);
+}
+
+void SobolSampler::fillArray2D(uint32 index, uint32 numSamples, Point2* arr) {
+    const uint64 hash = dimensionHash(_pixelSeed ^ ARRAY2D_SEED, index);
+    for (uint32 s = 0; s < numSamples; ++s)
+        arr[s] = sample2D(_currSample * numSamples + s, hash);
+}
+
+void SobolSampler::skip1D(uint32 count) {
+    _dim += count;
+}
+
+void SobolSampler::skip2D(uint32 count) {
+    _dim += 2 * count;
+}
+
+std::unique_ptr<Sampler> SobolSampler::copy(uint32 seed) const {
+    std::unique_ptr<Sampler> samp = std::make_unique<SobolSampler>(*this);
+    samp->setSeq(seed);
+    return std::move(samp);
+}
\ No newline at end of file
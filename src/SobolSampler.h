@@ -4,29 +4,38 @@
 
 namespace Photon {
 
+    // Owen scrambled Sobol points, padded to any number of dimensions.
+    // Each draw takes the first one or two dimensions of the sequence,
+    // a (0,2)-sequence, with its own hashed shuffle of the sample index
+    // and hashed nested scramble of the values. Seeds are derived from
+    // the pixel and dimension, so starting a pixel costs nothing.
     class SobolSampler : public Sampler {
     public:
-        SobolSampler(uint32 spp, uint32 numDims = 0) : Sampler(spp) {
+        SobolSampler(uint32 spp, uint32 seed = 0);
 
-        }
+        void start(const Point2ui& pixel);
+        void startSample(uint32 sample);
 
-        void start(const Point2ui& pixel) = 0;
-        void startSample(uint32 sample) = 0;
+        void allocArray1D(std::vector<Float>& arr, uint32 numSamples) const;
+        void allocArray2D(std::vector<Point2>& arr, uint32 numSamples) const;
 
-        void allocArray1D(uint32 numSamples) = 0;
-        void allocArray2D(uint32 numSamples) = 0;
+        Float  next1D();
+        Point2 next2D();
+        void nextND(uint32 N, std::vector<Float>& arr) const;
 
-        void allocArray1D(std::vector<Float>& arr, uint32 numSamples) const = 0;
-        void allocArray2D(std::vector<Point2>& arr, uint32 numSamples) const = 0;
+        void skip1D(uint32 count);
+        void skip2D(uint32 count);
 
-        Float  next1D() = 0;
-        Point2 next2D() = 0;
-        void nextND(uint32 N, std::vector<Float>& arr) const = 0;
+        std::unique_ptr<Sampler> copy(uint32 seed) const;
 
-        const Float*  next1DArray(uint32 numSamples) = 0;
-        const Point2* next2DArray(uint32 numSamples) = 0;
+    protected:
+        void fillArray1D(uint32 index, uint32 numSamples, Float* arr);
+        void fillArray2D(uint32 index, uint32 numSamples, Point2* arr);
 
-        std::unique_ptr<Sampler> copy(uint32 seed) const = 0;
+    private:
+        uint64 _seed;
+        uint64 _pixelSeed;
+        uint32 _dim;
     };
 
 }
\ No newline at end of file
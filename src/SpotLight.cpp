@@ -1,5 +1,7 @@
 #include <SpotLight.h>
 
+#include <LightTree.h>
+
 using namespace Photon;
 
 SpotLight::SpotLight(const Transform& objToWorld, const Color& color)
@@ -30,6 +32,16 @@ Color SpotLight::power() const {
     return 2 * PI * _Le * (1.0 - 0.5 * (_attStart + _cosMax));
 }
 
+// Full intensity within the start of the falloff, then fading out to the cutoff
+bool SpotLight::lightBounds(LightBounds* bounds) const {
+    const Vec3  axis = normalize(_objToWorld(Vec3(0, 0, 1)));
+    const Float cosTheta_o = std::max(_attStart, _cosMax);
+    const Float cosTheta_e = std::cos(Math::acosSafe(_cosMax) - Math::acosSafe(cosTheta_o));
+
+    *bounds = LightBounds(Bounds3(_pos), axis, cosTheta_o, cosTheta_e, power().lum());
+    return true;
+}
+
 Color SpotLight::evalL(const SurfaceEvent& it, const Vec3& wo) const {
     return Color::BLACK;
 }
@@ -14,6 +14,7 @@ namespace Photon {
 
         bool isDelta() const;
         Color power() const;
+        bool  lightBounds(LightBounds* bounds) const;
 
         Color evalL(const SurfaceEvent& it, const Vec3& wo) const;
         Color evalL(const PositionSample& sample, const Vec3& wo) const;
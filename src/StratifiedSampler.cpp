@@ -4,24 +4,24 @@
 
 using namespace Photon;
 
-StratifiedSampler::StratifiedSampler(uint32 nx, uint32 ny, uint32 numDims) : _nx(nx), _ny(ny), Sampler(nx * ny) {
+StratifiedSampler::StratifiedSampler(uint32 nx, uint32 ny, uint32 numDims, uint32 seed) 
+    : _nx(nx), _ny(ny), Sampler(nx * ny), _dim1D(0), _dim2D(0), _seed(mixBits(seed)), _pixelSeed(0) {
+
     _numDims = numDims;
-    for (uint32 d = 0; d < numDims; ++d) {
-        _samples1D.allocArray(_spp);
-        _samples2D.allocArray(_spp);
-    }
+    _samples1D.resize(numDims, std::vector<Float>(_spp));
+    _samples2D.resize(numDims, std::vector<Point2>(_spp));
 }
 
 Float StratifiedSampler::next1D() {
-    if (_samples1D.hasNext())
-        return _samples1D.next(_currSample);
+    if (_dim1D < _numDims)
+        return _samples1D[_dim1D++][_currSample];
 
     return _rng.uniform1D();
 }
 
 Point2 StratifiedSampler::next2D() {
-    if (_samples2D.hasNext())
-        return _samples2D.next(_currSample);
+    if (_dim2D < _numDims)
+        return _samples2D[_dim2D++][_currSample];
 
     return _rng.uniform2D();
 }
@@ -34,43 +34,33 @@ void StratifiedSampler::nextND(uint32 N, std::vector<Float>& arr) const {
 
 void StratifiedSampler::start(const Point2ui& pixel) {
     _currPixel = pixel;
-    _currSample = 0;
-    _arrays1D.reset();
-    _arrays2D.reset();
-    _samples1D.reset();
-    _samples2D.reset();
+
+    // Patterns only depend on the pixel, so every pass over it
+    // continues the same stratification
+    _pixelSeed = mixBits(((uint64)pixel.x << 32 | pixel.y) ^ _seed);
+    _rng = RandGen(_pixelSeed);
 
     for (uint32 d = 0; d < _numDims; ++d) {
-        nRooks(_rng, _spp, 1, &_samples1D.arrays[d][0]);
+        nRooks(_rng, _spp, 1, &_samples1D[d][0]);
 
         // Stratify and permute x and y coordinates
-        multijittered2DArray(_rng, _nx, _ny, _samples2D.arrays[d]);
-        //stratified2DArray(_rng, _nx, _ny, _samples2D.arrays[d]);
-        //permute(_rng, _nx * _ny, 2, 0, &_samples2D.arrays[d][0][0]);
-        //permute(_rng, _nx * _ny, 2, 1, &_samples2D.arrays[d][0][0]);
+        multijittered2DArray(_rng, _nx, _ny, _samples2D[d]);
+        //stratified2DArray(_rng, _nx, _ny, _samples2D[d]);
+        //permute(_rng, _nx * _ny, 2, 0, &_samples2D[d][0][0]);
+        //permute(_rng, _nx * _ny, 2, 1, &_samples2D[d][0][0]);
     }
 
-    auto& arrays1D = _arrays1D.arrays;
-    for (uint32 arr = 0; arr < arrays1D.size(); ++arr)
-        nRooks(_rng, (uint32)arrays1D[arr].size(), 1, &arrays1D[arr][0]);
-
-    auto& arrays2D = _arrays2D.arrays;
-    for (uint32 arr = 0; arr < arrays2D.size(); ++arr)
-        nRooks(_rng, (uint32)arrays2D[arr].size(), 2, &arrays2D[arr][0][0]);
+    startSample(0);
 }
 
 void StratifiedSampler::startSample(uint32 sample) {
     _currSample = sample;
-    _samples1D.reset();
-    _samples2D.reset();
-}
+    _dim1D = 0;
+    _dim2D = 0;
+    resetArrays();
 
-void StratifiedSampler::allocArray1D(uint32 numSamples) {
-    _arrays1D.allocArray(numSamples);
-}
-
-void StratifiedSampler::allocArray2D(uint32 numSamples) {
-    _arrays2D.allocArray(numSamples);
+    // Past the patterns, each sample draws from a sequence of its own
+    _rng = RandGen(mixBits(_pixelSeed ^ mixBits(sample + 1)));
 }
 
 void StratifiedSampler::allocArray1D(std::vector<Float>& arr, uint32 numSamples) const {
@@ -81,18 +71,12 @@ void StratifiedSampler::allocArray2D(std::vector<Point2>& arr, uint32 numSamples
     jittered2DArray(_rng, numSamples, arr);
 }
 
-const Float* StratifiedSampler::next1DArray(uint32 numSamples) {
-    if (_arrays1D.hasNext())
-        return &_arrays1D.nextArray(numSamples)[0];
-
-    return nullptr;
+void StratifiedSampler::fillArray1D(uint32, uint32 numSamples, Float* arr) {
+    nRooks(_rng, numSamples, 1, arr);
 }
 
-const Point2* StratifiedSampler::next2DArray(uint32 numSamples) {
-    if (_arrays2D.hasNext())
-        return &_arrays2D.nextArray(numSamples)[0];
-
-    return nullptr;
+void StratifiedSampler::fillArray2D(uint32, uint32 numSamples, Point2* arr) {
+    nRooks(_rng, numSamples, 2, &arr[0][0]);
 }
 
 std::unique_ptr<Sampler> StratifiedSampler::copy(uint32 seed) const {
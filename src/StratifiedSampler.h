@@ -6,7 +6,7 @@ namespace Photon {
 
     class StratifiedSampler : public Sampler {
     public:
-        StratifiedSampler(uint32 nx, uint32 ny, uint32 numDims);
+        StratifiedSampler(uint32 nx, uint32 ny, uint32 numDims, uint32 seed = 0);
 
         Float  next1D();
         Point2 next2D();
@@ -15,25 +15,27 @@ namespace Photon {
         void start(const Point2ui& pixel);
         void startSample(uint32 sample);
 
-        void allocArray1D(uint32 numSamples);
-        void allocArray2D(uint32 numSamples);
-
         void allocArray1D(std::vector<Float>& arr, uint32 numSamples) const;
         void allocArray2D(std::vector<Point2>& arr, uint32 numSamples) const;
 
-        const Float*  next1DArray(uint32 numSamples);
-        const Point2* next2DArray(uint32 numSamples);
-
         std::unique_ptr<Sampler> copy(uint32 seed) const;
 
+    protected:
+        void fillArray1D(uint32 index, uint32 numSamples, Float* arr);
+        void fillArray2D(uint32 index, uint32 numSamples, Point2* arr);
+
     private:
         uint32 _nx, _ny;
 
-        SampleArrays<Float>  _samples1D;
-        SampleArrays<Point2> _samples2D;
+        // Stratified over the samples of the pixel, one per dimension
+        std::vector<std::vector<Float>>  _samples1D;
+        std::vector<std::vector<Point2>> _samples2D;
+        uint32 _dim1D, _dim2D;
 
-        SampleArrays<Float>  _arrays1D;
-        SampleArrays<Point2> _arrays2D;
+        // Seeds of the pixel patterns and of the dimensions past them, a pixel
+        // rendered over several passes sees the samples of a single run
+        uint64 _seed;
+        uint64 _pixelSeed;
     };
 
 }
\ No newline at end of file
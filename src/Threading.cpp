@@ -37,16 +37,22 @@ void Photon::Threading::initThreads(int numThreads) {
 }
 
 void Photon::Threading::parallelFor(uint32 start, uint32 end, uint32 partitions, std::function<void(uint32)> func) {
+    parallelRange(start, end, partitions, [&func](uint32 /*partition*/, uint32 iStart, uint32 iEnd) {
+        for (uint32 i = iStart; i < iEnd; ++i)
+            func(i);
+    });
+}
+
+void Photon::Threading::parallelRange(uint32 start, uint32 end, uint32 partitions, std::function<void(uint32, uint32, uint32)> func) {
     auto taskRun = [&func, start, end](uint32 idx, uint32 /*threadId*/, uint32 num) {
         uint32 span = (end - start + num - 1) / num;
-        uint32 iStart = start + span*idx;
+        uint32 iStart = std::min(start + span*idx, end);
         uint32 iEnd = std::min(iStart + span, end);
-        for (uint32 i = iStart; i < iEnd; ++i)
-            func(i);
+        func(idx, iStart, iEnd);
     };
 
-    if (partitions == 1)
-        taskRun(0, 1, 0);
+    if (partitions <= 1)
+        taskRun(0, 0, 1);
     else
         Workers->yield(*Workers->pushTask(taskRun, partitions));
-}
+}
\ No newline at end of file
@@ -22,6 +22,10 @@ namespace Photon {
         uint32 getNumberOfProcessors();
         void initThreads(int numThreads);
         void parallelFor(uint32 start, uint32 end, uint32 partitions, std::function<void(uint32)> func);
+
+        // Splits [start, end) into contiguous ranges, handing each whole range
+        // to func(partition, rangeStart, rangeEnd), useful for reductions
+        void parallelRange(uint32 start, uint32 end, uint32 partitions, std::function<void(uint32, uint32, uint32)> func);
     }
 
 }
\ No newline at end of file
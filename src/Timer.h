@@ -4,6 +4,8 @@
 
 #ifdef PHOTON_WINDOWS
 #include <Windows.h>
+#else
+#include <chrono>
 #endif
 
 namespace Photon {
@@ -19,6 +21,9 @@ namespace Photon {
 
                 // start timer
                 QueryPerformanceCounter(&_start);
+#else
+                _start = std::chrono::high_resolution_clock::now();
+                _end   = _start;
 #endif
             }
 
@@ -33,12 +38,16 @@ namespace Photon {
 #ifdef PHOTON_WINDOWS
                 // stop timer
                 QueryPerformanceCounter(&_end);
+#else
+                _end = std::chrono::high_resolution_clock::now();
 #endif
             }
 
             double elapsed() {
 #ifdef PHOTON_WINDOWS
                 return (_end.QuadPart - _start.QuadPart) * 1000.0 / _freq.QuadPart;
+#else
+                return std::chrono::duration<double, std::milli>(_end - _start).count();
 #endif
             }
 
@@ -47,6 +56,9 @@ namespace Photon {
             LARGE_INTEGER _freq;
             LARGE_INTEGER _start;
             LARGE_INTEGER _end;
+#else
+            std::chrono::high_resolution_clock::time_point _start;
+            std::chrono::high_resolution_clock::time_point _end;
 #endif
         };
 
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+#include <PhotonMath.h>
+
+namespace Photon {
+
+    namespace Utils {
+
+        // Helpers of the text parsers, which read their files in place.
+        // None allocates, and all stop at the end of the buffer.
+
+        inline bool isBlank(char c) {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        inline void skipBlanks(const char*& ptr, const char* end) {
+            while (ptr < end && isBlank(*ptr))
+                ++ptr;
+        }
+
+        inline void skipLine(const char*& ptr, const char* end) {
+            while (ptr < end && *ptr != '\n')
+                ++ptr;
+
+            if (ptr < end)
+                ++ptr;
+        }
+
+        // Decimal number with optional fraction and exponent. Exact when the digits
+        // fit in 53 bits and the exponent is small, which covers nearly all files.
+        inline bool parseReal(const char*& ptr, const char* end, Float* val) {
+            static const double POW10[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+
+            skipBlanks(ptr, end);
+
+            bool negative = false;
+            if (ptr < end && (*ptr == '-' || *ptr == '+'))
+                negative = *ptr++ == '-';
+
+            uint64 mantissa = 0;
+            int32  exponent = 0;
+            uint32 digits   = 0;
+
+            for (; ptr < end && *ptr >= '0' && *ptr <= '9'; ++ptr, ++digits) {
+                if (mantissa < 100000000000000000ull)
+                    mantissa = mantissa * 10 + (*ptr - '0');
+                else
+                    exponent++;
+            }
+
+            if (ptr < end && *ptr == '.') {
+                for (++ptr; ptr < end && *ptr >= '0' && *ptr <= '9'; ++ptr, ++digits) {
+                    if (mantissa < 100000000000000000ull) {
+                        mantissa = mantissa * 10 + (*ptr - '0');
+                        exponent--;
+                    }
+                }
+            }
+
+            if (digits == 0)
+                return false;
+
+            if (ptr < end && (*ptr == 'e' || *ptr == 'E')) {
+                ++ptr;
+
+                bool negExp = false;
+                if (ptr < end && (*ptr == '-' || *ptr == '+'))
+                    negExp = *ptr++ == '-';
+
+                int32 exp = 0;
+                for (; ptr < end && *ptr >= '0' && *ptr <= '9'; ++ptr)
+                    exp = std::min(exp * 10 + (*ptr - '0'), 9999);
+
+                exponent += negExp ? -exp : exp;
+            }
+
+            double result = (double)mantissa;
+            if (exponent < 0 && exponent >= -22)
+                result /= POW10[-exponent];
+            else if (exponent > 0 && exponent <= 22)
+                result *= POW10[exponent];
+            else if (exponent != 0)
+                result *= std::pow(10.0, exponent);
+
+            *val = negative ? -result : result;
+            return true;
+        }
+
+        inline bool parseUInt(const char*& ptr, const char* end, uint32* val) {
+            skipBlanks(ptr, end);
+
+            if (ptr < end && *ptr == '+')
+                ++ptr;
+
+            if (ptr == end || *ptr < '0' || *ptr > '9')
+                return false;
+
+            uint64 x = 0;
+            for (; ptr < end && *ptr >= '0' && *ptr <= '9'; ++ptr)
+                x = std::min(x * 10 + (*ptr - '0'), (uint64)0xFFFFFFFF);
+
+            *val = (uint32)x;
+            return true;
+        }
+
+    }
+
+}
\ No newline at end of file
@@ -32,7 +32,7 @@ Ray Transform::operator()(const Ray& ray) const {
 Bounds3 Transform::operator()(const Bounds3& box) const {
     const Transform& Tr = *this;
 
-    Bounds3 ret(Point3(0));
+    Bounds3 ret = Bounds3::EMPTY;
     ret.expand(Tr(Point3(box[0].x, box[0].y, box[0].z)));
     ret.expand(Tr(Point3(box[1].x, box[0].y, box[0].z)));
     ret.expand(Tr(Point3(box[0].x, box[1].y, box[0].z)));
@@ -1,114 +1,364 @@
 #include <TriMesh.h>
 
+#include <vector>
+#include <algorithm>
+
+#include <Sampling.h>
+
 using namespace Photon;
 
-MeshTriangle::MeshTriangle(const TriMesh& mesh, const uint32* indices)
-    : Shape(), _mesh(&mesh), _idx(indices) { }
+// Buffers start on 16 byte boundaries within the block
+static size_t alignBuffer(size_t offset) {
+    return (offset + 15) & ~(size_t)15;
+}
 
-Bounds3 MeshTriangle::bbox() const {
-    // Retrieve vertices from mesh
-    const Point3 V0 = _mesh->vertex(_idx[0]);
-    const Point3 V1 = _mesh->vertex(_idx[1]);
-    const Point3 V2 = _mesh->vertex(_idx[2]);
+// Compressed meshes index their vertices with 16 bits when they can
+static bool useShortIndices(uint32 numVerts) {
+    return numVerts <= 0x10000;
+}
 
-    Point3 max = Math::max(V0, Math::max(V1, V2));
-    Point3 min = Math::min(V0, Math::min(V1, V2));
+size_t TriMesh::bufferSize(uint32 numFaces, uint32 numVerts, uint32 attributes) {
+    if (attributes & MESH_COMPRESSED) {
+        size_t size = alignBuffer(sizeof(MeshQuantization)) + alignBuffer(numVerts * sizeof(uint64));
 
-    Bounds3 box = Bounds3(min, max);
-    box.expand(F_EPSILON);
+        if (attributes & MESH_NORMALS)
+            size += alignBuffer(numVerts * sizeof(uint32));
+        if (attributes & MESH_TANGENTS)
+            size += alignBuffer(numVerts * sizeof(uint32));
+        if (attributes & MESH_UVS)
+            size += alignBuffer(2 * numVerts * sizeof(uint16));
 
-    return box;
+        return size + 3 * numFaces * (useShortIndices(numVerts) ? sizeof(uint16) : sizeof(uint32));
+    }
+
+    size_t size = alignBuffer(numVerts * sizeof(Point3));
+
+    if (attributes & MESH_NORMALS)
+        size += alignBuffer(numVerts * sizeof(Normal));
+    if (attributes & MESH_TANGENTS)
+        size += alignBuffer(numVerts * sizeof(Vec3));
+    if (attributes & MESH_UVS)
+        size += alignBuffer(numVerts * sizeof(Point2));
+
+    return size + 3 * numFaces * sizeof(uint32);
 }
 
-bool MeshTriangle::intersectRay(const Ray& ray, SurfaceEvent* evt) const {
-    // Moller-Trumbore ray-triangle intersection
+void TriMesh::setBuffers(uint8* buffers) {
+    _buffers = buffers;
+
+    _vertices = nullptr;
+    _normals  = nullptr;
+    _tans     = nullptr;
+    _uv       = nullptr;
+    _indices  = nullptr;
+
+    _quant          = nullptr;
+    _packedVertices = nullptr;
+    _packedNormals  = nullptr;
+    _packedTans     = nullptr;
+    _packedUv       = nullptr;
+    _shortIndices   = nullptr;
+
+    if (_attributes & MESH_COMPRESSED) {
+        _quant = (MeshQuantization*)buffers;
+        buffers += alignBuffer(sizeof(MeshQuantization));
+
+        _packedVertices = (uint64*)buffers;
+        buffers += alignBuffer(_numVertices * sizeof(uint64));
+
+        if (_attributes & MESH_NORMALS) {
+            _packedNormals = (uint32*)buffers;
+            buffers += alignBuffer(_numVertices * sizeof(uint32));
+        }
+
+        if (_attributes & MESH_TANGENTS) {
+            _packedTans = (uint32*)buffers;
+            buffers += alignBuffer(_numVertices * sizeof(uint32));
+        }
+
+        if (_attributes & MESH_UVS) {
+            _packedUv = (uint16*)buffers;
+            buffers += alignBuffer(2 * _numVertices * sizeof(uint16));
+        }
+
+        if (useShortIndices(_numVertices))
+            _shortIndices = (uint16*)buffers;
+        else
+            _indices = (uint32*)buffers;
+
+        return;
+    }
 
-    const Vec3   D = ray.dir();
-    const Point3 O = ray.origin();
+    _vertices = (Point3*)buffers;
+    buffers += alignBuffer(_numVertices * sizeof(Point3));
 
-    // Retrieve vertices from mesh
-    const Point3 V0 = _mesh->vertex(_idx[0]);
-    const Point3 V1 = _mesh->vertex(_idx[1]);
-    const Point3 V2 = _mesh->vertex(_idx[2]);
+    if (_attributes & MESH_NORMALS) {
+        _normals = (Normal*)buffers;
+        buffers += alignBuffer(_numVertices * sizeof(Normal));
+    }
 
-    // Compute triangle edges
-    Vec3 E1 = V1 - V0;
-    Vec3 E2 = V2 - V0;
+    if (_attributes & MESH_TANGENTS) {
+        _tans = (Vec3*)buffers;
+        buffers += alignBuffer(_numVertices * sizeof(Vec3));
+    }
+
+    if (_attributes & MESH_UVS) {
+        _uv = (Point2*)buffers;
+        buffers += alignBuffer(_numVertices * sizeof(Point2));
+    }
+
+    _indices = (uint32*)buffers;
+}
+
+void TriMesh::encodePositions(const Point3* verts) {
+    Bounds3 box = Bounds3::EMPTY;
+    for (uint32 v = 0; v < _numVertices; ++v)
+        box.expand(verts[v]);
+
+    _quant->origin = box.min();
+    _quant->scale  = (box.max() - box.min()) / (Float)POSITION_MAX;
+
+    for (uint32 v = 0; v < _numVertices; ++v)
+        _packedVertices[v] = quantizePosition(verts[v], *_quant);
+}
+
+void TriMesh::ownBuffers() {
+    if (!_owner)
+        return;
 
-    Vec3 P = cross(D, E2);
+    const size_t size = bufferSize(_numFaces, _numVertices, _attributes);
+    _storage = std::make_unique<uint8[]>(size);
+    memcpy(_storage.get(), _buffers, size);
+    setBuffers(_storage.get());
 
-    Float det = dot(E1, P);  
-    if (det > -F_EPSILON && det < F_EPSILON)
-        return false;
+    _pages.reset();
+    _owner.reset();
+}
+
+void TriMesh::setPageable() {
+    if (_owner && Utils::PageCache::get().enabled())
+        _pages = std::make_unique<Utils::PagedRegion>(_buffers, bufferSize(_numFaces, _numVertices, _attributes));
+}
+
+void TriMesh::touchFace(uint32 face, const MeshFace& idx) const {
+    touchPositions(face, idx);
+
+    // Remaining attribute buffers with the size of their elements
+    const std::pair<const void*, size_t> attributes[3] = {
+        _quant ? std::make_pair((const void*)_packedNormals, sizeof(uint32))
+               : std::make_pair((const void*)_normals, sizeof(Normal)),
+        _quant ? std::make_pair((const void*)_packedTans, sizeof(uint32))
+               : std::make_pair((const void*)_tans, sizeof(Vec3)),
+        _quant ? std::make_pair((const void*)_packedUv, 2 * sizeof(uint16))
+               : std::make_pair((const void*)_uv, sizeof(Point2))
+    };
+
+    for (const auto& attribute : attributes) {
+        if (!attribute.first)
+            continue;
+
+        for (uint32 c = 0; c < 3; ++c)
+            _pages->touch((const uint8*)attribute.first + idx[c] * attribute.second, attribute.second);
+    }
+}
+
+void TriMesh::touchPositions(uint32 face, const MeshFace& idx) const {
+    if (_shortIndices)
+        _pages->touch(&_shortIndices[3 * face], 3 * sizeof(uint16));
+    else
+        _pages->touch(&_indices[3 * face], 3 * sizeof(uint32));
+
+    for (uint32 c = 0; c < 3; ++c) {
+        if (_quant)
+            _pages->touch(&_packedVertices[idx[c]], sizeof(uint64));
+        else
+            _pages->touch(&_vertices[idx[c]], sizeof(Point3));
+    }
+}
+
+void TriMesh::compress() {
+    if (isCompressed())
+        return;
+
+    // The full precision buffers stay alive until they are encoded
+    const Point3* verts   = _vertices;
+    const Normal* norms   = _normals;
+    const Vec3*   tans    = _tans;
+    const Point2* uv      = _uv;
+    const uint32* indices = _indices;
+
+    std::unique_ptr<uint8[]> storage = std::move(_storage);
+    std::shared_ptr<void> owner = std::move(_owner);
+    _pages.reset();
+
+    _attributes |= MESH_COMPRESSED;
+    _storage = std::make_unique<uint8[]>(bufferSize(_numFaces, _numVertices, _attributes));
+    setBuffers(_storage.get());
+
+    encodePositions(verts);
 
-    Vec3 T = O - V0;
-    Vec3 Q = cross(T, E1);
+    for (uint32 v = 0; v < _numVertices; ++v) {
+        if (norms)
+            _packedNormals[v] = encodeOctahedral(Vec3(norms[v]));
 
-    Float invDet = 1.0 / det;
+        if (tans)
+            _packedTans[v] = encodeOctahedral(tans[v]);
 
-    Float t = dot(E2, Q) * invDet;
-    if (!ray.inRange(t))
-        return false;
+        if (uv) {
+            _packedUv[2 * v]     = floatToHalf((float)uv[v].x);
+            _packedUv[2 * v + 1] = floatToHalf((float)uv[v].y);
+        }
+    }
+
+    if (_shortIndices) {
+        for (uint32 i = 0; i < 3 * _numFaces; ++i)
+            _shortIndices[i] = (uint16)indices[i];
+    } else {
+        memcpy(_indices, indices, 3 * _numFaces * sizeof(uint32));
+    }
+}
+
+void TriMesh::setTransform(const Transform& transform) {
+    ownBuffers();
+
+    _objToWorld = transform;
+    _worldToObj = inverse(transform);
 
-    Float u = dot(T, P) * invDet;
-    if (u < 0.0 || u > 1.0)
-        return false;
+    if (isCompressed()) {
+        // The bounds change, so every position is quantized again
+        std::vector<Point3> verts(_numVertices);
+        for (uint32 v = 0; v < _numVertices; ++v)
+            verts[v] = _objToWorld(vertex(v));
 
-    Float v = dot(D, Q) * invDet;
-    if (v < 0.0 || (u + v) > 1.0)
-        return false;
+        encodePositions(verts.data());
 
-    ray.setMaxT(t);
-    evt->obj    = this;
-    evt->point  = (1.0f - u - v) * V0 + u * V1 + v * V2; //ray.hitPoint();
-    evt->normal = normalize(Normal(cross(E1, E2)));
+        for (uint32 n = 0; n < _numVertices; n++) {
+            if (_packedNormals)
+                _packedNormals[n] = encodeOctahedral(Vec3(_objToWorld(normal(n))));
 
-    // Save the (u, v) barycentric coordinates for later
-    evt->uv = Point2(u, v);
+            if (_packedTans)
+                _packedTans[n] = encodeOctahedral(_objToWorld(tangent(n)));
+        }
 
-    return true;
+        return;
+    }
+
+    for (uint32 n = 0; n < _numVertices; n++) {
+        _vertices[n] = _objToWorld(_vertices[n]);
+
+        if (_normals)
+            _normals[n] = _objToWorld(_normals[n]);
+
+        if (_tans)
+            _tans[n] = _objToWorld(_tans[n]);
+    }
 }
 
-bool MeshTriangle::isOccluded(const Ray& ray) const {
-    const Vec3   D = ray.dir();
-    const Point3 O = ray.origin();
+void TriMesh::setVertices(const Point3* verts, const Normal* norms) {
+    ownBuffers();
+
+    if (isCompressed()) {
+        encodePositions(verts);
+
+        if (norms && _packedNormals) {
+            for (uint32 n = 0; n < _numVertices; ++n)
+                _packedNormals[n] = encodeOctahedral(Vec3(norms[n]));
+        }
+    } else {
+        for (uint32 v = 0; v < _numVertices; ++v)
+            _vertices[v] = verts[v];
+
+        if (norms && _normals) {
+            for (uint32 n = 0; n < _numVertices; ++n)
+                _normals[n] = norms[n];
+        }
+    }
+
+    _version++;
+}
+
+Bounds3 TriMesh::bbox() const {
+    Bounds3 box = Bounds3::EMPTY;
+    for (uint32 v = 0; v < _numVertices; ++v)
+        box.expand(vertex(v));
+
+    box.expand(F_EPSILON);
+
+    return box;
+}
+
+Bounds3 TriMesh::faceBbox(uint32 face) const {
+    const MeshFace idx = this->face(face);
 
     // Retrieve vertices from mesh
-    const Point3 V0 = _mesh->vertex(_idx[0]);
-    const Point3 V1 = _mesh->vertex(_idx[1]);
-    const Point3 V2 = _mesh->vertex(_idx[2]);
+    const Point3 V0 = vertex(idx[0]);
+    const Point3 V1 = vertex(idx[1]);
+    const Point3 V2 = vertex(idx[2]);
 
-    // Compute triangle edges
-    Vec3 E1 = V1 - V0;
-    Vec3 E2 = V2 - V0;
+    Point3 max = Math::max(V0, Math::max(V1, V2));
+    Point3 min = Math::min(V0, Math::min(V1, V2));
+
+    Bounds3 box = Bounds3(min, max);
+    box.expand(F_EPSILON);
+
+    return box;
+}
 
-    Vec3 P = cross(D, E2);
+bool TriMesh::intersectRay(const Ray& ray, SurfaceEvent* evt) const {
+    bool hit = false;
+    for (uint32 f = 0; f < _numFaces; ++f) {
+        const MeshFace idx = face(f);
 
-    Float det = dot(E1, P);
-    if (abs(det) < F_EPSILON)
-        return false;
+        // Retrieve vertices from mesh
+        const Point3 V0 = vertex(idx[0]);
+        const Point3 V1 = vertex(idx[1]);
+        const Point3 V2 = vertex(idx[2]);
 
-    Vec3 T = O - V0;
-    Vec3 Q = cross(T, E1);
+        // Compute triangle edges
+        Vec3 E1 = V1 - V0;
+        Vec3 E2 = V2 - V0;
 
-    Float invDet = 1.0 / det;
+        Float t, u, v;
+        if (!intersectTriangle(ray, V0, E1, E2, &t, &u, &v))
+            continue;
 
-    Float t = dot(E2, Q) * invDet;
-    if (!ray.inRange(t))
-        return false;
+        ray.setMaxT(t);
+        evt->obj    = this;
+        evt->primId = f;
+        evt->point  = (1 - u - v) * V0 + u * V1 + v * V2;
+        evt->normal = normalize(Normal(cross(E1, E2)));
 
-    Float u = dot(T, P) * invDet;
-    if (u < 0 || u > 1)
-        return false;
+        // Save the (u, v) barycentric coordinates for later
+        evt->uv = Point2(u, v);
 
-    Float v = dot(D, Q) * invDet;
-    if (v < 0 || (u + v) > 1)
-        return false;
+        hit = true;
+    }
+
+    return hit;
+}
+
+bool TriMesh::isOccluded(const Ray& ray) const {
+    for (uint32 f = 0; f < _numFaces; ++f) {
+        const MeshFace idx = face(f);
+
+        // Retrieve vertices from mesh
+        const Point3 V0 = vertex(idx[0]);
+        const Point3 V1 = vertex(idx[1]);
+        const Point3 V2 = vertex(idx[2]);
+
+        Float t, u, v;
+        if (intersectTriangle(ray, V0, V1 - V0, V2 - V0, &t, &u, &v))
+            return true;
+    }
 
-    return true;
+    return false;
 }
 
-void MeshTriangle::computeSurfaceEvent(const Ray& ray, SurfaceEvent& evt) const {
+void TriMesh::computeSurfaceEvent(const Ray& ray, SurfaceEvent& evt) const {
+    const MeshFace idx = face(evt.primId);
+    if (_pages)
+        touchFace(evt.primId, idx);
+
     // Use the previously stored barycentric coordinates
     Float u = evt.uv.x;
     Float v = evt.uv.y;
@@ -118,10 +368,10 @@ void MeshTriangle::computeSurfaceEvent(const Ray& ray, SurfaceEvent& evt) const
     // Compute normal
     Normal n = evt.normal;
     
-    if (_mesh->hasNormals()) {
-        const Normal N0 = _mesh->normal(_idx[0]);
-        const Normal N1 = _mesh->normal(_idx[1]);
-        const Normal N2 = _mesh->normal(_idx[2]);
+    if (hasNormals()) {
+        const Normal N0 = normal(idx[0]);
+        const Normal N1 = normal(idx[1]);
+        const Normal N2 = normal(idx[2]);
 
         // Interpolate normal
         n = normalize((1.0f - u - v) * N0 + u * N1 + v * N2);
@@ -134,11 +384,11 @@ void MeshTriangle::computeSurfaceEvent(const Ray& ray, SurfaceEvent& evt) const
         sFrame = Frame(n);
 
         Vec3 tan, bitan;
-        if (_mesh->hasTangents()) {
+        if (hasTangents()) {
             // Compute tangent
-            const Vec3 T0 = _mesh->tangent(_idx[0]);
-            const Vec3 T1 = _mesh->tangent(_idx[1]);
-            const Vec3 T2 = _mesh->tangent(_idx[2]);
+            const Vec3 T0 = tangent(idx[0]);
+            const Vec3 T1 = tangent(idx[1]);
+            const Vec3 T2 = tangent(idx[2]);
 
             // Interpolate tangent
             tan = normalize((1 - u - v) * T0 + u * T1 + v * T2);
@@ -160,10 +410,10 @@ void MeshTriangle::computeSurfaceEvent(const Ray& ray, SurfaceEvent& evt) const
 
     // Compute UVs
     Point2 UV0, UV1, UV2;
-    if (_mesh->hasUVs()) {
-        UV0 = _mesh->uv(_idx[0]);
-        UV1 = _mesh->uv(_idx[1]);
-        UV2 = _mesh->uv(_idx[2]);
+    if (hasUVs()) {
+        UV0 = uv(idx[0]);
+        UV1 = uv(idx[1]);
+        UV2 = uv(idx[2]);
     } else {
         UV0 = Point2(0, 0);
         UV1 = Point2(1, 0);
@@ -179,67 +429,131 @@ void MeshTriangle::computeSurfaceEvent(const Ray& ray, SurfaceEvent& evt) const
     evt.sFrame = sFrame;
 }
 
-Float MeshTriangle::area() const {
-    // Retrieve vertices from mesh
-    const Point3 V0 = _mesh->vertex(_idx[0]);
-    const Point3 V1 = _mesh->vertex(_idx[1]);
-    const Point3 V2 = _mesh->vertex(_idx[2]);
+Float TriMesh::area() const {
+    Float area = 0;
+    for (uint32 f = 0; f < _numFaces; ++f)
+        area += faceArea(f);
+
+    return area;
+}
+
+Float TriMesh::faceArea(uint32 f) const {
+    const MeshFace idx = face(f);
 
     // Compute triangle edges
-    const Vec3 E1 = V1 - V0;
-    const Vec3 E2 = V2 - V0;
+    const Point3 V0 = vertex(idx[0]);
+    const Vec3 E1 = vertex(idx[1]) - V0;
+    const Vec3 E2 = vertex(idx[2]) - V0;
 
     return 0.5 * cross(E1, E2).length();
 }
 
-void MeshTriangle::samplePosition(const Point2& rand, PositionSample* sample) const {
-    // Retrieve vertices from mesh
-    const Point3 V0 = _mesh->vertex(_idx[0]);
-    const Point3 V1 = _mesh->vertex(_idx[1]);
-    const Point3 V2 = _mesh->vertex(_idx[2]);
+// Around the area weighted mean of the face normals
+void TriMesh::normalCone(Vec3* axis, Float* cosTheta) const {
+    Vec3 sum(0);
+    for (uint32 f = 0; f < _numFaces; ++f) {
+        const MeshFace idx = face(f);
+
+        const Point3 V0 = vertex(idx[0]);
+        sum += cross(vertex(idx[1]) - V0, vertex(idx[2]) - V0);
+    }
+
+    *axis     = Vec3(0, 0, 1);
+    *cosTheta = -1;
+    if (sum.lengthSqr() == 0)
+        return;
+
+    *axis     = normalize(sum);
+    *cosTheta = 1;
+    for (uint32 f = 0; f < _numFaces; ++f) {
+        const MeshFace idx = face(f);
+
+        const Point3 V0 = vertex(idx[0]);
+        const Vec3 n = cross(vertex(idx[1]) - V0, vertex(idx[2]) - V0);
+        if (n.lengthSqr() > 0)
+            *cosTheta = std::min(*cosTheta, dot(*axis, normalize(n)));
+    }
+}
+
+void TriMesh::prepareSampling() {
+    std::vector<Float> areas(_numFaces);
+    for (uint32 f = 0; f < _numFaces; ++f)
+        areas[f] = faceArea(f);
+
+    _areaDistr   = std::make_unique<DiscretePdf1D>(areas);
+    _sampledArea = _areaDistr->sum();
+}
+
+Point3 TriMesh::sampleSurface(const Point2& rand, Normal* normal) const {
+    // Pick a face by its area, what is left of the number samples within it
+    Float u;
+    const uint32 f = _areaDistr->sample(rand.x, &u);
+
+    const MeshFace idx = face(f);
+    if (_pages)
+        touchFace(f, idx);
+
+    const Point3 V0 = vertex(idx[0]);
+    const Point3 V1 = vertex(idx[1]);
+    const Point3 V2 = vertex(idx[2]);
 
-    // Compute triangle edges
     const Vec3 E1 = V1 - V0;
     const Vec3 E2 = V2 - V0;
 
-    Normal n = Normal(cross(E1, E2));
+    *normal = normalize(Normal(cross(E1, E2)));
+
+    const Point2 b = sampleUniformTriangle(Point2(u, rand.y));
+    return (1 - b.x - b.y) * V0 + b.x * V1 + b.y * V2;
+}
 
-    Point3 baryc = Point3(1 - rand.x - rand.y, rand.x, rand.y);
+void TriMesh::samplePosition(const Point2& rand, PositionSample* sample) const {
+    if (!_areaDistr || _sampledArea <= 0) {
+        sample->pdf = 0;
+        return;
+    }
 
-    sample->pdf   = 1.0 / (0.5 * n.length());
-    sample->pos   = baryc.x * V0 + baryc.y * V1 + baryc.z * V2;
+    Normal n;
+    sample->pos   = sampleSurface(rand, &n);
+    sample->pdf   = 1.0 / _sampledArea;
     sample->frame = Frame(n);
 }
 
-Float MeshTriangle::pdfPosition(const PositionSample& sample) const {
-    return 1.0 / area();
+Float TriMesh::pdfPosition(const PositionSample&) const {
+    return (_sampledArea > 0) ? 1.0 / _sampledArea : 0;
 }
 
-void MeshTriangle::sampleDirect(const Point2& rand, DirectSample* sample) const {
+void TriMesh::sampleDirect(const Point2& rand, DirectSample* sample) const {
+    if (!_areaDistr || _sampledArea <= 0) {
+        sample->pdf = 0;
+        return;
+    }
+
     const RayEvent& ref = *sample->ref;
 
-    PositionSample ps;
-    samplePosition(rand, &ps);
+    // Sample a position on the mesh
+    Normal n;
+    const Point3 pos = sampleSurface(rand, &n);
 
     // Compute direction from reference
-    const Vec3 refToPt = ps.pos - ref.point;
+    const Vec3 refToPt = pos - ref.point;
     Float distSqr = refToPt.lengthSqr();
 
     sample->dist   = sqrt(distSqr);
     sample->wi     = refToPt / sample->dist;
-    sample->normal = ps.frame.normal();
+    sample->normal = n;
 
     // Convert to solid angle density
     Float dot = absDot(sample->normal, -sample->wi);
-    sample->pdf = ps.pdf * distSqr / dot;
+    sample->pdf = (dot > 0) ? distSqr / (dot * _sampledArea) : 0;
 }
 
-Float MeshTriangle::pdfDirect(const DirectSample& sample) const {
-    Float pdfPos = 1.0 / area();
+Float TriMesh::pdfDirect(const DirectSample& sample) const {
+    if (_sampledArea <= 0)
+        return 0;
 
     // Convert area pdf to solid angle density
     Float distSqr = sample.dist * sample.dist;
     Float dot = absDot(sample.normal, -sample.wi);
 
-    return pdfPos * distSqr / dot;
+    return (dot > 0) ? distSqr / (dot * _sampledArea) : 0;
 }
\ No newline at end of file
@@ -1,144 +1,305 @@
 #pragma once
 
-#include <array>
+#include <vector>
+#include <memory>
+#include <cstring>
 
 #include <Vector.h>
 #include <Shape.h>
 #include <Transform.h>
+#include <Ray.h>
+#include <MeshCompression.h>
+#include <PageCache.h>
+#include <Distribution.h>
 
 namespace Photon {
 
-    class TriMesh;
+    // Moller-Trumbore ray-triangle test on a vertex and its two edges,
+    // returns the distance and the barycentric coordinates of the hit
+    inline bool intersectTriangle(const Ray& ray, const Point3& V0, const Vec3& E1, const Vec3& E2,
+                                  Float* t, Float* u, Float* v) {
+        const Vec3& D = ray.dir();
 
-    class MeshTriangle : public Shape {
-    public:
-        MeshTriangle(const TriMesh& mesh, const uint32* indices);
+        Vec3 P = cross(D, E2);
 
-        bool intersectRay(const Ray& ray, SurfaceEvent* evt) const;
-        bool isOccluded(const Ray& ray) const;
+        Float det = dot(E1, P);
+        if (det > -F_EPSILON && det < F_EPSILON)
+            return false;
 
-        void computeSurfaceEvent(const Ray& ray, SurfaceEvent& evt) const;
+        Float invDet = 1.0 / det;
 
-        Bounds3 bbox() const;
-        Float area() const;
+        Vec3 T = ray.origin() - V0;
+        *u = dot(T, P) * invDet;
+        if (*u < 0 || *u > 1)
+            return false;
 
-        void  samplePosition(const Point2& rand, PositionSample* sample) const;
-        Float pdfPosition(const PositionSample& sample) const;
+        Vec3 Q = cross(T, E1);
+        *v = dot(D, Q) * invDet;
+        if (*v < 0 || (*u + *v) > 1)
+            return false;
 
-        void  sampleDirect(const Point2& rand, DirectSample* sample) const;
-        Float pdfDirect(const DirectSample& sample) const;
-    private:
-        const TriMesh* _mesh;
-        const uint32*  _idx;
-        //std::array<uint32, 3> _idx;  // Triangle indices
+        *t = dot(E2, Q) * invDet;
+        return ray.inRange(*t);
+    }
+
+    // Optional vertex attributes of a mesh, and its storage
+    enum MeshAttributes {
+        MESH_NORMALS    = 1 << 0,
+        MESH_TANGENTS   = 1 << 1,
+        MESH_UVS        = 1 << 2,
+        MESH_COMPRESSED = 1 << 3
     };
 
-    class TriMesh {
+    // Vertex indices of a face
+    struct MeshFace {
+        uint32 v[3];
+
+        uint32 operator[](uint32 idx) const {
+            return v[idx];
+        }
+    };
+
+    // Triangle mesh, faces are not shapes on their own and are referenced
+    // by their index (SurfaceEvent::primId) into the mesh buffers. All
+    // buffers share a single block, either owned or mapped from a cache.
+    //
+    // Compressed meshes store positions quantized within their bounds,
+    // octahedral normals and tangents, half precision uvs and 16 bit
+    // indices when there are few enough vertices. The accessors decode
+    // them on the fly.
+    class TriMesh : public Shape {
     public:
         TriMesh(uint32 numFaces, uint32 numVerts, const uint32* indices,
                 const Point3* verts, const Normal* norms, const Vec3* tans, const Point2* uv,
                 const BSDF* bsdf, const Transform& objToWorld)
-            : _numFaces(numFaces), _numVertices(numVerts), _bsdf(bsdf),
-            _vertices(nullptr), _normals(nullptr), _tans(nullptr), _uv(nullptr),
-            _objToWorld(objToWorld), _worldToObj(inverse(objToWorld)) {
+            : Shape(objToWorld), _numFaces(numFaces), _numVertices(numVerts),
+            _attributes((norms ? MESH_NORMALS : 0) | (tans ? MESH_TANGENTS : 0) | (uv ? MESH_UVS : 0)),
+            _version(0), _sampledArea(0) {
+
+            setBsdf(bsdf);
+
+            _storage = std::make_unique<uint8[]>(bufferSize(numFaces, numVerts, _attributes));
+            setBuffers(_storage.get());
 
-            _indices = std::vector<uint32>();
-            _indices.reserve(3 * _numFaces);
-            for (uint32 i = 0; i < 3 * numFaces; i++)
-                _indices.push_back(indices[i]);
+            memcpy(_indices, indices, 3 * numFaces * sizeof(uint32));
 
-            _vertices = std::make_unique<Point3[]>(numVerts);
             for (uint32 v = 0; v < numVerts; ++v)
                 _vertices[v] = verts[v];
 
-            if (uv) {
-                _uv = std::make_unique<Point2[]>(numVerts);
-                memcpy(_uv.get(), uv, numVerts * sizeof(Point2));
-            }
+            if (uv)
+                memcpy(_uv, uv, numVerts * sizeof(Point2));
 
             if (norms) {
-                _normals = std::make_unique<Normal[]>(numVerts);
                 for (uint32 n = 0; n < numVerts; ++n)
                     _normals[n] = norms[n];
             }
 
             if (tans) {
-                _tans = std::make_unique<Vec3[]>(numVerts);
                 for (uint32 t = 0; t < numVerts; ++t)
                     _tans[t] = tans[t];
             }
         }
 
-        std::vector<std::shared_ptr<Shape>> getTris() const {
-            std::vector<std::shared_ptr<Shape>> tris;
-            tris.reserve(_numFaces);
+        // Buffers used in place, the owner keeps their memory alive
+        TriMesh(uint32 numFaces, uint32 numVerts, uint32 attributes, uint8* buffers,
+                const std::shared_ptr<void>& owner, const BSDF* bsdf, const Transform& objToWorld)
+            : Shape(objToWorld), _numFaces(numFaces), _numVertices(numVerts),
+            _attributes(attributes), _owner(owner), _version(0), _sampledArea(0) {
+
+            setBsdf(bsdf);
+            setBuffers(buffers);
+        }
+
+        // Deep copy, for placements that bake their own transform
+        TriMesh(const TriMesh& mesh)
+            : Shape(mesh._objToWorld), _numFaces(mesh._numFaces), _numVertices(mesh._numVertices),
+            _attributes(mesh._attributes), _version(0), _sampledArea(0) {
+
+            setBsdf(mesh.bsdf());
+
+            const size_t size = bufferSize(_numFaces, _numVertices, _attributes);
+            _storage = std::make_unique<uint8[]>(size);
+            memcpy(_storage.get(), mesh._buffers, size);
+            setBuffers(_storage.get());
+        }
+
+        // Bytes taken by the buffers of a mesh, laid out by setBuffers
+        static size_t bufferSize(uint32 numFaces, uint32 numVerts, uint32 attributes);
+
+        const TriMesh* triMesh() const {
+            return this;
+        }
+
+        // Tests every face, accelerators test faces individually instead
+        bool intersectRay(const Ray& ray, SurfaceEvent* evt) const;
+        bool isOccluded(const Ray& ray) const;
+
+        void computeSurfaceEvent(const Ray& ray, SurfaceEvent& evt) const;
+
+        Bounds3 bbox() const;
+        Bounds3 faceBbox(uint32 face) const;
+        Float area() const;
+        Float faceArea(uint32 face) const;
+
+        void normalCone(Vec3* axis, Float* cosTheta) const;
+
+        // Emitting meshes are sampled uniformly by area, faces are
+        // picked from an alias table over their areas
+        void prepareSampling();
+
+        void  samplePosition(const Point2& rand, PositionSample* sample) const;
+        Float pdfPosition(const PositionSample& sample) const;
+
+        void  sampleDirect(const Point2& rand, DirectSample* sample) const;
+        Float pdfDirect(const DirectSample& sample) const;
+
+        uint32 numFaces() const {
+            return _numFaces;
+        }
 
-            for (uint32 i = 0; i < _numFaces; i++) {
-                std::shared_ptr<MeshTriangle> tri = std::make_shared<MeshTriangle>(*this, &_indices[3 * i]);
-                tri->setTransform(_objToWorld, _worldToObj);
-                tri->setBsdf(_bsdf);
+        uint32 numVertices() const {
+            return _numVertices;
+        }
 
-                tris.push_back(tri);
+        MeshFace face(uint32 idx) const {
+            if (_shortIndices) {
+                const uint16* idx16 = &_shortIndices[3 * idx];
+                return { { idx16[0], idx16[1], idx16[2] } };
             }
 
-            return tris;
+            const uint32* idx32 = &_indices[3 * idx];
+            return { { idx32[0], idx32[1], idx32[2] } };
         }
 
-        const Point3& vertex(uint32 idx) const {
+        Point3 vertex(uint32 idx) const {
+            if (_quant)
+                return dequantizePosition(_packedVertices[idx], *_quant);
+
             return _vertices[idx];
         }
 
-        const Normal& normal(uint32 idx) const {
+        // First vertex and edges of a face, as the accelerators test it.
+        // Paged meshes mark the positions read as used.
+        void faceEdges(uint32 idx, Point3* v0, Vec3* e1, Vec3* e2) const {
+            const MeshFace f = face(idx);
+            if (_pages)
+                touchPositions(idx, f);
+
+            *v0 = vertex(f[0]);
+            *e1 = vertex(f[1]) - *v0;
+            *e2 = vertex(f[2]) - *v0;
+        }
+
+        Normal normal(uint32 idx) const {
+            if (_quant)
+                return Normal(decodeOctahedral(_packedNormals[idx]));
+
             return _normals[idx];
         }
 
-        const Vec3& tangent(uint32 idx) const {
+        Vec3 tangent(uint32 idx) const {
+            if (_quant)
+                return decodeOctahedral(_packedTans[idx]);
+
             return _tans[idx];
         }
 
-        const Point2& uv(uint32 idx) const {
+        Point2 uv(uint32 idx) const {
+            if (_quant)
+                return Point2(halfToFloat(_packedUv[2 * idx]), halfToFloat(_packedUv[2 * idx + 1]));
+
             return _uv[idx];
         }
 
+        uint32 attributes() const {
+            return _attributes;
+        }
+
+        // Start of the single block holding every buffer
+        const uint8* buffers() const {
+            return _buffers;
+        }
+
         bool hasNormals() const {
-            return _normals != nullptr;
+            return (_attributes & MESH_NORMALS) != 0;
         }
 
         bool hasTangents() const {
-            return _tans != nullptr;
+            return (_attributes & MESH_TANGENTS) != 0;
         }
 
         bool hasUVs() const {
-            return _uv != nullptr;
+            return (_attributes & MESH_UVS) != 0;
         }
 
-        void setTransform(const Transform& transform) {
-            _objToWorld = transform;
-
-            for (uint32 n = 0; n < _numVertices; n++) {
-                _vertices[n] = _objToWorld(_vertices[n]);
-                _normals[n]  = _objToWorld(_normals[n]);
-            }
+        bool isCompressed() const {
+            return (_attributes & MESH_COMPRESSED) != 0;
         }
 
-        void setBsdf(const BSDF* bsdf) {
-            _bsdf = bsdf;
+        // Encodes the buffers into the compressed layout, which
+        // the mesh owns from then on
+        void compress();
+
+        // Buffers mapped from a cache are released under memory pressure,
+        // the faces read by computeSurfaceEvent are tracked from then on.
+        // Writing the buffers copies them into the mesh first.
+        void setPageable();
+
+        // The transform is baked into the mesh buffers
+        void setTransform(const Transform& transform);
+
+        // Moves the vertices of a deforming mesh, the structures
+        // built over it follow on the next scene update
+        void setVertices(const Point3* verts, const Normal* norms = nullptr);
+
+        // Changes with every update of the vertices
+        uint32 version() const {
+            return _version;
         }
 
     private:
-        const uint32 _numFaces;
-        const uint32 _numVertices;
+        void setBuffers(uint8* buffers);
 
-        std::vector<uint32>       _indices;
-        std::unique_ptr<Point3[]> _vertices;
-        std::unique_ptr<Normal[]> _normals;
-        std::unique_ptr<Vec3[]>   _tans;
-        std::unique_ptr<Point2[]> _uv;
+        // Quantizes the positions within their bounds
+        void encodePositions(const Point3* verts);
 
-        Transform _objToWorld;
-        Transform _worldToObj;
+        // Copies mapped buffers so they can be modified
+        void ownBuffers();
 
-        const BSDF* _bsdf;
+        // Marks the index and vertex attributes of a face as used,
+        // or only the indices and positions read by traversal
+        void touchFace(uint32 face, const MeshFace& idx) const;
+        void touchPositions(uint32 face, const MeshFace& idx) const;
+
+        // Uniform point over the surface and the geometric normal there
+        Point3 sampleSurface(const Point2& rand, Normal* normal) const;
+
+        const uint32 _numFaces;
+        const uint32 _numVertices;
+        uint32 _attributes;
+
+        uint8*  _buffers;
+        uint32* _indices;
+        Point3* _vertices;
+        Normal* _normals;
+        Vec3*   _tans;
+        Point2* _uv;
+
+        // Buffers of a compressed mesh, the others are null
+        MeshQuantization* _quant;
+        uint64* _packedVertices;
+        uint32* _packedNormals;
+        uint32* _packedTans;
+        uint16* _packedUv;          // Two halves per vertex
+        uint16* _shortIndices;      // Used if every index fits
+
+        std::unique_ptr<uint8[]> _storage;  // Buffers owned by the mesh
+        std::shared_ptr<void>    _owner;    // Or kept alive by their source
+        std::unique_ptr<Utils::PagedRegion> _pages;
+        uint32 _version;
+
+        std::unique_ptr<DiscretePdf1D> _areaDistr;     // Built for emitting meshes
+        Float _sampledArea;
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include <TrianglePacket.h>
+
+using namespace Photon;
+
+void TrianglePacket::setLane(uint32 lane, const Primitive& prim) {
+    shapes[lane] = prim.shape;
+    faces[lane]  = prim.face;
+
+    if (!prim.isFace()) {
+        clearLane(lane);
+
+        shapes[lane] = prim.shape;
+        shapeMask |= 1 << lane;
+        return;
+    }
+
+    for (uint32 i = 0; i < 3; ++i) {
+        v0[i][lane] = prim.v0[i];
+        e1[i][lane] = prim.e1[i];
+        e2[i][lane] = prim.e2[i];
+    }
+
+    shapeMask &= ~(1 << lane);
+}
+
+void TrianglePacket::clearLane(uint32 lane) {
+    for (uint32 i = 0; i < 3; ++i) {
+        v0[i][lane] = 0;
+        e1[i][lane] = 0;
+        e2[i][lane] = 0;
+    }
+
+    shapes[lane] = nullptr;
+    faces[lane]  = PRIM_NOT_FACE;
+    shapeMask &= ~(1 << lane);
+}
+
+void TrianglePacket::setHit(uint32 lane, Float u, Float v, SurfaceEvent* evt) const {
+    const Point3 V0(v0[0][lane], v0[1][lane], v0[2][lane]);
+    const Vec3   E1(e1[0][lane], e1[1][lane], e1[2][lane]);
+    const Vec3   E2(e2[0][lane], e2[1][lane], e2[2][lane]);
+
+    evt->obj    = shapes[lane];
+    evt->primId = faces[lane];
+    evt->point  = V0 + u * E1 + v * E2;
+    evt->normal = normalize(Normal(cross(E1, E2)));
+
+    // Save the (u, v) barycentric coordinates for later
+    evt->uv = Point2(u, v);
+}
+
+void FaceRefPacket::setLane(uint32 lane, const Primitive& prim) {
+    shapes[lane] = prim.shape;
+    faces[lane]  = prim.face;
+
+    if (prim.isFace())
+        shapeMask &= ~(1 << lane);
+    else
+        shapeMask |= 1 << lane;
+}
+
+void FaceRefPacket::clearLane(uint32 lane) {
+    shapes[lane] = nullptr;
+    faces[lane]  = PRIM_NOT_FACE;
+    shapeMask &= ~(1 << lane);
+}
+
+void FaceRefPacket::decode(TrianglePacket* packet, const TriMesh* mesh) const {
+    packet->shapeMask = shapeMask;
+
+    for (uint32 lane = 0; lane < PACKET_WIDTH; ++lane) {
+        if (!shapes[lane] || (shapeMask & (1 << lane))) {
+            for (uint32 i = 0; i < 3; ++i)
+                packet->v0[i][lane] = packet->e1[i][lane] = packet->e2[i][lane] = 0;
+
+            packet->shapes[lane] = shapes[lane];
+            packet->faces[lane]  = faces[lane];
+            continue;
+        }
+
+        // Face lanes hold their mesh as the shape
+        const TriMesh* faceMesh = mesh ? mesh : static_cast<const TriMesh*>(shapes[lane]);
+
+        Point3 v0;
+        Vec3 e1, e2;
+        faceMesh->faceEdges(faces[lane], &v0, &e1, &e2);
+
+        for (uint32 i = 0; i < 3; ++i) {
+            packet->v0[i][lane] = v0[i];
+            packet->e1[i][lane] = e1[i];
+            packet->e2[i][lane] = e2[i];
+        }
+
+        packet->shapes[lane] = faceMesh;
+        packet->faces[lane]  = faces[lane];
+    }
+}
\ No newline at end of file
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <PhotonMath.h>
+#include <SIMD.h>
+#include <Primitive.h>
+#include <Ray.h>
+
+namespace Photon {
+
+    static const uint32 PACKET_WIDTH = 4;
+
+    // Primitives of a BVH leaf in groups of four, mesh faces are stored
+    // as SoA so one ray is tested against all of them at once. Lanes
+    // holding other shapes (or padding) have degenerate geometry, which
+    // the kernel always rejects.
+    struct alignas(32) TrianglePacket {
+        double v0[3][PACKET_WIDTH];
+        double e1[3][PACKET_WIDTH];
+        double e2[3][PACKET_WIDTH];
+        const Shape* shapes[PACKET_WIDTH];
+        uint32 faces[PACKET_WIDTH];
+        uint32 shapeMask;                   // Lanes intersected through the Shape interface
+
+        void setLane(uint32 lane, const Primitive& prim);
+        void clearLane(uint32 lane);
+
+        void setHit(uint32 lane, Float u, Float v, SurfaceEvent* evt) const;
+    };
+
+    // Lanes of a packet without their geometry, used by trees over
+    // compressed meshes. Faces are read back from their mesh as the
+    // leaf is visited, which costs a decode per visit but stores a
+    // fraction of the full packet.
+    struct FaceRefPacket {
+        const Shape* shapes[PACKET_WIDTH];
+        uint32 faces[PACKET_WIDTH];
+        uint32 shapeMask;
+
+        void setLane(uint32 lane, const Primitive& prim);
+        void clearLane(uint32 lane);
+
+        // Face lanes are read from the given mesh instead of their own
+        // when one is passed, as for references mapped from a cache
+        void decode(TrianglePacket* packet, const TriMesh* mesh = nullptr) const;
+    };
+
+    // Ray data broadcast to every lane, set once per traversal
+    struct PacketRay {
+        SIMD::VecD o[3];
+        SIMD::VecD d[3];
+        SIMD::VecD minT;
+
+        PacketRay(const Ray& ray) {
+            for (uint32 i = 0; i < 3; ++i) {
+                o[i] = SIMD::setD(ray.origin()[i]);
+                d[i] = SIMD::setD(ray.dir()[i]);
+            }
+
+            minT = SIMD::setD(ray.minT());
+        }
+    };
+
+    // Moller-Trumbore on every face lane, returns the valid lanes as
+    // a bit mask and leaves their distance and barycentrics in t, u and v
+    inline uint32 intersectFaces(const TrianglePacket& packet, const PacketRay& pray, Float maxT,
+                                 double* t, double* u, double* v) {
+        using namespace SIMD;
+
+        const VecD zero   = setD(0);
+        const VecD one    = setD(1);
+        const VecD eps    = setD(F_EPSILON);
+        const VecD negEps = setD(-F_EPSILON);
+        const VecD tMax   = setD(maxT);
+
+        uint32 hits = 0;
+        for (uint32 base = 0; base < PACKET_WIDTH; base += DOUBLE_WIDTH) {
+            const VecD e1x = loadD(&packet.e1[0][base]);
+            const VecD e1y = loadD(&packet.e1[1][base]);
+            const VecD e1z = loadD(&packet.e1[2][base]);
+            const VecD e2x = loadD(&packet.e2[0][base]);
+            const VecD e2y = loadD(&packet.e2[1][base]);
+            const VecD e2z = loadD(&packet.e2[2][base]);
+
+            // P = cross(D, E2)
+            const VecD px = sub(mul(pray.d[1], e2z), mul(pray.d[2], e2y));
+            const VecD py = sub(mul(pray.d[2], e2x), mul(pray.d[0], e2z));
+            const VecD pz = sub(mul(pray.d[0], e2y), mul(pray.d[1], e2x));
+
+            const VecD det = add(add(mul(e1x, px), mul(e1y, py)), mul(e1z, pz));
+            MaskD valid = maskOr(lt(det, negEps), gt(det, eps));
+
+            const VecD invDet = div(one, det);
+
+            // T = O - V0
+            const VecD tx = sub(pray.o[0], loadD(&packet.v0[0][base]));
+            const VecD ty = sub(pray.o[1], loadD(&packet.v0[1][base]));
+            const VecD tz = sub(pray.o[2], loadD(&packet.v0[2][base]));
+
+            const VecD uu = mul(add(add(mul(tx, px), mul(ty, py)), mul(tz, pz)), invDet);
+            valid = maskAnd(valid, maskAnd(ge(uu, zero), le(uu, one)));
+
+            // Q = cross(T, E1)
+            const VecD qx = sub(mul(ty, e1z), mul(tz, e1y));
+            const VecD qy = sub(mul(tz, e1x), mul(tx, e1z));
+            const VecD qz = sub(mul(tx, e1y), mul(ty, e1x));
+
+            const VecD vv = mul(add(add(mul(pray.d[0], qx), mul(pray.d[1], qy)), mul(pray.d[2], qz)), invDet);
+            valid = maskAnd(valid, maskAnd(ge(vv, zero), le(add(uu, vv), one)));
+
+            const VecD tt = mul(add(add(mul(e2x, qx), mul(e2y, qy)), mul(e2z, qz)), invDet);
+            valid = maskAnd(valid, maskAnd(gt(tt, pray.minT), lt(tt, tMax)));
+
+            uint32 bits = maskBits(valid);
+            if (bits) {
+                storeD(&t[base], tt);
+                storeD(&u[base], uu);
+                storeD(&v[base], vv);
+                hits |= bits << base;
+            }
+        }
+
+        return hits;
+    }
+
+    // Closest hit among the packet lanes, updates the ray and event
+    inline bool intersectPacket(const TrianglePacket& packet, const PacketRay& pray,
+                                const Ray& ray, SurfaceEvent* evt) {
+        alignas(32) double t[PACKET_WIDTH];
+        alignas(32) double u[PACKET_WIDTH];
+        alignas(32) double v[PACKET_WIDTH];
+
+        bool hit = false;
+
+        uint32 hits = intersectFaces(packet, pray, ray.maxT(), t, u, v);
+        if (hits) {
+            // Horizontal min over the valid lanes
+            uint32 best = PACKET_WIDTH;
+            Float  bestT = ray.maxT();
+            for (uint32 lane = 0; lane < PACKET_WIDTH; ++lane) {
+                if ((hits & (1 << lane)) && t[lane] < bestT) {
+                    bestT = t[lane];
+                    best  = lane;
+                }
+            }
+
+            ray.setMaxT(bestT);
+            packet.setHit(best, u[best], v[best], evt);
+            hit = true;
+        }
+
+        if (packet.shapeMask) {
+            for (uint32 lane = 0; lane < PACKET_WIDTH; ++lane)
+                if ((packet.shapeMask & (1 << lane)) && packet.shapes[lane]->intersectRay(ray, evt))
+                    hit = true;
+        }
+
+        return hit;
+    }
+
+    inline bool isOccludedPacket(const TrianglePacket& packet, const PacketRay& pray, const Ray& ray) {
+        alignas(32) double t[PACKET_WIDTH];
+        alignas(32) double u[PACKET_WIDTH];
+        alignas(32) double v[PACKET_WIDTH];
+
+        if (intersectFaces(packet, pray, ray.maxT(), t, u, v))
+            return true;
+
+        if (packet.shapeMask) {
+            for (uint32 lane = 0; lane < PACKET_WIDTH; ++lane)
+                if ((packet.shapeMask & (1 << lane)) && packet.shapes[lane]->isOccluded(ray))
+                    return true;
+        }
+
+        return false;
+    }
+
+}
\ No newline at end of file
@@ -1,17 +1,17 @@
 #include <UniformGrid.h>
 
 #include <unordered_map>
+#include <algorithm>
+#include <atomic>
 
 #include <Scene.h>
 #include <Bounds.h>
 #include <PhotonMath.h>
+#include <Threading.h>
 
 using namespace Photon;
 using namespace Photon::Math;
-
-void Voxel::addObject(uint32 objID) {
-    objIDs.push_back(objID);
-}
+using namespace Photon::Threading;
 
 UniformGrid::UniformGrid(const Scene& scene, const Vec3ui& dims)
     : _dims(dims), _scene(&scene) {
@@ -19,10 +19,10 @@ UniformGrid::UniformGrid(const Scene& scene, const Vec3ui& dims)
     _bounds = _scene->bounds();
 
     _invSize = _bounds.sizes().recip();
-    _numObjs = (uint32)_scene->getShapes().size();
+    gatherPrimitives(_scene->getShapes(), &_objs);
+    _numObjs = (uint32)_objs.size();
 
     _invDims = Vec3(1.0 / _dims.x, 1.0 / _dims.y, 1.0 / _dims.z);
-    _grid = std::make_unique<Voxel[]>(_dims.x * _dims.y * _dims.z);   
 }
 
 UniformGrid::UniformGrid(const Scene& scene, Float m)
@@ -32,72 +32,93 @@ UniformGrid::UniformGrid(const Scene& scene, Float m)
 
     Vec3 size = _bounds.sizes();
     _invSize  = size.recip();
-    _numObjs  = (uint32)_scene->getShapes().size();
+    gatherPrimitives(_scene->getShapes(), &_objs);
+    _numObjs  = (uint32)_objs.size();
 
     Float vol = _bounds.volume();
     Float s   = std::cbrt(vol / _numObjs);
 
     _dims     = Vec3ui(m * size.x / s + 1, m * size.y / s + 1, m * size.z / s + 1);
     _invDims  = Vec3(1.0 / _dims.x, 1.0 / _dims.y, 1.0 / _dims.z);
-
-    _grid = std::make_unique<Voxel[]>(_dims.x * _dims.y * _dims.z);
 }
 
 void UniformGrid::initialize() {
-    const auto sceneObjs = _scene->getShapes();
+    const uint32 numVoxels = _dims.x * _dims.y * _dims.z;
+    const uint32 numPartitions = Workers->numThreads() * 4;
 
-    // Initialize cells
-    for (uint32 vx = 0; vx < _dims.x; vx++) 
-        for (uint32 vy = 0; vy < _dims.y; vy++) 
-            for (uint32 vz = 0; vz < _dims.z; vz++)   
-                voxel(vx, vy, vz) = Voxel();
+    _unboundedObjs.clear();
 
-    // Build object list and set them into their cells
-    _objs = std::make_unique<GridObject[]>(_numObjs);
-    for (uint32 id = 0; id < _numObjs; id++) {
-        _objs[id] = sceneObjs[id];
+    // Find the voxel range each object overlaps
+    std::vector<Vec3ui> idxMin(_numObjs), idxMax(_numObjs);
+    std::vector<uint8>  bounded(_numObjs);
 
-        Bounds3 objBbox = _objs[id]->bbox();
+    Vec3 scale = Vec3(_dims) * _invSize;
+    parallelFor(0, _numObjs, numPartitions, [&](uint32 id) {
+        Bounds3 objBbox = _objs[id].bbox();
 
         // Check if object is unbounded
-        if (!objBbox.isBounded()) {
-            _unboundedObjs.push_back(_objs[id]);
-
-            // Go to next
-            continue;
-        }
+        bounded[id] = objBbox.isBounded();
+        if (!bounded[id])
+            return;
         
         // Get indices of object bbox on grid 
         // (note that this is a vectorial clamp)
-        Vec3   scale  = Vec3(_dims) * _invSize;
-        Vec3ui idxMin = Math::clamp<uint32>(floor((objBbox.min() - _bounds.min()) * scale), 0, _dims - 1);
-        Vec3ui idxMax = Math::clamp<uint32>(ceil((objBbox.max() - _bounds.min()) * scale), 0, _dims - 1);
-
-        // Set each object in respective voxels
-        for (uint32 ix = idxMin.x; ix <= idxMax.x; ix++)
-            for (uint32 iy = idxMin.y; iy <= idxMax.y; iy++)
-                for (uint32 iz = idxMin.z; iz <= idxMax.z; iz++)
-                    voxel(ix, iy, iz).addObject(id); 
-    }
-}
+        idxMin[id] = Math::clamp<uint32>(floor((objBbox.min() - _bounds.min()) * scale), 0, _dims - 1);
+        idxMax[id] = Math::clamp<uint32>(ceil((objBbox.max() - _bounds.min()) * scale), 0, _dims - 1);
+    });
 
-Voxel& UniformGrid::voxel(uint32 x, uint32 y, uint32 z) {
-    return _grid[x + _dims.x * y + _dims.x * _dims.y * z];
-}
+    for (uint32 id = 0; id < _numObjs; id++)
+        if (!bounded[id])
+            _unboundedObjs.push_back(_objs[id]);
 
-const Voxel& UniformGrid::voxel(uint32 x, uint32 y, uint32 z) const {
-    return _grid[x + _dims.x * y + _dims.x * _dims.y * z];
-}
+    // Count objects per voxel
+    std::unique_ptr<std::atomic<uint32>[]> counts(new std::atomic<uint32>[numVoxels]);
+    parallelFor(0, numVoxels, numPartitions, [&](uint32 v) {
+        counts[v].store(0, std::memory_order_relaxed);
+    });
+
+    parallelFor(0, _numObjs, numPartitions, [&](uint32 id) {
+        if (!bounded[id])
+            return;
+
+        for (uint32 ix = idxMin[id].x; ix <= idxMax[id].x; ix++)
+            for (uint32 iy = idxMin[id].y; iy <= idxMax[id].y; iy++)
+                for (uint32 iz = idxMin[id].z; iz <= idxMax[id].z; iz++)
+                    counts[voxelIndex(ix, iy, iz)].fetch_add(1, std::memory_order_relaxed);
+    });
+
+    // Turn counts into offsets, the counters become each voxel's fill cursor
+    _voxelOffsets.resize(numVoxels + 1);
+    _voxelOffsets[0] = 0;
+    for (uint32 v = 0; v < numVoxels; v++) {
+        _voxelOffsets[v + 1] = _voxelOffsets[v] + counts[v].load(std::memory_order_relaxed);
+        counts[v].store(_voxelOffsets[v], std::memory_order_relaxed);
+    }
 
-const Voxel& UniformGrid::voxel(const Point3& pos) const {
-    Vec3 loc = (pos - _bounds.min()) * _dims * _invSize;
-    Vec3ui cell = Math::clamp<uint32>(loc, 0, _dims - 1);
+    // Set each object in respective voxels
+    _voxelObjs.resize(_voxelOffsets[numVoxels]);
+    parallelFor(0, _numObjs, numPartitions, [&](uint32 id) {
+        if (!bounded[id])
+            return;
+
+        for (uint32 ix = idxMin[id].x; ix <= idxMax[id].x; ix++)
+            for (uint32 iy = idxMin[id].y; iy <= idxMax[id].y; iy++)
+                for (uint32 iz = idxMin[id].z; iz <= idxMax[id].z; iz++)
+                    _voxelObjs[counts[voxelIndex(ix, iy, iz)].fetch_add(1, std::memory_order_relaxed)] = id;
+    });
+
+    // Insertion order depends on scheduling, sort each voxel to keep it deterministic
+    parallelFor(0, numVoxels, numPartitions, [&](uint32 v) {
+        std::sort(_voxelObjs.begin() + _voxelOffsets[v], _voxelObjs.begin() + _voxelOffsets[v + 1]);
+    });
+}
 
-    return voxel(cell.x, cell.y, cell.z);
+uint32 UniformGrid::voxelIndex(uint32 x, uint32 y, uint32 z) const {
+    return x + _dims.x * y + _dims.x * _dims.y * z;
 }
 
-const Voxel& UniformGrid::voxel(const Point3ui& pt) const {
-    return _grid[pt.x + _dims.x * pt.y + _dims.x * _dims.y * pt.z];
+uint32 UniformGrid::voxelIndex(const Point3ui& pt) const {
+    return pt.x + _dims.x * pt.y + _dims.x * _dims.y * pt.z;
 }
 
 bool UniformGrid::gridLocate(const Point3& worldPos, Point3ui* pt) const {
@@ -130,6 +151,10 @@ bool UniformGrid::contains(const Point3& pos) const {
     return _bounds.contains(pos);
 }
 
+Bounds3 UniformGrid::bounds() const {
+    return _bounds;
+}
+
 bool UniformGrid::intersectRay(const Ray& ray, SurfaceEvent* evt) const {
     // Intersection cache, renewed per ray
     //std::unordered_map<uint32, bool> intersectMap;
@@ -166,8 +191,10 @@ bool UniformGrid::intersectRay(const Ray& ray, SurfaceEvent* evt) const {
     do {
         min = t.minDim(); // Get component with smallest value
 
-        const Voxel& vox = voxel(pt);
-        if (vox.hasObjects()) {
+        uint32 vox   = voxelIndex(pt);
+        uint32 first = _voxelOffsets[vox];
+        uint32 last  = _voxelOffsets[vox + 1];
+        if (first < last) {
             /*for (uint32 id : vox.objIDs) {
                 // Only test intersection if not already
                 /*if (intersectMap.find(id) == intersectMap.end()) {
@@ -178,8 +205,8 @@ bool UniformGrid::intersectRay(const Ray& ray, SurfaceEvent* evt) const {
             /*    _objs[id]->intersectRay(ray, evt);
             }*/
 
-            for (uint32 idx = 0; idx < vox.objIDs.size(); ++idx)
-                _objs[vox.objIDs[idx]]->intersectRay(ray, evt);
+            for (uint32 idx = first; idx < last; ++idx)
+                _objs[_voxelObjs[idx]].intersectRay(ray, evt);
               
             /*for (uint32 idx = 0; idx < vox.objIDs.size(); ++idx) {
                 uint32 id = vox.objIDs[idx];
@@ -244,10 +271,12 @@ bool UniformGrid::isOccluded(const Ray& ray) const {
     do {
         min = t.minDim(); // Get component with smallest value
         
-        const Voxel& vox = voxel(pt);
-        if (vox.hasObjects()) {
-            for (uint32 idx = 0; idx < vox.objIDs.size(); ++idx)
-                if (_objs[vox.objIDs[idx]]->isOccluded(ray))
+        uint32 vox   = voxelIndex(pt);
+        uint32 first = _voxelOffsets[vox];
+        uint32 last  = _voxelOffsets[vox + 1];
+        if (first < last) {
+            for (uint32 idx = first; idx < last; ++idx)
+                if (_objs[_voxelObjs[idx]].isOccluded(ray))
                     return true;
 
             /*for (uint32 idx = 0; idx < vox.objIDs.size(); ++idx) {
@@ -1,29 +1,21 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
+#include <Accelerator.h>
 #include <Bounds.h>
 #include <Shape.h>
+#include <Primitive.h>
 
 namespace Photon {
 
     // Forward declaration
     class Scene;
 
-    typedef std::shared_ptr<Shape> GridObject;
+    typedef Primitive GridObject;
 
-    struct Voxel {
-        Voxel() : objIDs(0) { }
-
-        void addObject(uint32 objID);
-        bool hasObjects() const {
-            return objIDs.size() > 0;
-        }
-
-        std::vector<uint32> objIDs;
-    };
-
-    class UniformGrid {
+    class UniformGrid : public Accelerator {
     public:
         UniformGrid(const Scene& scene, const Vec3ui& dims);
         UniformGrid(const Scene& scene, Float m = 1);
@@ -32,22 +24,25 @@ namespace Photon {
         bool contains(const Point3& pos) const;
         bool intersectRay(const Ray& ray, SurfaceEvent* evt) const;
         bool isOccluded(const Ray& ray) const;
+        Bounds3 bounds() const;
 
     private:
-        Voxel& voxel(uint32 x, uint32 y, uint32 z);
-        const Voxel& voxel(uint32 x, uint32 y, uint32 z) const;
-        const Voxel& voxel(const Point3& pos) const;
-        const Voxel& voxel(const Point3ui& pt) const;
+        uint32 voxelIndex(uint32 x, uint32 y, uint32 z) const;
+        uint32 voxelIndex(const Point3ui& pt) const;
         bool gridLocate(const Point3& worldPos, Point3ui* pt) const;
         bool gridLocate(const Ray& ray, Point3ui* pt) const;
 
         // Objects only get stored once in the grid and are
         // referenced by their ID (implied by the position on the array)
-        std::unique_ptr<GridObject[]> _objs;
-        std::unique_ptr<Voxel[]> _grid;
+        std::vector<GridObject> _objs;
+
+        // Voxel contents are packed in a single array, voxel i owns the
+        // IDs in [_voxelOffsets[i], _voxelOffsets[i + 1])
+        std::vector<uint32> _voxelOffsets;
+        std::vector<uint32> _voxelObjs;
         std::vector<GridObject> _unboundedObjs;
         Scene const* _scene;
-        uint32 _numObjs;              // Number of objects in scene
+        uint32 _numObjs;              // Number of objects in scene (mesh faces count individually)
         Bounds3 _bounds;              // Bounds of the grid
         Vec3ui _dims;                 // Number of voxels in each axis
         Vec3 _invSize;                // Inverse of size in each dimension (world units)
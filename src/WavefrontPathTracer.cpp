@@ -0,0 +1,408 @@
+#include <WavefrontPathTracer.h>
+
+#include <algorithm>
+#include <functional>
+
+#include <Scene.h>
+#include <Camera.h>
+#include <Light.h>
+#include <RayBatch.h>
+#include <Threading.h>
+
+using namespace Photon;
+using namespace Photon::Threading;
+using namespace std::placeholders;
+
+// Queue entries handled by each partition of a stage, at least
+static const uint32 WAVEFRONT_PARTITION_SIZE = 256;
+
+static uint32 numPartitions(uint32 numItems) {
+    return std::min(Workers->numThreads() * 4, (numItems + WAVEFRONT_PARTITION_SIZE - 1) / WAVEFRONT_PARTITION_SIZE);
+}
+
+void WavefrontPathTracer::PathQueue::resize(uint32 size) {
+    rays.resize(size);
+    events.resize(size);
+    beta.resize(size);
+    Li.resize(size);
+    refrScale.resize(size);
+    rngs.resize(size);
+    pixels.resize(size);
+    pFilm.resize(size);
+    depth.resize(size);
+    specular.resize(size);
+    alive.resize(size);
+    recordFeature.resize(size);
+    features.resize(size);
+    dlStats.resize(size);
+}
+
+void WavefrontPathTracer::startRender(EndCallback endCallback) {
+    // Tiles are rendered in parallel, and so are the stages within each
+    _renderTask = Threading::Workers->pushTask(
+        std::bind(&WavefrontPathTracer::renderTile, this, _1),
+        uint32(_tiles.size()),
+        endCallback
+    );
+}
+
+void WavefrontPathTracer::renderTile(uint32 tileId) const {
+    const ImageTile& tile = _tiles[tileId];
+    Sampler& sampler = *tile.samp.get();
+
+    const Camera& camera = _scene->getCamera();
+    FilmTile filmTile = camera.film().tile(Point2ui(tile.x, tile.y), Vec2ui(tile.w, tile.h));
+
+    const uint32 spp = sampler.spp();
+    const uint32 numPixels = tile.w * tile.h;
+    const uint32 pixelsPerWave = std::max(1u, WAVEFRONT_QUEUE_SIZE / spp);
+
+    PathQueue queue;
+    std::vector<uint32> active;
+    std::vector<ShadowSample> shadows;
+
+    for (uint32 firstPixel = 0; firstPixel < numPixels; firstPixel += pixelsPerWave) {
+        const uint32 wavePixels = std::min(pixelsPerWave, numPixels - firstPixel);
+
+        queue.resize(wavePixels * spp);
+        active.clear();
+
+        // Camera rays are drawn from the tile's sampler, the samples of
+        // later bounces from a random sequence unique to each path
+        for (uint32 p = 0; p < wavePixels; ++p) {
+            const Point2ui pixel(tile.x + (firstPixel + p) % tile.w,
+                                 tile.y + (firstPixel + p) / tile.w);
+
+            sampler.start(pixel);
+            for (uint32 s = 0; s < spp; ++s) {
+                sampler.startSample(s);
+
+                const uint32 path = p * spp + s;
+                const uint64 seq  = ((uint64)pixel.y * camera.width() + pixel.x) * spp + s;
+
+                queue.rays[path]      = camera.primaryRay(pixel, sampler, &queue.pFilm[path]);
+                queue.beta[path]      = Color(1.0);
+                queue.Li[path]        = Color::BLACK;
+                queue.refrScale[path] = 1.0;
+                queue.rngs[path]      = RandGen(mixBits(seq), seq);
+                queue.pixels[path]    = pixel;
+                queue.depth[path]     = 1;
+                queue.specular[path]  = false;
+                queue.alive[path]     = true;
+
+                active.push_back(path);
+            }
+        }
+
+        // Advance every live path one bounce per iteration
+        while (!active.empty()) {
+            extend(queue, active);
+            shade(queue, active, shadows);
+            traceShadows(queue, shadows);
+
+            // Primary hit features need the visibility of their shadow rays
+            for (uint32 path : active) {
+                if (!queue.recordFeature[path])
+                    continue;
+
+                FeaturesRecord& feat = queue.features[path];
+                const DirectIllumStats& dlStats = queue.dlStats[path];
+                if (dlStats.numRays > 0)
+                    feat.vis = (Float)dlStats.numUnoccluded / dlStats.numRays;
+
+                camera.film().addFeatureSample(feat);
+            }
+
+            // Drop finished paths, keeping the pixel order that makes batches coherent
+            uint32 numActive = 0;
+            for (uint32 path : active)
+                if (queue.alive[path])
+                    active[numActive++] = path;
+
+            active.resize(numActive);
+        }
+
+        // Record samples on the tile
+        for (uint32 p = 0; p < wavePixels; ++p) {
+            const Point2ui& pixel = queue.pixels[p * spp];
+
+            Color color = Color::BLACK;
+            for (uint32 s = 0; s < spp; ++s) {
+                const Color& Li = queue.Li[p * spp + s];
+
+                filmTile.addSample(queue.pFilm[p * spp + s], Li);
+                color += Li;
+            }
+
+            // Use a box filter for the preview
+            camera.film().addPreviewSample(pixel.x, pixel.y, color / spp);
+        }
+    }
+
+    camera.film().mergeTile(filmTile);
+}
+
+void WavefrontPathTracer::extend(PathQueue& queue, const std::vector<uint32>& active) const {
+    const uint32 numRays    = (uint32)active.size();
+    const uint32 numBatches = (numRays + RAY_BATCH_SIZE - 1) / RAY_BATCH_SIZE;
+
+    parallelRange(0, numBatches, numPartitions(numRays), [&](uint32 /*partition*/, uint32 start, uint32 end) {
+        RayBatch batch;
+        HitBatch hits;
+
+        for (uint32 b = start; b < end; ++b) {
+            const uint32 first = b * RAY_BATCH_SIZE;
+            const uint32 count = std::min(RAY_BATCH_SIZE, numRays - first);
+
+            batch.clear();
+            for (uint32 i = 0; i < count; ++i)
+                batch.add(queue.rays[active[first + i]]);
+
+            _scene->intersectRays(batch, &hits);
+
+            for (uint32 i = 0; i < count; ++i)
+                queue.events[active[first + i]] = hits.events[i];
+        }
+    });
+}
+
+void WavefrontPathTracer::shade(PathQueue& queue, const std::vector<uint32>& active, std::vector<ShadowSample>& shadows) const {
+    const uint32 numPaths   = (uint32)active.size();
+    const uint32 maxShadows = lightSamplesPerPath();
+
+    // Group paths by the type of BSDF they hit, so materials shaded alike
+    // run together, then by the BSDF itself. Misses come first.
+    struct ShadeKey {
+        uint32 type;
+        const BSDF* bsdf;
+        uint32 path;
+    };
+
+    std::vector<ShadeKey> order(numPaths);
+    for (uint32 i = 0; i < numPaths; ++i) {
+        const SurfaceEvent& event = queue.events[active[i]];
+        const BSDF* bsdf = event.hit() ? event.obj->bsdf() : nullptr;
+        order[i] = { bsdf ? (uint32)bsdf->type() : 0, bsdf, active[i] };
+    }
+
+    std::sort(order.begin(), order.end(), [](const ShadeKey& a, const ShadeKey& b) {
+        if (a.type != b.type)
+            return a.type < b.type;
+        if (a.bsdf != b.bsdf)
+            return std::less<const BSDF*>()(a.bsdf, b.bsdf);
+
+        return a.path < b.path;
+    });
+
+    // Each path owns a slot per light sample, so shading needs no synchronization
+    shadows.resize(numPaths * maxShadows);
+
+    parallelRange(0, numPaths, numPartitions(numPaths), [&](uint32 /*partition*/, uint32 start, uint32 end) {
+        for (uint32 i = start; i < end; ++i)
+            shadePath(queue, order[i].path, shadows.data() + i * maxShadows);
+    });
+}
+
+void WavefrontPathTracer::traceShadows(PathQueue& queue, std::vector<ShadowSample>& shadows) const {
+    // Only samples with a contribution need a shadow ray
+    uint32 numRays = 0;
+    for (const ShadowSample& sample : shadows)
+        if (!sample.contrib.isBlack())
+            shadows[numRays++] = sample;
+
+    shadows.resize(numRays);
+
+    const uint32 numBatches = (numRays + RAY_BATCH_SIZE - 1) / RAY_BATCH_SIZE;
+    std::vector<uint32> occluded(numBatches);
+
+    parallelRange(0, numBatches, numPartitions(numRays), [&](uint32 /*partition*/, uint32 start, uint32 end) {
+        RayBatch batch;
+
+        for (uint32 b = start; b < end; ++b) {
+            const uint32 first = b * RAY_BATCH_SIZE;
+            const uint32 count = std::min(RAY_BATCH_SIZE, numRays - first);
+
+            batch.clear();
+            for (uint32 i = 0; i < count; ++i)
+                batch.add(shadows[first + i].ray);
+
+            occluded[b] = _scene->occludedRays(batch);
+        }
+    });
+
+    // Paths may own several samples, accumulate them serially
+    for (uint32 i = 0; i < numRays; ++i) {
+        if (occluded[i / RAY_BATCH_SIZE] & (1u << (i % RAY_BATCH_SIZE)))
+            continue;
+
+        const ShadowSample& sample = shadows[i];
+        queue.Li[sample.path] += sample.contrib;
+        queue.dlStats[sample.path].numUnoccluded++;
+    }
+}
+
+// Samples taken of a light when all of them are sampled, as estimateDirectAll does
+static uint32 lightSamples(const Light& light) {
+    return light.isDelta() ? 1 : std::max(light.numSamples(), 1u);
+}
+
+uint32 WavefrontPathTracer::lightSamplesPerPath() const {
+    if (_scene->lightStrategy() == ALL_LIGHTS || !_scene->lightDistribution()) {
+        uint32 numSamples = 0;
+        for (const Light* light : _scene->getLights())
+            numSamples += lightSamples(*light);
+
+        return numSamples;
+    }
+
+    return 1;
+}
+
+void WavefrontPathTracer::shadePath(PathQueue& queue, uint32 path, ShadowSample* shadows) const {
+    const Ray& ray = queue.rays[path];
+    const SurfaceEvent& event = queue.events[path];
+    const RandGen& rng = queue.rngs[path];
+
+    Color& Li   = queue.Li[path];
+    Color& beta = queue.beta[path];
+
+    const uint32 maxShadows = lightSamplesPerPath();
+    for (uint32 l = 0; l < maxShadows; ++l) {
+        shadows[l].contrib = Color::BLACK;
+        shadows[l].path    = path;
+    }
+
+    queue.recordFeature[path] = false;
+    queue.dlStats[path] = DirectIllumStats();
+
+    if (!event.hit()) {
+        // If this was a primary ray or
+        // If we just left a specular material, return the background color
+        if (ray.isPrimary() || queue.specular[path])
+            Li += beta * _scene->getBackgroundColor();
+
+        queue.alive[path] = false;
+        return;
+    }
+
+    // Check if intersected object is self emissive and add its contribution
+    if (ray.isPrimary() && event.obj->isLight())
+        Li += beta * event.emission(-ray.dir());
+
+    // Fetch intersection's BSDF
+    const BSDF* bsdf = event.obj->bsdf();
+    if (!bsdf || bsdf->isType(BSDFType::NONE) ||
+        dot(event.normal, -ray.dir()) * Frame::cosTheta(event.wo) <= 0) {
+        queue.alive[path] = false;
+        return;
+    }
+
+    queue.specular[path] = bsdf->isType(BSDFType::SPECULAR);
+
+    /* -----------------------------------------------------------------------------------
+            Direct Illumination
+    --------------------------------------------------------------------------------------*/
+    // The light sampling half of each sample waits in the shadow queue,
+    // with every light sampled in turn and its samples averaged
+    DirectIllumStats& dlStats = queue.dlStats[path];
+    auto sampleDirect = [&](const Light& light, uint32 nSamples, ShadowSample* lightShadows) {
+        const Color weight = beta / nSamples;
+
+        for (uint32 s = 0; s < nSamples; ++s) {
+            const Point2 ls = rng.uniform2D();
+            const Point2 bs = rng.uniform2D();
+
+            Ray shadowRay;
+            Color Ld = sampleLightSource(light, event, ls, &shadowRay);
+            if (!Ld.isBlack()) {
+                lightShadows[s].ray     = shadowRay;
+                lightShadows[s].contrib = weight * Ld;
+            }
+
+            Li += weight * sampleLightBsdf(light, event, bs);
+        }
+
+        dlStats.numLights++;
+        dlStats.numRays += nSamples;
+    };
+
+    if (_scene->lightStrategy() == ALL_LIGHTS || !_scene->lightDistribution()) {
+        uint32 first = 0;
+        for (const Light* light : _scene->getLights()) {
+            const uint32 nSamples = lightSamples(*light);
+            sampleDirect(*light, nSamples, &shadows[first]);
+            first += nSamples;
+        }
+    } else {
+        // A single light, the BSDF sample counts whichever light it hits
+        Float lightPdf = 1;
+        const Light* light = _scene->sampleLight(event, rng.uniform1D(), &lightPdf);
+
+        const Point2 ls = rng.uniform2D();
+        const Point2 bs = rng.uniform2D();
+
+        if (light && lightPdf > 0) {
+            Ray shadowRay;
+            Color Ld = sampleLightSource(*light, event, ls, &shadowRay, lightPdf);
+            if (!Ld.isBlack()) {
+                shadows[0].ray     = shadowRay;
+                shadows[0].contrib = beta * Ld;
+            }
+
+            dlStats.numLights++;
+            dlStats.numRays++;
+        }
+
+        if (_scene->hasAreaLights())
+            Li += beta * sampleEmitterBsdf(event, bs);
+    }
+
+    /* -----------------------------------------------------------------------------------
+            Indirect Illumination
+    --------------------------------------------------------------------------------------*/
+    // Sample a direction from the BSDF
+    BSDFSample sample(event);
+    Color f = bsdf->sample(rng.uniform2D(), &sample);
+
+    // Leave if no contribution from sampled direction
+    if (sample.pdf == 0 || f.isBlack()) {
+        queue.alive[path] = false;
+        return;
+    }
+
+    // If we just sampled refraction, keep track of radiance scaling
+    if (hasType(sample.type, BSDFType(BSDFType::REFRACTION)))
+        queue.refrScale[path] *= sample.eta * sample.eta;
+
+    // Update the throughput
+    beta *= f * Frame::absCosTheta(sample.wi) / sample.pdf;
+
+    // Possibly end path with russian roulette
+    Float rr = (queue.refrScale[path] * beta).max();
+    if (queue.depth[path] > 4 && rr < 0.8) {
+        Float q = Math::max(0.01, 1.0 - rr);
+        if (rng.uniform1D() < q) {
+            queue.alive[path] = false;
+            return;
+        }
+
+        beta /= (1 - q);
+    }
+
+    // Store primary ray's scene features, recorded once shadow rays are traced
+    if (ray.isPrimary()) {
+        FeaturesRecord& feat = queue.features[path];
+        feat = FeaturesRecord();
+        feat.dist   = (ray.origin() - event.point).length();
+        feat.raster = Point2(queue.pixels[path].x, queue.pixels[path].y);
+        feat.normal = event.sFrame.normal();
+
+        queue.recordFeature[path] = true;
+    }
+
+    // Spawn a new ray in the sampled direction
+    queue.rays[path] = event.spawnRay(event.toWorld(sample.wi));
+
+    if (++queue.depth[path] > _maxDepth)
+        queue.alive[path] = false;
+}
\ No newline at end of file
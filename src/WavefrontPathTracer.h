@@ -0,0 +1,66 @@
+#pragma once
+
+#include <PhotonMath.h>
+#include <Integrator.h>
+#include <Ray.h>
+#include <Random.h>
+#include <Film.h>
+
+namespace Photon {
+
+    // Paths alive at once in a tile, each wave holds as many whole pixels as fit
+    static const uint32 WAVEFRONT_QUEUE_SIZE = 16 * 1024;
+
+    // Path tracer that advances all paths of a wave one bounce at a time, through
+    // separate stages for extension rays, shading, shadow rays and film writes.
+    // Each stage runs over the whole queue, so rays are traced in full batches
+    // and paths hitting the same BSDF are shaded together.
+    class WavefrontPathTracer : public Integrator {
+    public:
+        WavefrontPathTracer(const Scene& scene)
+            : Integrator(scene), _maxDepth(8) { }
+
+        void startRender(EndCallback endCallback = EndCallback());
+
+    private:
+        // Path states of a wave, as a structure of arrays
+        struct PathQueue {
+            std::vector<Ray>            rays;
+            std::vector<SurfaceEvent>   events;
+            std::vector<Color>          beta;       // Path throughput
+            std::vector<Color>          Li;
+            std::vector<Float>          refrScale;  // Refraction scaling
+            std::vector<RandGen>        rngs;       // Samples past the camera ray
+            std::vector<Point2ui>       pixels;
+            std::vector<Point2>         pFilm;      // Film position of the camera ray
+            std::vector<uint32>         depth;
+            std::vector<uint8>          specular;   // Last bounce was specular
+            std::vector<uint8>          alive;
+            std::vector<uint8>          recordFeature;
+            std::vector<FeaturesRecord> features;   // Primary hit features
+            std::vector<DirectIllumStats> dlStats;
+
+            void resize(uint32 size);
+        };
+
+        // Light sample waiting for its shadow ray
+        struct ShadowSample {
+            Ray    ray;
+            Color  contrib;
+            uint32 path;
+        };
+
+        void renderTile(uint32 tileId) const;
+
+        void extend(PathQueue& queue, const std::vector<uint32>& active) const;
+        void shade(PathQueue& queue, const std::vector<uint32>& active, std::vector<ShadowSample>& shadows) const;
+        void traceShadows(PathQueue& queue, std::vector<ShadowSample>& shadows) const;
+
+        // Shades a single path, leaving its light samples in shadows
+        void shadePath(PathQueue& queue, uint32 path, ShadowSample* shadows) const;
+        uint32 lightSamplesPerPath() const;
+
+        uint32 _maxDepth;
+    };
+
+}
\ No newline at end of file
@@ -28,6 +28,8 @@ void WhittedRayTracer::renderTile(uint32 tId, uint32 tileId) const {
     Sampler& sampler = *tile.samp.get();
 
     const Camera& camera = _scene->getCamera();
+    FilmTile filmTile = camera.film().tile(Point2ui(tile.x, tile.y), Vec2ui(tile.w, tile.h));
+
     for (uint32 y = 0; y < tile.h; ++y) {
         for (uint32 x = 0; x < tile.w; ++x) {
             Point2ui pixel(x + tile.x, y + tile.y);
@@ -39,11 +41,12 @@ void WhittedRayTracer::renderTile(uint32 tId, uint32 tileId) const {
             for (uint32 s = 0; s < sampler.spp(); ++s) {
                 sampler.startSample(s);
 
-                const Ray ray = camera.primaryRay(pixel, sampler);
+                Point2 pFilm;
+                const Ray ray = camera.primaryRay(pixel, sampler, &pFilm);
                 Color Li = traceRay(ray, 1, sampler, pixel);
 
-                // Record sample on camera's film
-                camera.film().addColorSample(pixel.x, pixel.y, Li);
+                // Record sample on the tile
+                filmTile.addSample(pFilm, Li);
 
                 color += Li;
             }
@@ -53,6 +56,8 @@ void WhittedRayTracer::renderTile(uint32 tId, uint32 tileId) const {
             camera.film().addPreviewSample(pixel.x, pixel.y, color);
         }
     }
+
+    camera.film().mergeTile(filmTile);
 }
 
 // Whitted algorithm
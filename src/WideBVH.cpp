@@ -0,0 +1,277 @@
+#include <WideBVH.h>
+
+#include <limits>
+
+using namespace Photon;
+using namespace Photon::SIMD;
+
+// Widens the exit distances to make up for single precision rounding
+static const float WBVH_FAR_SCALE = 1.0f + 4.0f * std::numeric_limits<float>::epsilon();
+
+namespace {
+
+    // Ray data broadcast to every child slot
+    struct WideRay {
+        VecF origin[3];
+        VecF invDir[3];
+        VecF padNear[3];    // Moves near planes away from the ray, covering
+        VecF padFar[3];     // the rounding of its origin to single precision
+        uint32 dirIsNeg[3];
+        float minT;
+
+        WideRay(const Ray& ray) {
+            const Point3& o = ray.origin();
+            float pad = std::max(std::abs(o.x), std::max(std::abs(o.y), std::abs(o.z))) *
+                        std::numeric_limits<float>::epsilon();
+
+            for (uint32 i = 0; i < 3; ++i) {
+                // The sign comes from the inverse, as in the binary BVH, so
+                // a -0 component agrees with its infinite inverse
+                const Float inv = 1.0 / ray.dir()[i];
+
+                dirIsNeg[i] = inv < 0;
+                origin[i]   = setF((float)o[i]);
+                invDir[i]   = setF((float)inv);
+                padNear[i]  = setF(dirIsNeg[i] ? pad : -pad);
+                padFar[i]   = setF(dirIsNeg[i] ? -pad : pad);
+            }
+
+            minT = floatRoundDown(ray.minT());
+        }
+    };
+
+    struct StackEntry {
+        uint32 idx;
+        uint32 numPrims;    // Zero for interior nodes
+        float  tNear;
+    };
+
+    // Slab test of every child, returns the hit ones as a bit mask
+    // along with their entry distances
+    inline uint32 intersectChildren(const WideBVHNode& node, const WideRay& wray, float maxT, float* tNear) {
+        const VecF tMin  = setF(wray.minT);
+        const VecF tMax  = setF(maxT);
+        const VecF scale = setF(WBVH_FAR_SCALE);
+
+        uint32 hits = 0;
+        for (uint32 base = 0; base < WBVH_WIDTH; base += FLOAT_WIDTH) {
+            VecF enter = tMin;
+            VecF exit  = tMax;
+
+            for (uint32 i = 0; i < 3; ++i) {
+                const float* nearPlane = wray.dirIsNeg[i] ? node.bboxMax[i] : node.bboxMin[i];
+                const float* farPlane  = wray.dirIsNeg[i] ? node.bboxMin[i] : node.bboxMax[i];
+
+                VecF tN = mul(sub(add(loadF(&nearPlane[base]), wray.padNear[i]), wray.origin[i]), wray.invDir[i]);
+                VecF tF = mul(sub(add(loadF(&farPlane[base]), wray.padFar[i]), wray.origin[i]), wray.invDir[i]);
+
+                // NaNs (planes through the origin of an axis aligned ray) keep the current range
+                enter = vmax(tN, enter);
+                exit  = vmin(mul(tF, scale), exit);
+            }
+
+            uint32 bits = maskBits(le(enter, exit));
+            if (bits) {
+                storeF(&tNear[base], enter);
+                hits |= bits << base;
+            }
+        }
+
+        return hits;
+    }
+
+    inline float maxDistance(const Ray& ray) {
+        return floatRoundUp(ray.maxT()) * WBVH_FAR_SCALE;
+    }
+
+}
+
+WideBVH::WideBVH(const std::vector<std::shared_ptr<Shape>>& shapes, uint32 maxPrimsInNode)
+    : BVH(shapes, maxPrimsInNode) { }
+
+void WideBVH::layout(BuildContext& ctx) {
+    _wideNodes.clear();
+    _wideNodes.reserve(ctx.numNodes / 2 + 1);
+
+    collapse(ctx, 0);
+}
+
+uint32 WideBVH::collapse(BuildContext& ctx, uint32 buildIdx) {
+    // Gather the children by repeatedly opening the largest interior one
+    uint32 children[WBVH_WIDTH];
+    uint32 numChildren = 1;
+    children[0] = buildIdx;
+
+    while (numChildren < WBVH_WIDTH) {
+        uint32 best = WBVH_WIDTH;
+        Float  bestArea = -1;
+        for (uint32 c = 0; c < numChildren; ++c) {
+            const BuildNode& child = ctx.nodes[children[c]];
+            if (child.numPrims == 0 && child.bbox.surfaceArea() > bestArea) {
+                bestArea = child.bbox.surfaceArea();
+                best = c;
+            }
+        }
+
+        if (best == WBVH_WIDTH)
+            break;
+
+        const BuildNode& opened = ctx.nodes[children[best]];
+        children[best] = opened.children[0];
+        children[numChildren++] = opened.children[1];
+    }
+
+    uint32 nodeIdx = (uint32)_wideNodes.size();
+    _wideNodes.emplace_back();
+
+    WideBVHNode& newNode = _wideNodes[nodeIdx];
+    for (uint32 c = 0; c < WBVH_WIDTH; ++c) {
+        for (uint32 i = 0; i < 3; ++i) {
+            newNode.bboxMin[i][c] = c < numChildren ? floatRoundDown(ctx.nodes[children[c]].bbox.min()[i]) :  std::numeric_limits<float>::infinity();
+            newNode.bboxMax[i][c] = c < numChildren ? floatRoundUp(ctx.nodes[children[c]].bbox.max()[i])   : -std::numeric_limits<float>::infinity();
+        }
+
+        newNode.children[c] = 0;
+        newNode.numPrims[c] = 0;
+    }
+
+    // Children may reallocate the node array, so only index it afterwards
+    for (uint32 c = 0; c < numChildren; ++c) {
+        const BuildNode& child = ctx.nodes[children[c]];
+        if (child.numPrims > 0) {
+            uint32 firstPacket = addLeaf(ctx, children[c]);
+
+            _wideNodes[nodeIdx].children[c] = firstPacket;
+            _wideNodes[nodeIdx].numPrims[c] = (uint16)child.numPrims;
+        } else {
+            uint32 childIdx = collapse(ctx, children[c]);
+
+            _wideNodes[nodeIdx].children[c] = childIdx;
+        }
+    }
+
+    return nodeIdx;
+}
+
+bool WideBVH::intersectRay(const Ray& ray, SurfaceEvent* evt) const {
+    bool hit = false;
+    for (const Primitive& prim : _unbounded)
+        if (prim.intersectRay(ray, evt))
+            hit = true;
+
+    if (_wideNodes.empty())
+        return hit;
+
+    const WideRay wray(ray);
+    const PacketRay pray(ray);
+
+    StackEntry stack[WBVH_STACK_SIZE];
+    uint32 stackSize = 0;
+    stack[stackSize++] = { 0, 0, -std::numeric_limits<float>::infinity() };
+
+    alignas(32) float tNear[WBVH_WIDTH];
+
+    while (stackSize > 0) {
+        const StackEntry entry = stack[--stackSize];
+
+        // The ray's range shrinks with each hit, culling farther entries
+        float maxT = maxDistance(ray);
+        if (entry.tNear > maxT)
+            continue;
+
+        if (entry.numPrims > 0) {
+            TrianglePacket scratch;
+            uint32 numPackets = (entry.numPrims + PACKET_WIDTH - 1) / PACKET_WIDTH;
+            for (uint32 p = 0; p < numPackets; ++p)
+                if (intersectPacket(leafPacket(entry.idx + p, &scratch), pray, ray, evt))
+                    hit = true;
+
+            continue;
+        }
+
+        const WideBVHNode& node = _wideNodes[entry.idx];
+        uint32 hits = intersectChildren(node, wray, maxT, tNear);
+
+        // Sort hit children by entry distance, farthest first
+        StackEntry sorted[WBVH_WIDTH];
+        uint32 numSorted = 0;
+        for (uint32 c = 0; c < WBVH_WIDTH; ++c) {
+            if (!(hits & (1 << c)))
+                continue;
+
+            StackEntry child = { node.children[c], node.numPrims[c], tNear[c] };
+
+            uint32 pos = numSorted++;
+            while (pos > 0 && sorted[pos - 1].tNear < child.tNear) {
+                sorted[pos] = sorted[pos - 1];
+                pos--;
+            }
+            sorted[pos] = child;
+        }
+
+        // The nearest child ends up on top of the stack
+        for (uint32 c = 0; c < numSorted; ++c)
+            stack[stackSize++] = sorted[c];
+    }
+
+    return hit;
+}
+
+bool WideBVH::isOccluded(const Ray& ray) const {
+    for (const Primitive& prim : _unbounded)
+        if (prim.isOccluded(ray))
+            return true;
+
+    if (_wideNodes.empty())
+        return false;
+
+    const WideRay wray(ray);
+    const PacketRay pray(ray);
+    const float maxT = maxDistance(ray);
+
+    StackEntry stack[WBVH_STACK_SIZE];
+    uint32 stackSize = 0;
+    stack[stackSize++] = { 0, 0, 0 };
+
+    alignas(32) float tNear[WBVH_WIDTH];
+
+    // Any hit ends the traversal, so children are not sorted
+    while (stackSize > 0) {
+        const StackEntry entry = stack[--stackSize];
+
+        if (entry.numPrims > 0) {
+            TrianglePacket scratch;
+            uint32 numPackets = (entry.numPrims + PACKET_WIDTH - 1) / PACKET_WIDTH;
+            for (uint32 p = 0; p < numPackets; ++p)
+                if (isOccludedPacket(leafPacket(entry.idx + p, &scratch), pray, ray))
+                    return true;
+
+            continue;
+        }
+
+        const WideBVHNode& node = _wideNodes[entry.idx];
+        uint32 hits = intersectChildren(node, wray, maxT, tNear);
+
+        for (uint32 c = 0; c < WBVH_WIDTH; ++c)
+            if (hits & (1 << c))
+                stack[stackSize++] = { node.children[c], node.numPrims[c], tNear[c] };
+    }
+
+    return false;
+}
+
+void WideBVH::intersectRays(const RayBatch& batch, HitBatch* hits) const {
+    Accelerator::intersectRays(batch, hits);
+}
+
+uint32 WideBVH::occludedRays(const RayBatch& batch) const {
+    return Accelerator::occludedRays(batch);
+}
+
+bool WideBVH::refit() {
+    return false;
+}
+
+uint32 WideBVH::numNodes() const {
+    return (uint32)_wideNodes.size();
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <BVH.h>
+#include <SIMD.h>
+
+namespace Photon {
+
+    // Children per node, one register holds a bound of all of them
+    static const uint32 WBVH_WIDTH = SIMD::FLOAT_WIDTH >= 4 ? SIMD::FLOAT_WIDTH : 4;
+    static const uint32 WBVH_STACK_SIZE = BVH_STACK_SIZE * (WBVH_WIDTH - 1) + 1;
+
+    // Child bounds are stored per axis (SoA), so all of them are
+    // tested at once. Unused slots hold an inverted box that never hits.
+    struct alignas(64) WideBVHNode {
+        float  bboxMin[3][WBVH_WIDTH];
+        float  bboxMax[3][WBVH_WIDTH];
+        uint32 children[WBVH_WIDTH];    // Child node (interior) or first packet (leaf)
+        uint16 numPrims[WBVH_WIDTH];    // Primitives of leaf children, zero otherwise
+    };
+
+    // BVH whose binary tree is collapsed into nodes of WBVH_WIDTH children
+    // (8 with AVX, 4 otherwise), children are visited nearest first
+    class WideBVH : public BVH {
+    public:
+        WideBVH(const std::vector<std::shared_ptr<Shape>>& shapes, uint32 maxPrimsInNode = 4);
+
+        bool intersectRay(const Ray& ray, SurfaceEvent* evt) const;
+        bool isOccluded(const Ray& ray) const;
+
+        // Batches are traced ray by ray, the binary packet traversal does not apply
+        void intersectRays(const RayBatch& batch, HitBatch* hits) const;
+        uint32 occludedRays(const RayBatch& batch) const;
+
+        // Collapsed nodes are not kept in sync with the binary ones,
+        // the tree is always built again
+        bool refit();
+
+        uint32 numNodes() const;
+
+    private:
+        void layout(BuildContext& ctx);
+        uint32 collapse(BuildContext& ctx, uint32 buildIdx);
+
+        std::vector<WideBVHNode, Utils::AlignedAllocator<WideBVHNode>> _wideNodes;
+    };
+
+}
\ No newline at end of file
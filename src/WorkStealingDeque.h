@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <PhotonMath.h>
+
+namespace Photon {
+
+    namespace Threading {
+
+        // Chase-Lev deque of pointers. The owner thread pushes and pops at
+        // the bottom without contention, other threads steal from the top.
+        // The buffer grows on demand, replaced buffers are kept alive until
+        // destruction since thieves may still be reading them.
+        template<typename T>
+        class WorkStealingDeque {
+        public:
+            WorkStealingDeque(uint32 capacity = 256)
+                : _top(0), _bottom(0) {
+
+                _buffers.emplace_back(new Buffer(capacity));
+                _buffer = _buffers.back().get();
+            }
+
+            // Owner only
+            void push(T* item) {
+                int64 bottom = _bottom.load(std::memory_order_relaxed);
+                int64 top    = _top.load(std::memory_order_acquire);
+                Buffer* buffer = _buffer.load(std::memory_order_relaxed);
+
+                if (bottom - top > buffer->mask) {
+                    _buffers.emplace_back(buffer->grow(top, bottom));
+                    buffer = _buffers.back().get();
+                    _buffer.store(buffer, std::memory_order_release);
+                }
+
+                buffer->put(bottom, item);
+                std::atomic_thread_fence(std::memory_order_release);
+                _bottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+
+            // Owner only, returns the most recently pushed item
+            T* pop() {
+                int64 bottom = _bottom.load(std::memory_order_relaxed) - 1;
+                Buffer* buffer = _buffer.load(std::memory_order_relaxed);
+
+                _bottom.store(bottom, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64 top = _top.load(std::memory_order_relaxed);
+
+                if (top > bottom) {
+                    // Empty
+                    _bottom.store(bottom + 1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+
+                T* item = buffer->get(bottom);
+                if (top == bottom) {
+                    // Last item, race against thieves for it
+                    if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                      std::memory_order_relaxed))
+                        item = nullptr;
+
+                    _bottom.store(bottom + 1, std::memory_order_relaxed);
+                }
+
+                return item;
+            }
+
+            // Any thread, returns the oldest item or nullptr if empty or lost a race
+            T* steal() {
+                int64 top = _top.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64 bottom = _bottom.load(std::memory_order_acquire);
+
+                if (top >= bottom)
+                    return nullptr;
+
+                Buffer* buffer = _buffer.load(std::memory_order_consume);
+                T* item = buffer->get(top);
+                if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                  std::memory_order_relaxed))
+                    return nullptr;
+
+                return item;
+            }
+
+            bool empty() const {
+                return _top.load(std::memory_order_relaxed) >= _bottom.load(std::memory_order_relaxed);
+            }
+
+        private:
+            struct Buffer {
+                int64 mask;
+                std::unique_ptr<std::atomic<T*>[]> items;
+
+                Buffer(int64 capacity)
+                    : mask(capacity - 1), items(new std::atomic<T*>[capacity]) { }
+
+                T* get(int64 idx) const {
+                    return items[idx & mask].load(std::memory_order_relaxed);
+                }
+
+                void put(int64 idx, T* item) {
+                    items[idx & mask].store(item, std::memory_order_relaxed);
+                }
+
+                Buffer* grow(int64 top, int64 bottom) const {
+                    Buffer* buffer = new Buffer(2 * (mask + 1));
+                    for (int64 i = top; i < bottom; ++i)
+                        buffer->put(i, get(i));
+
+                    return buffer;
+                }
+            };
+
+            std::atomic<int64> _top;
+            std::atomic<int64> _bottom;
+            std::atomic<Buffer*> _buffer;
+            std::vector<std::unique_ptr<Buffer>> _buffers;   // Owner only
+        };
+
+    }
+
+}
\ No newline at end of file
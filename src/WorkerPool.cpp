@@ -3,9 +3,23 @@
 using namespace Photon;
 using namespace Photon::Threading;
 
+// Identifies pool threads, anything else gets numThreads as its id
+static thread_local const WorkerPool* tlsPool = nullptr;
+static thread_local uint32 tlsThreadId = 0;
+
+// Xorshift state used to pick steal victims
+static thread_local uint32 tlsVictimSeed = 0x9E3779B9;
+
 WorkerPool::WorkerPool(uint32 threadCount)
     : _numThreads(threadCount),
-    _shutdown(false) {
+    _shutdown(false),
+    _numShared(0),
+    _numItems(0),
+    _numSleeping(0) {
+
+    for (uint32 n = 0; n < _numThreads; ++n)
+        _queues.emplace_back(new WorkStealingDeque<WorkItem>());
+
     startThreads();
 }
 
@@ -13,79 +27,126 @@ WorkerPool::~WorkerPool() {
     stop();
 }
 
-std::shared_ptr<Task> WorkerPool::getTask(uint32 &subTaskId) {
-    if (_shutdown)
-        return nullptr;
+uint32 WorkerPool::currentThreadId() const {
+    return tlsPool == this ? tlsThreadId : _numThreads;
+}
+
+void WorkerPool::pushItem(uint32 threadId, WorkItem* item) {
+    if (threadId < _numThreads) {
+        _queues[threadId]->push(item);
+    } else {
+        std::unique_lock<std::mutex> lock(_taskMutex);
+        _tasks.push_back(item);
+        _numShared++;
+    }
+
+    _numItems++;
 
-    std::shared_ptr<Task> task = _tasks.front();
-    if (task->isAborting()) {
-        _tasks.pop_front();
-        return nullptr;
+    // Wake a sleeping worker, more wake up as the item is split
+    if (_numSleeping > 0) {
+        std::unique_lock<std::mutex> lock(_taskMutex);
+        _taskCond.notify_one();
     }
+}
 
-    // Get next subtask id
-    subTaskId = task->startSubTask();
+WorkerPool::WorkItem* WorkerPool::findItem(uint32 threadId) {
+    WorkItem* item = nullptr;
 
-    // If it is the last subtask, remove the task
-    if (subTaskId == task->numSubTasks() - 1)
-        _tasks.pop_front();
+    // Own queue first, newest items are the most cache friendly
+    if (threadId < _numThreads)
+        item = _queues[threadId]->pop();
 
-    return std::move(task);
+    if (!item && _numShared > 0) {
+        std::unique_lock<std::mutex> lock(_taskMutex);
+        if (!_tasks.empty()) {
+            item = _tasks.front();
+            _tasks.pop_front();
+            _numShared--;
+        }
+    }
+
+    // Steal the oldest item of the other workers, starting at a random one
+    if (!item && _numThreads > 0) {
+        tlsVictimSeed ^= tlsVictimSeed << 13;
+        tlsVictimSeed ^= tlsVictimSeed >> 17;
+        tlsVictimSeed ^= tlsVictimSeed << 5;
+
+        const uint32 first = tlsVictimSeed % _numThreads;
+        for (uint32 i = 0; i < _numThreads && !item; ++i) {
+            const uint32 victim = (first + i) % _numThreads;
+            if (victim != threadId)
+                item = _queues[victim]->steal();
+        }
+    }
+
+    if (item)
+        _numItems--;
+
+    return item;
+}
+
+void WorkerPool::runItem(uint32 threadId, WorkItem* item) {
+    const std::shared_ptr<Task>& task = item->task;
+
+    // Remaining subtasks of aborted tasks are dropped
+    if (!task->isAborting() && item->begin < item->end) {
+        // Leave the upper halves to other threads, running the first subtask here
+        while (item->end - item->begin > 1) {
+            const uint32 mid = item->begin + (item->end - item->begin) / 2;
+            pushItem(threadId, new WorkItem{ task, mid, item->end });
+            item->end = mid;
+        }
+
+        task->startSubTask();
+        task->run(threadId, item->begin);
+    }
+
+    delete item;
 }
 
 void WorkerPool::runWorker(uint32 threadId) {
-    while (!_shutdown) {
-        uint32 subTaskId;
-        std::shared_ptr<Task> task;
+    tlsPool       = this;
+    tlsThreadId   = threadId;
+    tlsVictimSeed = 0x9E3779B9 * (threadId + 1);
 
-        {   // Start mutex
-            std::unique_lock<std::mutex> lock(_taskMutex);
-            _taskCond.wait(lock, [this](){ return _shutdown || !_tasks.empty(); });
-            task = getTask(subTaskId);
-        }   // End mutex
+    while (!_shutdown) {
+        WorkItem* item = findItem(threadId);
+        if (item) {
+            runItem(threadId, item);
+            continue;
+        }
 
-        if (task)
-            task->run(threadId, subTaskId);
+        // Sleep until new items are pushed
+        std::unique_lock<std::mutex> lock(_taskMutex);
+        _numSleeping++;
+        _taskCond.wait(lock, [this](){ return _shutdown || _numItems > 0; });
+        _numSleeping--;
     }
 }
 
 void WorkerPool::startThreads() {
     _shutdown = false;
 
-    for (uint32 n = 0; n < _numThreads; ++n) {
+    for (uint32 n = 0; n < _numThreads; ++n)
         _workers.emplace_back(new std::thread(&WorkerPool::runWorker, this, n));
-        _idToNumericId.insert(std::make_pair(_workers.back()->get_id(), n));
-    }
 }
 
 void WorkerPool::yield(Task &wait) {
-    std::chrono::milliseconds waitSpan(10);
-    uint32 id = _numThreads; // If thread outside pool calls this, gets a new id
-
-    auto iter = _idToNumericId.find(std::this_thread::get_id());
-    if (iter != _idToNumericId.end())
-        id = iter->second;
+    // Threads outside the pool only take from the shared queue or steal
+    const uint32 id = currentThreadId();
 
     while (!wait.isDone() && !_shutdown) {
-        uint32 subTaskId;
-        std::shared_ptr<Task> task;
-
-        {
-            std::unique_lock<std::mutex> lock(_taskMutex);
-            if (!_taskCond.wait_for(lock, waitSpan, [this](){ return _shutdown || !_tasks.empty(); }))
-                continue;
-
-            task = getTask(subTaskId);
-        }
-
-        if (task)
-            task->run(id, subTaskId);
+        WorkItem* item = findItem(id);
+        if (item)
+            runItem(id, item);
+        else
+            std::this_thread::yield();
     }
 }
 
 void WorkerPool::reset() {
     stop();
-    _tasks.clear();
+    clearQueues();
     startThreads();
 }
 
@@ -104,21 +165,26 @@ void WorkerPool::stop() {
     }
 }
 
+void WorkerPool::clearQueues() {
+    for (uint32 n = 0; n < _numThreads; ++n)
+        while (WorkItem* item = _queues[n]->pop())
+            delete item;
+
+    std::unique_lock<std::mutex> lock(_taskMutex);
+    for (WorkItem* item : _tasks)
+        delete item;
+
+    _tasks.clear();
+    _numShared = 0;
+    _numItems  = 0;
+}
+
 std::shared_ptr<Task> WorkerPool::pushTask(TaskFunc func, uint32 numSubtasks, EndCallback finisher) {
     // Create new task
     std::shared_ptr<Task> task(std::make_shared<Task>(std::move(func), std::move(finisher), numSubtasks));
 
-    { // Start task mutex
-        std::unique_lock<std::mutex> lock(_taskMutex);
-        _tasks.emplace_back(task);  // Push the task
-
-        // Unlock the waiting workers
-        if (numSubtasks == 1)
-            _taskCond.notify_one();
-        else
-            _taskCond.notify_all();
-
-    } // End task mutex
+    // Queue all its subtasks as a single item, split by whoever runs it
+    pushItem(currentThreadId(), new WorkItem{ task, 0, numSubtasks });
 
     return std::move(task);
 }
\ No newline at end of file
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <condition_variable>
-#include <unordered_map>
 #include <functional>
 #include <atomic>
 #include <memory>
@@ -12,6 +11,7 @@
 
 #include <PhotonMath.h>
 #include <Task.h>
+#include <WorkStealingDeque.h>
 
 namespace Photon {
 
@@ -39,19 +39,37 @@ namespace Photon {
             }
 
         private:
+            // Contiguous range of subtasks, split in halves as it runs
+            // so that idle threads can steal the upper ones
+            struct WorkItem {
+                std::shared_ptr<Task> task;
+                uint32 begin;
+                uint32 end;
+            };
+
             uint32 _numThreads;
             std::vector<std::unique_ptr<std::thread>> _workers;
             std::atomic<bool> _shutdown;
 
-            std::deque<std::shared_ptr<Task>> _tasks;
+            // Each worker owns a deque, threads outside the pool share a queue
+            std::vector<std::unique_ptr<WorkStealingDeque<WorkItem>>> _queues;
+            std::deque<WorkItem*> _tasks;
+            std::atomic<uint32> _numShared;     // Items in _tasks
+
+            std::atomic<uint32> _numItems;      // Items queued anywhere
+            std::atomic<uint32> _numSleeping;   // Workers waiting for items
             std::mutex _taskMutex;
             std::condition_variable _taskCond;
 
-            std::unordered_map<std::thread::id, uint32> _idToNumericId;
+            uint32 currentThreadId() const;
+
+            void pushItem(uint32 threadId, WorkItem* item);
+            WorkItem* findItem(uint32 threadId);
+            void runItem(uint32 threadId, WorkItem* item);
 
-            std::shared_ptr<Task> getTask(uint32 &subTaskId);
             void runWorker(uint32 threadId);
             void startThreads();
+            void clearQueues();
         };
 
     }
@@ -20,6 +20,9 @@
 #include <Threading.h>
 #include <Timer.h>
 #include <Resources.h>
+#include <PageCache.h>
+#include <Accelerator.h>
+#include <Benchmark.h>
 
 using namespace Photon;
 using namespace Photon::OpenGL;
@@ -131,28 +134,101 @@ int main(int argc, char* argv[]) {
 
     // Command line arguments
     if (argc < 1) {
-        std::cerr << "Usage: " << argv[0] << " <NFF_file>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <NFF_file> [--bench-accel | --bench-pool | --bench-parse | --bench-lights | --test-rays]" << std::endl;
         std::cin.get();
         return EXIT_FAILURE;
     } else if (argc > 1) {
         filePath = std::string(argv[1]);
     }
 
+    // Load renderer settings first, they decide whether
+    // the scene is compiled into a cache while parsed
+    _renderer = std::make_shared<Renderer>("settings.json");
+    Resources::get().setCacheEnabled(_renderer->settings().sceneCache);
+    Resources::get().setMeshCompression(_renderer->settings().compressMeshes);
+
+    // Geometry is paged from the scene cache, so a budget needs one
+    if (_renderer->settings().geometryBudget > 0) {
+        if (!_renderer->settings().sceneCache)
+            std::cerr << "[WARNING] The geometry budget needs the scene cache, it is ignored." << std::endl;
+        else
+            Utils::PageCache::get().setBudget((size_t)_renderer->settings().geometryBudget << 20);
+    }
+
+    // Init system, meshes are parsed by the workers
+    photonInit();
+
+    // Optionally measure the scene parser instead of rendering
+    if (argc > 2 && std::string(argv[2]) == "--bench-parse") {
+        Utils::benchmarkSceneParser(filePath, 100);
+        photonShutdown();
+        exit(EXIT_SUCCESS);
+    }
+
+    // Or check the accelerators on rays with signed zero directions,
+    // the scene is built by the test itself
+    if (argc > 2 && std::string(argv[2]) == "--test-rays") {
+        const bool passed = Utils::testSignedZeroRays();
+        std::cout << "Signed zero rays: " << (passed ? "passed" : "FAILED") << std::endl;
+        photonShutdown();
+        exit(passed ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
     // Parse scene
     _scene = Utils::NFFParser::fromFile(filePath);
     if (!_scene)
         Utils::throwError("Failed to load scene.");
 
-    // Init system
-    photonInit();
+    // The accelerator named by the settings is only
+    // used if the scene file didn't ask for one
+    AcceleratorType accelType;
+    if (parseAccelerator(_renderer->settings().accelerator, &accelType))
+        _scene->setDefaultAccelerator(accelType);
+
+    // Samples are reconstructed with the filter of the settings
+    std::shared_ptr<Filter> filter;
+    if (parseFilter(_renderer->settings().filter, &filter))
+        _scene->getCamera().film().setFilter(filter);
+
+    // Lights are picked as the settings ask
+    LightStrategy lightStrat;
+    if (parseLightStrategy(_renderer->settings().lightStrategy, &lightStrat))
+        _scene->setLightStrategy(lightStrat);
 
     // Prepare scene for rendering
     _scene->prepareRender();
 
+    // Optionally compare accelerators instead of rendering
+    if (argc > 2 && std::string(argv[2]) == "--bench-accel") {
+        Utils::benchmarkAccelerators(*_scene, 1 << 20);
+        photonShutdown();
+        exit(EXIT_SUCCESS);
+    }
+
+    // Or measure the scheduling overhead of the worker pool
+    if (argc > 2 && std::string(argv[2]) == "--bench-pool") {
+        Utils::benchmarkWorkerPool(128);
+        photonShutdown();
+        exit(EXIT_SUCCESS);
+    }
+
+    // Or compare light selection with the alias table and the CDF
+    if (argc > 2 && std::string(argv[2]) == "--bench-lights") {
+        Utils::benchmarkLightSampling(1 << 17, 1 << 24);
+        photonShutdown();
+        exit(EXIT_SUCCESS);
+    }
+
+    // Animations with several frames are rendered as a sequence
+    if (_renderer->settings().frames > 1) {
+        _renderer->renderSequence(_scene);
+        photonShutdown();
+        exit(EXIT_SUCCESS);
+    }
+
     Utils::Timer t;
 
     // Initialize scene renderer and start rendering process
-    _renderer = std::make_shared<Renderer>("settings.json");
     _renderer->initialize();
     _renderer->renderScene(_scene);
     